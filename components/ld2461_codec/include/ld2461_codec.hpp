@@ -0,0 +1,210 @@
+/*
+LD2461 Frame Codec
+------------------
+Header only encoder/decoder shared by the firmware, the emulator and the host
+tools. Everything is constexpr and works on caller provided buffers, so fixed
+commands are built (length and checksum included) at compile time and report
+frames are encoded without touching the heap.
+
+    constexpr auto request = ld2461_make_command(LD2461_COMMAND_ID_AND_VERSION, {0x01});
+    uart_write_bytes(uart_num, request.bytes, request.size);
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ld2461_protocol.hpp"
+
+/**
+ * @brief Checksum of a frame, (Command Word + Command Value) & 0xFF
+ */
+constexpr uint8_t ld2461_checksum(uint8_t command_word, const uint8_t* command_value, size_t length)
+{
+    uint8_t sum = command_word;
+    for(size_t i=0; i<length; i++) sum += command_value[i];
+    return sum;
+}
+
+/**
+ * @brief Size of a whole frame with a Command Value of the given length
+ */
+constexpr size_t ld2461_frame_size(size_t value_length)
+{
+    return LD2461_FRAME_OVERHEAD + value_length;
+}
+
+/**
+ * @brief Encode a frame into a buffer
+ *
+ * @param out Buffer for the frame
+ * @param capacity Size of the buffer
+ * @param command_word Command Word
+ * @param command_value Command Value (may be NULL when length is 0)
+ * @param length Command Value length
+ * @return size_t Bytes written, 0 if the frame does not fit
+ */
+constexpr size_t ld2461_encode_frame(
+    uint8_t* out,
+    size_t capacity,
+    uint8_t command_word,
+    const uint8_t* command_value,
+    size_t length
+)
+{
+    if(length > LD2461_MAX_COMMAND_VALUE || ld2461_frame_size(length) > capacity) return 0;
+
+    size_t data_length = length + 1;
+    size_t index = 0;
+    out[index++] = 0xFF; out[index++] = 0xEE; out[index++] = 0xDD;                    // Header
+    out[index++] = (uint8_t)(data_length >> 8); out[index++] = (uint8_t)data_length;  // Data Length
+    out[index++] = command_word;                                                      // Command Word
+    for(size_t i=0; i<length; i++) out[index++] = command_value[i];                   // Command Value
+    out[index++] = ld2461_checksum(command_word, command_value, length);              // Checksum
+    out[index++] = 0xDD; out[index++] = 0xEE; out[index++] = 0xFF;                    // End
+    return index;
+}
+
+/**
+ * @brief Encode a RADAR_REPORT_1 frame
+ *
+ * @param out Buffer for the frame
+ * @param capacity Size of the buffer
+ * @param targets Targets coordinates (0.1m)
+ * @param count Number of targets, the radar only sends up to the last valid one
+ * @return size_t Bytes written, 0 if the frame does not fit
+ */
+constexpr size_t ld2461_encode_report(uint8_t* out, size_t capacity, const ld2461_coordinate_t* targets, size_t count)
+{
+    uint8_t value[LD2461_MAX_COMMAND_VALUE] = {};
+    if(count * 2 > LD2461_MAX_COMMAND_VALUE) return 0;
+    for(size_t i=0; i<count; i++)
+    {
+        value[2*i] = (uint8_t)targets[i].x;
+        value[2*i+1] = (uint8_t)targets[i].y;
+    }
+    return ld2461_encode_frame(out, capacity, LD2461_COMMAND_RADAR_REPORT_1, value, count * 2);
+}
+
+/**
+ * @brief Number of targets a report must carry, the radar stops at the last valid (not (0, 0)) target
+ */
+constexpr size_t ld2461_report_length(const ld2461_coordinate_t* targets, size_t count)
+{
+    size_t length = 0;
+    for(size_t i=0; i<count; i++)
+    {
+        if(targets[i].x != 0 || targets[i].y != 0) length = i + 1;
+    }
+    return length;
+}
+
+/**
+ * @brief Frame built at compile time
+ */
+template <size_t N>
+struct ld2461_command_frame
+{
+    uint8_t bytes[ld2461_frame_size(N)] = {};
+    size_t size = ld2461_frame_size(N);
+};
+
+/**
+ * @brief Build a fixed command frame at compile time
+ *
+ * @param command_word Command Word
+ * @param command_value Command Value
+ * @return ld2461_command_frame<N> Frame with its length and checksum
+ */
+template <size_t N>
+constexpr ld2461_command_frame<N> ld2461_make_command(uint8_t command_word, const uint8_t (&command_value)[N])
+{
+    ld2461_command_frame<N> frame;
+    ld2461_encode_frame(frame.bytes, sizeof(frame.bytes), command_word, command_value, N);
+    return frame;
+}
+
+/**
+ * @brief Build a fixed command frame without Command Value at compile time
+ */
+constexpr ld2461_command_frame<0> ld2461_make_command(uint8_t command_word)
+{
+    ld2461_command_frame<0> frame;
+    ld2461_encode_frame(frame.bytes, sizeof(frame.bytes), command_word, NULL, 0);
+    return frame;
+}
+
+/**
+ * @brief Build the Change Baudrate command
+ */
+constexpr ld2461_command_frame<3> ld2461_make_baudrate_command(ld2461_baudrate_t baudrate)
+{
+    const uint8_t value[3] = {
+        (uint8_t)((baudrate >> 16) & 0xFF),
+        (uint8_t)((baudrate >> 8) & 0xFF),
+        (uint8_t)(baudrate & 0xFF)
+    };
+    return ld2461_make_command(LD2461_COMMAND_CHANGE_BAUDRATE, value);
+}
+
+// Fixed commands
+constexpr ld2461_command_frame<1> LD2461_FRAME_VERSION_REQUEST = ld2461_make_command(LD2461_COMMAND_ID_AND_VERSION, {0x01});
+constexpr ld2461_command_frame<1> LD2461_FRAME_READ_AREAS = ld2461_make_command(LD2461_COMMAND_READING_AREAS, {0x01});
+constexpr ld2461_command_frame<1> LD2461_FRAME_WITHDRAW_AREAS = ld2461_make_command(LD2461_COMMAND_WITHDRAW_AREAS, {0x01});
+constexpr ld2461_command_frame<1> LD2461_FRAME_RESET = ld2461_make_command(LD2461_COMMAND_RESET, {0x01});
+constexpr ld2461_command_frame<0> LD2461_FRAME_EMPTY_REPORT = ld2461_make_command(LD2461_COMMAND_RADAR_REPORT_1);
+
+static_assert(LD2461_FRAME_VERSION_REQUEST.bytes[7] == 0x0A, "Version request checksum");
+static_assert(LD2461_FRAME_EMPTY_REPORT.bytes[6] == 0x07, "Empty report checksum");
+
+/**
+ * @brief Decode a complete frame at the start of a buffer
+ * @note For a byte stream with garbage or partial frames use LD2461Parser
+ *
+ * @param data Bytes starting at the frame header
+ * @param length Number of bytes available
+ * @param frame Where to store the frame
+ * @return size_t Size of the frame, 0 if the bytes are not a complete valid frame
+ */
+constexpr size_t ld2461_decode_frame(const uint8_t* data, size_t length, ld2461_frame_t* frame)
+{
+    if(length < LD2461_FRAME_OVERHEAD) return 0;
+    if(data[0] != 0xFF || data[1] != 0xEE || data[2] != 0xDD) return 0;
+
+    size_t data_length = ((size_t)data[3] << 8) | data[4];
+    if(data_length == 0 || data_length > LD2461_MAX_COMMAND_VALUE + 1) return 0;
+    size_t value_length = data_length - 1;
+    size_t size = ld2461_frame_size(value_length);
+    if(length < size) return 0;
+
+    const uint8_t* value = data + 6;
+    if(data[6 + value_length] != ld2461_checksum(data[5], value, value_length)) return 0;
+    if(data[7 + value_length] != 0xDD || data[8 + value_length] != 0xEE || data[9 + value_length] != 0xFF) return 0;
+
+    frame->data_length = (uint16_t)data_length;
+    frame->command_word = (ld2461_command_word_t)data[5];
+    for(size_t i=0; i<value_length; i++) frame->command_value[i] = value[i];
+    frame->checksum = data[6 + value_length];
+    return size;
+}
+
+/**
+ * @brief Decode the targets of a RADAR_REPORT_1 frame
+ *
+ * @param frame Report frame
+ * @param targets Where to store the targets
+ * @param max_targets Size of targets
+ * @return size_t Number of targets stored
+ */
+constexpr size_t ld2461_decode_report(const ld2461_frame_t* frame, ld2461_coordinate_t* targets, size_t max_targets)
+{
+    size_t count = (frame->data_length - 1) / 2;
+    if(count > max_targets) count = max_targets;
+    for(size_t i=0; i<count; i++)
+    {
+        targets[i].x = (int8_t)frame->command_value[2*i];
+        targets[i].y = (int8_t)frame->command_value[2*i+1];
+    }
+    return count;
+}
@@ -0,0 +1,121 @@
+/*
+LD2461 Streaming Parser
+-----------------------
+Bytes are pushed (or read directly from the UART) into a fixed ring buffer and
+the state machine emits complete, checksum validated frames. Nothing here uses
+the heap or ESP-IDF, so the same code runs on the MCU and on the host.
+
+                  +--------------------------------------------+
+                  v                                            |
+HEADER_0 -> HEADER_1 -> HEADER_2 -> LENGTH_H -> LENGTH_L -> COMMAND_WORD
+                                                                |
+END_2 <- END_1 <- END_0 <- CHECKSUM <------- COMMAND_VALUE <-----+
+
+When a frame fails (length, checksum or trailer) the parser rewinds to the byte
+after the rejected header, so a real header hidden inside garbage is not lost.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ld2461_protocol.hpp"
+
+#define LD2461_PARSER_BUFFER_SIZE 512   // Must be a power of two and bigger than LD2461_MAX_FRAME_SIZE
+
+typedef enum ld2461_parser_state : uint8_t
+{
+    LD2461_PARSER_HEADER_0,
+    LD2461_PARSER_HEADER_1,
+    LD2461_PARSER_HEADER_2,
+    LD2461_PARSER_LENGTH_H,
+    LD2461_PARSER_LENGTH_L,
+    LD2461_PARSER_COMMAND_WORD,
+    LD2461_PARSER_COMMAND_VALUE,
+    LD2461_PARSER_CHECKSUM,
+    LD2461_PARSER_END_0,
+    LD2461_PARSER_END_1,
+    LD2461_PARSER_END_2
+}ld2461_parser_state_t;
+
+typedef struct ld2461_parser_stats
+{
+    uint32_t frames;            // Frames emitted
+    uint32_t checksum_errors;   // Frames rejected by the checksum
+    uint32_t trailer_errors;    // Frames rejected by the frame end
+    uint32_t length_errors;     // Frames rejected by an impossible data length
+    uint32_t discarded_bytes;   // Bytes skipped while hunting for a header
+    uint32_t overruns;          // Bytes dropped because the ring buffer was full
+}ld2461_parser_stats_t;
+
+class LD2461Parser{
+private:
+    uint8_t buffer[LD2461_PARSER_BUFFER_SIZE];
+    size_t head;                // Next position to be written
+    size_t scan;                // Next position to be parsed
+    size_t tail;                // Oldest position still needed (start of the frame being parsed)
+
+    ld2461_parser_state_t state;
+    ld2461_frame_t frame;       // Frame being assembled
+    uint16_t value_index;
+    uint8_t checksum;
+
+    ld2461_parser_stats_t stats;
+
+    /**
+     * @brief Drop the frame being assembled and hunt again from the byte after its header
+     */
+    void rewind();
+
+public:
+    LD2461Parser();
+
+    /**
+     * @brief Discard every buffered byte and restart the header hunt
+     * @note Statistics are kept, use reset_stats() to clear them
+     */
+    void reset();
+
+    /**
+     * @brief Get the contiguous free region of the ring buffer
+     * @note Used to read from the UART straight into the parser, follow it with commit()
+     *
+     * @param window Pointer to the free region
+     * @return size_t Size of the free region in bytes
+     */
+    size_t write_window(uint8_t** window);
+
+    /**
+     * @brief Mark bytes written through write_window() as available to the parser
+     *
+     * @param length Number of bytes written
+     */
+    void commit(size_t length);
+
+    /**
+     * @brief Copy bytes into the ring buffer
+     *
+     * @param data Bytes to copy
+     * @param length Number of bytes
+     * @return size_t Number of bytes accepted (the rest is counted as overrun)
+     */
+    size_t push(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Number of bytes buffered and not parsed yet
+     */
+    size_t pending();
+
+    /**
+     * @brief Run the state machine over the buffered bytes
+     *
+     * @param out Frame to store the next complete frame
+     * @return true If a valid frame was stored in out
+     * @return false If more bytes are needed
+     */
+    bool next_frame(ld2461_frame_t* out);
+
+    const ld2461_parser_stats_t* get_stats();
+    void reset_stats();
+};
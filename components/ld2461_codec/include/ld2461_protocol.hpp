@@ -0,0 +1,113 @@
+/*
+LD2461 Frame Format
+-------------------
+Be advised, LD2461 Communication Protocol uses the Big Endian format!!!
+FRAME HEADER - DATA LENGHT - COMMAND WORD - COMMAND VALUE - CHECKSUM - FRAME END
+0xFFEEDD        2 bytes        1 byte          N bytes       1 byte     0xDDEEFF
+
+DATA LENGHT = 1 (Command Word) + N (Command Value)
+CHECKSUM    = (Command Word + Command Value[0] + ... + Command Value[N-1]) & 0xFF
+
+This header has no dependency on ESP-IDF, so it can be used by the host tools too.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define LD2461_MAX_COMMAND_VALUE 64     // Biggest Command Value accepted from the radar
+#define LD2461_FRAME_OVERHEAD 10        // Header (3) + Data Length (2) + Command Word (1) + Checksum (1) + End (3)
+#define LD2461_MAX_FRAME_SIZE (LD2461_FRAME_OVERHEAD + LD2461_MAX_COMMAND_VALUE)
+
+enum ld2461_baudrate_t
+{
+    LD2461_BAUDRATE_9600 = 0x002580,
+    LD2461_BAUDRATE_19200 = 0x004B00,
+    LD2461_BAUDRATE_38400 = 0x009600,
+    LD2461_BAUDRATE_57600 = 0x00E100,
+    LD2461_BAUDRATE_115200 = 0x01C200,
+    LD2461_BAUDRATE_256000 = 0x03E800
+};
+
+enum ld2461_command_word_t : uint8_t
+{
+    LD2461_COMMAND_NULL = 0x00,
+    LD2461_COMMAND_CHANGE_BAUDRATE = 0x01,
+    LD2461_COMMAND_SET_RADAR = 0x02,
+    LD2461_COMMAND_READ_RADAR = 0x03,
+    LD2461_COMMAND_ZONE_FILTERING = 0x04,
+    LD2461_COMMAND_WITHDRAW_AREAS = 0x05,
+    LD2461_COMMAND_READING_AREAS = 0x06,
+    LD2461_COMMAND_RADAR_REPORT_1 = 0x07,
+    LD2461_COMMAND_RADAR_REPORT_2 = 0x08,
+    LD2461_COMMAND_ID_AND_VERSION = 0x09,
+    LD2461_COMMAND_RESET = 0x0A,
+};
+
+enum ld2461_frame_guard_t : uint32_t
+{
+    LD2461_FRAME_HEADER = 0xFFEEDD,
+    LD2461_FRAME_END = 0xDDEEFF
+};
+
+typedef struct ld2461_frame
+{
+    uint16_t data_length;                               // 2 bytes
+    ld2461_command_word_t command_word;                 // 1 byte
+    uint8_t command_value[LD2461_MAX_COMMAND_VALUE];    // N bytes
+    uint8_t checksum;                                   // 1 byte
+}ld2461_frame_t;
+
+typedef struct ld2461_coordinate
+{
+    int8_t x;
+    int8_t y;
+}ld2461_coordinate_t;
+
+/*
+Decoded RADAR_REPORT_1
+----------------------
+Up to MAX_TARGETS_DETECTION coordinates (0.1m), (0, 0) means no target in the slot
+*/
+#define MAX_TARGETS_DETECTION 5
+
+enum ld2461_available_target : uint8_t
+{
+    LD2461_TARGET_UNAVAILABLE = 0,
+    LD2461_TARGET_AVAILABLE = 1,
+    LD2461_TARGET_GHOST = 2,
+    LD2461_TARGET_TELEPORTED = 3
+};
+
+typedef struct ld2461_detection
+{
+    struct ld2461_coordinate target[MAX_TARGETS_DETECTION];
+    int8_t detected_targets; // Number of detected targets
+    int8_t is_target_available[MAX_TARGETS_DETECTION]; // ID of the detected targets (0 for not available, 1 for available)
+    int64_t timestamp; // esp_timer time (us) when the last byte of the frame arrived
+    uint16_t track_id[MAX_TARGETS_DETECTION]; // Tracker ID of each slot (0 for no track), set by the firmware tracker
+}ld2461_detection_t;
+
+/*
+Zone Filtering (0x04) / Reading Areas (0x06) Command Value
+-----------------------------------------------------------
+MODE - ZONE 0 (4 points) - ZONE 1 (4 points) - ZONE 2 (4 points)
+1 byte      8 bytes             8 bytes            8 bytes
+Each point is X, Y (int8, 0.1m), the 4 points of a zone are its corners in order
+*/
+#define LD2461_ZONE_COUNT 3
+#define LD2461_ZONE_POINTS 4
+#define LD2461_ZONE_VALUE_SIZE (1 + (LD2461_ZONE_COUNT * LD2461_ZONE_POINTS * 2))
+
+enum ld2461_zone_mode_t : uint8_t
+{
+    LD2461_ZONE_DISABLED = 0x00,    // Report every target
+    LD2461_ZONE_DETECT_ONLY = 0x01, // Report only the targets inside the zones
+    LD2461_ZONE_EXCLUDE = 0x02      // Report only the targets outside the zones
+};
+
+typedef struct ld2461_zone_filter
+{
+    ld2461_zone_mode_t mode;
+    ld2461_coordinate_t zone[LD2461_ZONE_COUNT][LD2461_ZONE_POINTS];
+}ld2461_zone_filter_t;
@@ -0,0 +1,190 @@
+#include "ld2461_parser.hpp"
+
+#include <string.h>
+
+#define LD2461_PARSER_MASK (LD2461_PARSER_BUFFER_SIZE - 1)
+
+static_assert((LD2461_PARSER_BUFFER_SIZE & LD2461_PARSER_MASK) == 0, "LD2461_PARSER_BUFFER_SIZE must be a power of two");
+static_assert(LD2461_PARSER_BUFFER_SIZE > LD2461_MAX_FRAME_SIZE, "LD2461_PARSER_BUFFER_SIZE must hold a whole frame");
+
+LD2461Parser::LD2461Parser()
+{
+    this->reset();
+    this->reset_stats();
+}
+
+void LD2461Parser::reset()
+{
+    head = 0;
+    scan = 0;
+    tail = 0;
+    state = LD2461_PARSER_HEADER_0;
+    value_index = 0;
+    checksum = 0;
+    frame.data_length = 0;
+    frame.command_word = LD2461_COMMAND_NULL;
+    frame.checksum = 0;
+}
+
+void LD2461Parser::reset_stats()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+const ld2461_parser_stats_t* LD2461Parser::get_stats()
+{
+    return &stats;
+}
+
+size_t LD2461Parser::write_window(uint8_t** window)
+{
+    size_t free_space = LD2461_PARSER_BUFFER_SIZE - (head - tail);
+    size_t offset = head & LD2461_PARSER_MASK;
+    size_t contiguous = LD2461_PARSER_BUFFER_SIZE - offset;
+    *window = buffer + offset;
+    return (free_space < contiguous) ? free_space : contiguous;
+}
+
+void LD2461Parser::commit(size_t length)
+{
+    head += length;
+}
+
+size_t LD2461Parser::push(const uint8_t* data, size_t length)
+{
+    size_t accepted = 0;
+    while(accepted < length)
+    {
+        uint8_t* window;
+        size_t space = this->write_window(&window);
+        if(space == 0) break;
+        size_t chunk = (length - accepted < space) ? (length - accepted) : space;
+        memcpy(window, data + accepted, chunk);
+        this->commit(chunk);
+        accepted += chunk;
+    }
+    stats.overruns += length - accepted;
+    return accepted;
+}
+
+size_t LD2461Parser::pending()
+{
+    return head - scan;
+}
+
+void LD2461Parser::rewind()
+{
+    // The header byte of the rejected frame is lost, everything after it is parsed again
+    scan = tail + 1;
+    tail = scan;
+    state = LD2461_PARSER_HEADER_0;
+    stats.discarded_bytes++;
+}
+
+bool LD2461Parser::next_frame(ld2461_frame_t* out)
+{
+    while(scan != head)
+    {
+        size_t offset = scan & LD2461_PARSER_MASK;
+        size_t contiguous = LD2461_PARSER_BUFFER_SIZE - offset;
+        if(head - scan < contiguous) contiguous = head - scan;
+
+        if(state == LD2461_PARSER_HEADER_0)
+        {
+            // Skip everything that can not start a header in one go
+            const uint8_t* found = (const uint8_t*)memchr(buffer + offset, 0xFF, contiguous);
+            size_t skipped = (found != NULL) ? (size_t)(found - (buffer + offset)) : contiguous;
+            stats.discarded_bytes += skipped;
+            scan += skipped;
+            tail = scan;
+            if(found != NULL)
+            {
+                scan++;
+                state = LD2461_PARSER_HEADER_1;
+            }
+            continue;
+        }
+
+        if(state == LD2461_PARSER_COMMAND_VALUE)
+        {
+            // Copy as much of the Command Value as it is contiguous
+            size_t remaining = (frame.data_length - 1) - value_index;
+            size_t chunk = (remaining < contiguous) ? remaining : contiguous;
+            const uint8_t* source = buffer + offset;
+            uint8_t* destination = frame.command_value + value_index;
+            for(size_t i=0; i<chunk; i++)
+            {
+                destination[i] = source[i];
+                checksum += source[i];
+            }
+            value_index += chunk;
+            scan += chunk;
+            if(value_index == frame.data_length - 1) state = LD2461_PARSER_CHECKSUM;
+            continue;
+        }
+
+        uint8_t byte = buffer[offset];
+        scan++;
+        switch(state)
+        {
+            case LD2461_PARSER_HEADER_1:
+                if(byte == 0xEE) {state = LD2461_PARSER_HEADER_2;}
+                else if(byte == 0xFF) {stats.discarded_bytes++; tail = scan - 1;}
+                else {stats.discarded_bytes += 2; tail = scan; state = LD2461_PARSER_HEADER_0;}
+                break;
+            case LD2461_PARSER_HEADER_2:
+                if(byte == 0xDD) {state = LD2461_PARSER_LENGTH_H;}
+                else if(byte == 0xFF) {stats.discarded_bytes += 2; tail = scan - 1; state = LD2461_PARSER_HEADER_1;}
+                else {stats.discarded_bytes += 3; tail = scan; state = LD2461_PARSER_HEADER_0;}
+                break;
+            case LD2461_PARSER_LENGTH_H:
+                frame.data_length = byte << 8;
+                state = LD2461_PARSER_LENGTH_L;
+                break;
+            case LD2461_PARSER_LENGTH_L:
+                frame.data_length |= byte;
+                if(frame.data_length == 0 || frame.data_length > LD2461_MAX_COMMAND_VALUE + 1)
+                {
+                    stats.length_errors++;
+                    this->rewind();
+                    break;
+                }
+                state = LD2461_PARSER_COMMAND_WORD;
+                break;
+            case LD2461_PARSER_COMMAND_WORD:
+                frame.command_word = (ld2461_command_word_t)byte;
+                checksum = byte;
+                value_index = 0;
+                state = (frame.data_length > 1) ? LD2461_PARSER_COMMAND_VALUE : LD2461_PARSER_CHECKSUM;
+                break;
+            case LD2461_PARSER_CHECKSUM:
+                frame.checksum = byte;
+                state = LD2461_PARSER_END_0;
+                break;
+            case LD2461_PARSER_END_0:
+                if(byte != 0xDD) {stats.trailer_errors++; this->rewind(); break;}
+                state = LD2461_PARSER_END_1;
+                break;
+            case LD2461_PARSER_END_1:
+                if(byte != 0xEE) {stats.trailer_errors++; this->rewind(); break;}
+                state = LD2461_PARSER_END_2;
+                break;
+            case LD2461_PARSER_END_2:
+                if(byte != 0xFF) {stats.trailer_errors++; this->rewind(); break;}
+                if(frame.checksum != checksum) {stats.checksum_errors++; this->rewind(); break;}
+
+                out->data_length = frame.data_length;
+                out->command_word = frame.command_word;
+                out->checksum = frame.checksum;
+                memcpy(out->command_value, frame.command_value, frame.data_length - 1);
+                stats.frames++;
+                tail = scan;
+                state = LD2461_PARSER_HEADER_0;
+                return true;
+            default:
+                this->rewind();
+                break;
+        }
+    }
+    return false;
+}
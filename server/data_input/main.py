@@ -9,7 +9,7 @@ import logging
 import aiomqtt
 import sys
 import asyncio
-from datetime import datetime
+from datetime import datetime, timezone
 import os
 
 database = DB()
@@ -54,6 +54,25 @@ async def raw_to_jsonl(payload, topic):
         f.write(f"{now};{payload}\n")
     
 
+async def events_to_jsonl(payload, topic):
+    """Saves the crossing events into a JSON Lines, one event per line"""
+    now = datetime.now()
+    today = now.strftime("%Y-%m-%d")
+    directory = f"sensor_events/{topic[3]}"
+    filepath = f"{directory}/{today}-events.jsonl"
+    os.makedirs(directory, exist_ok=True)
+    data = json.loads(payload)
+    with open(filepath, "a") as f:
+        for event in data["events"]:
+            event["mcu_timestamp"] = str(mcu_timestamp(event))
+            f.write(f"{json.dumps(event)}\n")
+
+def mcu_timestamp(data):
+    """UTC time sent by the sensor (microseconds), None when its clock was not set"""
+    if not data.get("ts"):
+        return None
+    return datetime.fromtimestamp(data["ts"] / 1000000, tz=timezone.utc)
+
 async def sensor003_payload(payload, topic: list[str]):
     #print(f"{topic[3]} | {topic[4]}: {payload.payload.decode()}")
     match topic[4]:
@@ -62,6 +81,7 @@ async def sensor003_payload(payload, topic: list[str]):
             sensor_data = SensorData(
                 sensor_id=topic[3],
                 timestamp=datetime.now(),
+                mcu_timestamp=mcu_timestamp(data),
                 entered=data["entered"],
                 exited=data["exited"],
                 gave_up=data["gave_up"]
@@ -74,6 +94,7 @@ async def sensor003_payload(payload, topic: list[str]):
             sensor_internal_data = SensorInternalData(
                 sensor_id=topic[3],
                 timestamp=datetime.now(),
+                mcu_timestamp=mcu_timestamp(data),
                 internal_temperature=data["internal_temperature"],
                 free_memory=data["free_memory"],
                 rssi=data["rssi"],
@@ -85,6 +106,8 @@ async def sensor003_payload(payload, topic: list[str]):
             #    print(f"{topic[3]} | {topic[4]}: {payload.payload.decode()}")
         case "raw":
             await raw_to_jsonl(payload.payload.decode(), topic)
+        case "events":
+            await events_to_jsonl(payload.payload.decode(), topic)
         case "log":
             await store_sensor_log(payload.payload.decode(), topic)
         case _:
@@ -0,0 +1,63 @@
+/*
+Command Fuzz Target
+-------------------
+Arbitrary server commands through process_server_message() on the host
+firmware, then a few reports so the detection runs with whatever area,
+zones, mounts and rules the command left. A fresh firmware on an erased
+storage runs every input. Built only with cJSON (SETE003_HOST_COMMS).
+
+Input: the topic (after <root>/command, e.g. "/detection_area/set") up to the
+first newline, the payload after it. "/reset" is not sent, esp_restart()
+ends the host program.
+*/
+
+#include <stdint.h>
+
+#include <string>
+
+#include "esp_log.h"
+#include "host_firmware.hpp"
+#include "ld2461_codec.hpp"
+
+#define FUZZ_EPOCH 1735689600000000LL   // 2025-01-01 00:00:00 UTC (us)
+#define FUZZ_BOOT_TIME 1000000          // Microseconds from boot to the command
+#define FUZZ_REPORT_PERIOD 100000       // Microseconds between the reports after the command
+
+static MemoryStorage fuzz_storage;
+
+// Someone walking through the default detection area, radar coordinates (0.1m)
+static const ld2461_coordinate_t fuzz_walk[] = {{0, 35}, {0, 30}, {0, 25}, {0, 20}, {0, 15}, {0, 10}};
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+    host_set_storage(&fuzz_storage);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    std::string input((const char*)data, size);
+    size_t newline = input.find('\n');
+    std::string topic = input.substr(0, newline);
+    std::string payload = (newline == std::string::npos) ? "" : input.substr(newline + 1);
+    if(topic == "/reset") return 0;
+
+    fuzz_storage.clear();
+    {
+        HostFirmware firmware(1, FUZZ_EPOCH);
+        firmware.advance(FUZZ_BOOT_TIME);
+        firmware.command(topic, payload);
+
+        int64_t time = FUZZ_BOOT_TIME;
+        for(const ld2461_coordinate_t& target : fuzz_walk)
+        {
+            uint8_t bytes[LD2461_MAX_FRAME_SIZE];
+            size_t length = ld2461_encode_report(bytes, sizeof(bytes), &target, 1);
+            time += FUZZ_REPORT_PERIOD;
+            firmware.receive_bytes(0, bytes, length, time);
+        }
+        firmware.advance(time + 60000000);
+    }
+    return 0;
+}
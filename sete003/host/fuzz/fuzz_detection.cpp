@@ -0,0 +1,57 @@
+/*
+Detection Fuzz Target
+---------------------
+Arbitrary bytes on the radar UARTs of the host firmware: every frame the
+parser completes goes through the radar pipeline (decode, ghost filter,
+tracker, mount) and is counted by the detection, with its timers firing as
+the clock moves. A fresh firmware on an erased storage runs every input.
+
+Input: byte 0 is the UART chunk size (low 7 bits, 0 sends everything at
+once) and, in the high bit, two radars taking the chunks in turns. The rest
+is the byte stream, a chunk arrives every FUZZ_CHUNK_PERIOD.
+*/
+
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "host_firmware.hpp"
+
+#define FUZZ_EPOCH 1735689600000000LL   // 2025-01-01 00:00:00 UTC (us)
+#define FUZZ_BOOT_TIME 1000000          // Microseconds from boot to the first chunk
+#define FUZZ_CHUNK_PERIOD 50000         // Microseconds between chunks, a report every ~100 ms like the radar
+
+static MemoryStorage fuzz_storage;
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+    esp_log_level_set("*", ESP_LOG_NONE);
+    host_set_storage(&fuzz_storage);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(size < 1) return 0;
+    size_t chunk = data[0] & 0x7F;
+    uint8_t radar_count = (data[0] & 0x80) ? 2 : 1;
+    data++;
+    size--;
+    if(chunk == 0) chunk = (size > 0) ? size : 1;
+
+    fuzz_storage.clear();
+    {
+        HostFirmware firmware(radar_count, FUZZ_EPOCH);
+        int64_t time = FUZZ_BOOT_TIME;
+        uint8_t radar = 0;
+        for(size_t offset=0; offset<size; offset+=chunk)
+        {
+            size_t length = (size - offset < chunk) ? size - offset : chunk;
+            firmware.receive_bytes(radar, data + offset, length, time);
+            time += FUZZ_CHUNK_PERIOD;
+            radar = (radar + 1) % radar_count;
+        }
+        // Occupancy timeout and the last publication
+        firmware.advance(time + 60000000);
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+LD2461 Parser Fuzz Target
+-------------------------
+Arbitrary bytes through LD2461Parser, as the UART of a radar would deliver
+them, and every complete frame at the start of the input through
+ld2461_decode_frame(). A frame that comes out must hold what the radar can
+send (data length within the Command Value buffer, valid checksum) and must
+encode back to the same bytes.
+
+Input: byte 0 is the UART chunk size (0 pushes everything at once), the rest
+is the byte stream.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ld2461_codec.hpp"
+#include "ld2461_parser.hpp"
+
+static void check_frame(const ld2461_frame_t* frame)
+{
+    if(frame->data_length == 0 || frame->data_length > LD2461_MAX_COMMAND_VALUE + 1) abort();
+    size_t value_length = frame->data_length - 1;
+    if(frame->checksum != ld2461_checksum(frame->command_word, frame->command_value, value_length)) abort();
+
+    // Encoded again it is the same frame
+    uint8_t bytes[LD2461_MAX_FRAME_SIZE + 1];
+    size_t size = ld2461_encode_frame(bytes, sizeof(bytes), frame->command_word, frame->command_value, value_length);
+    ld2461_frame_t decoded;
+    if(size == 0 || ld2461_decode_frame(bytes, size, &decoded) != size) abort();
+    if(decoded.data_length != frame->data_length || memcmp(decoded.command_value, frame->command_value, value_length) != 0) abort();
+
+    ld2461_coordinate_t targets[LD2461_MAX_COMMAND_VALUE / 2];
+    if(ld2461_decode_report(frame, targets, LD2461_MAX_COMMAND_VALUE / 2) > LD2461_MAX_COMMAND_VALUE / 2) abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(size < 1) return 0;
+    size_t chunk = data[0];
+    data++;
+    size--;
+    if(chunk == 0) chunk = size;
+
+    ld2461_frame_t frame;
+    if(ld2461_decode_frame(data, size, &frame) > 0) check_frame(&frame);
+
+    LD2461Parser parser;
+    size_t offset = 0;
+    while(offset < size)
+    {
+        size_t length = (size - offset < chunk) ? size - offset : chunk;
+        size_t accepted = parser.push(data + offset, length);
+        offset += accepted;
+        while(parser.next_frame(&frame)) check_frame(&frame);
+        if(parser.pending() > LD2461_PARSER_BUFFER_SIZE) abort();
+        if(accepted == 0) parser.reset();   // Full of bytes that are not a frame yet, the UART driver drops them
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+Fuzz Driver
+-----------
+main() of the fuzz targets when libFuzzer is not available (GCC, or
+SETE003_LIBFUZZER off): runs LLVMFuzzerTestOneInput() once per input file,
+directories are read one level deep like a libFuzzer corpus, then prints the
+executions per second. No mutation, it replays a corpus or a crash file
+found by a libFuzzer build.
+
+Usage: fuzz_<target> [-runs=N] FILE|DIR...
+       -runs=N runs every input N times (for the exec/s), other -flags are ignored
+*/
+
+#include <chrono>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+extern "C" __attribute__((weak)) int LLVMFuzzerInitialize(int* argc, char*** argv);
+
+static bool read_file(const std::string& path, std::vector<uint8_t>* data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == NULL) return false;
+    data->clear();
+    uint8_t buffer[4096];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), file)) > 0) data->insert(data->end(), buffer, buffer + length);
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Files of a path, the regular files of a directory in name order
+ */
+static void list_inputs(const char* path, std::vector<std::string>* inputs)
+{
+    struct stat info;
+    if(stat(path, &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        inputs->push_back(path);
+        return;
+    }
+    DIR* dir = opendir(path);
+    if(dir == NULL) return;
+    std::vector<std::string> files;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        std::string file = std::string(path) + "/" + entry->d_name;
+        if(stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) files.push_back(file);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    inputs->insert(inputs->end(), files.begin(), files.end());
+}
+
+int main(int argc, char** argv)
+{
+    if(LLVMFuzzerInitialize != NULL) LLVMFuzzerInitialize(&argc, &argv);
+
+    long runs = 1;
+    std::vector<std::string> inputs;
+    for(int i=1; i<argc; i++)
+    {
+        if(strncmp(argv[i], "-runs=", 6) == 0) runs = strtol(argv[i] + 6, NULL, 10);
+        else if(argv[i][0] == '-') fprintf(stderr, "%s: %s ignored without libFuzzer\n", argv[0], argv[i]);
+        else list_inputs(argv[i], &inputs);
+    }
+    if(inputs.empty() || runs < 1)
+    {
+        fprintf(stderr, "Usage: %s [-runs=N] FILE|DIR...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> data;
+    size_t bytes = 0;
+    uint64_t executions = 0;
+    double elapsed = 0;
+    for(const std::string& input : inputs)
+    {
+        if(!read_file(input, &data))
+        {
+            fprintf(stderr, "%s: can not read %s\n", argv[0], input.c_str());
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for(long run=0; run<runs; run++) LLVMFuzzerTestOneInput(data.data(), data.size());
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bytes += data.size();
+        executions += runs;
+    }
+    printf("%zu inputs (%zu bytes), %llu executions in %.3f s, %.0f exec/s\n",
+        inputs.size(), bytes, (unsigned long long)executions, elapsed, elapsed > 0 ? executions / elapsed : 0);
+    return 0;
+}
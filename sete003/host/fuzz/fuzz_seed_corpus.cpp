@@ -0,0 +1,180 @@
+/*
+Fuzz Seed Corpus
+----------------
+Writes the seed corpus of the fuzz targets from raw radar recordings (the
+"<time>;{"t_0": ...}" JSONL of server/data_input, or the data_sender ones in
+tools/test_env): every recording is cut in runs of FUZZ_SEED_REPORTS reports,
+encoded as RADAR_REPORT_1 frames. Seeds with the command frames of the
+driver and a sample of every server command are added.
+
+    OUTDIR/ld2461_parser/   chunk size byte + frames (fuzz_ld2461_parser.cpp)
+    OUTDIR/detection/       chunk size and radars byte + frames (fuzz_detection.cpp)
+    OUTDIR/comms/           topic, newline, payload (fuzz_comms.cpp)
+
+Usage: fuzz_seed_corpus [--max N] OUTDIR RECORDING.jsonl...
+       --max N seeds per recording and target, spread over it (default 16)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "ld2461_codec.hpp"
+#include "replay.hpp"
+
+#define FUZZ_SEED_REPORTS 32    // Reports per seed, ~3 s of a radar
+
+// Chunk size bytes the seeds take in turns: all at once, byte by byte, UART sized, two radars
+static const uint8_t parser_chunks[] = {0, 1, 13, 64};
+static const uint8_t detection_chunks[] = {0, 1, 24, 0x80 | 24};
+
+static const char* const command_seeds[] = {
+    "/update\n{\"url\": \"https://example.com/sete003.bin\"}",
+    "/detection_area/set\n{\"D0\": {\"x\": -2, \"y\": 3},\"D1\": {\"x\": -2, \"y\": 1.8},\"D2\": {\"x\": 2, \"y\": 1.8},"
+        "\"D3\": {\"x\": 2, \"y\": 3},\"S0\": {\"x\": -2, \"y\": 1.8},\"S1\": {\"x\": 2, \"y\": 1.8}}",
+    "/detection_area/set\n{\"zones\": [{\"vertices\": [{\"x\": -2, \"y\": 3},{\"x\": 2, \"y\": 3},{\"x\": 2, \"y\": 1.8},{\"x\": -2, \"y\": 1.8}],"
+        "\"line\": [{\"x\": -2, \"y\": 2.4},{\"x\": 2, \"y\": 2.4}]}]}",
+    "/detection_area/set\n{\"zones\": [{\"vertices\": [{\"x\": -1, \"y\": 3},{\"x\": 1, \"y\": 3},{\"x\": 0, \"y\": 1}],"
+        "\"sides\": [\"TOP\", \"RIGHT\", \"LEFT\"],\"line\": [{\"x\": -1, \"y\": 2},{\"x\": 1, \"y\": 2}]}]}",
+    "/detection_area/get\n",
+    "/detection_area/invert\n",
+    "/counting_mode/set\nline",
+    "/counting_mode/get\n",
+    "/occupancy/set\n3",
+    "/occupancy/config/set\n{\"max\": 10, \"reset_time\": \"22:00\", \"empty_timeout\": 3600}",
+    "/occupancy/get\n",
+    "/speed_gate/set\n2",
+    "/speed_gate/get\n",
+    "/raw_data\n1",
+    "/payload_buffer_time/set\n10",
+    "/payload_buffer_time/get\n",
+    "/ghost_timer/set\n2000",
+    "/ghost_timer/get\n",
+    "/threshold_distance/set\n0.5",
+    "/threshold_distance/get\n",
+    "/radar/mount/set\n{\"radar\": 0, \"rotation\": 90, \"x\": 0.5, \"y\": -0.2, \"enabled\": true}",
+    "/radar/mount/get\n",
+    "/classifier/set\n{\"rules\": [{\"entered\": \"TOP\", \"exited\": \"BOTTOM\", \"trusted\": true, \"event\": \"entered\", \"reason\": 0}]}",
+    "/classifier/get\n",
+    "/classifier/reset\n",
+};
+
+static bool write_seed(const std::string& dir, int* index, const std::vector<uint8_t>& data)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/seed-%05d", (*index)++);
+    FILE* file = fopen((dir + name).c_str(), "wb");
+    if(file == NULL) return false;
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return (fclose(file) == 0) && written;
+}
+
+static std::vector<uint8_t> seed_of(uint8_t header, const std::vector<uint8_t>& stream)
+{
+    std::vector<uint8_t> seed(stream.size() + 1);
+    seed[0] = header;
+    if(!stream.empty()) memcpy(&seed[1], stream.data(), stream.size());
+    return seed;
+}
+
+/**
+ * @brief Encode every report of a recording as a frame, a stream per FUZZ_SEED_REPORTS reports
+ */
+static bool load_recording(const char* path, std::vector<std::vector<uint8_t>>* streams)
+{
+    FILE* file = fopen(path, "r");
+    if(file == NULL) return false;
+
+    char* line = NULL;
+    size_t capacity = 0;
+    raw_record_t record;
+    std::vector<uint8_t> stream;
+    int reports = 0;
+    while(getline(&line, &capacity, file) > 0)
+    {
+        if(!raw_record_parse(line, &record)) continue;
+        uint8_t frame[LD2461_MAX_FRAME_SIZE];
+        size_t size = ld2461_encode_report(frame, sizeof(frame), record.report.target,
+            ld2461_report_length(record.report.target, MAX_TARGETS_DETECTION));
+        stream.insert(stream.end(), frame, frame + size);
+        if(++reports == FUZZ_SEED_REPORTS)
+        {
+            streams->push_back(stream);
+            stream.clear();
+            reports = 0;
+        }
+    }
+    if(reports > 0) streams->push_back(stream);
+    free(line);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    long max = 16;
+    int first = 1;
+    if(argc > 2 && strcmp(argv[1], "--max") == 0)
+    {
+        max = strtol(argv[2], NULL, 10);
+        first = 3;
+    }
+    if(argc - first < 1 || max < 1)
+    {
+        fprintf(stderr, "Usage: %s [--max N] OUTDIR RECORDING.jsonl...\n", argv[0]);
+        return 2;
+    }
+
+    std::string out = argv[first];
+    const std::string dirs[3] = {out + "/ld2461_parser", out + "/detection", out + "/comms"};
+    mkdir(out.c_str(), 0755);
+    for(const std::string& dir : dirs) mkdir(dir.c_str(), 0755);
+    int parser_index = 0, detection_index = 0, comms_index = 0;
+    bool written = true;
+
+    // The frames the driver sends, an empty report and a frame behind garbage
+    const uint8_t* frames[] = {LD2461_FRAME_VERSION_REQUEST.bytes, LD2461_FRAME_READ_AREAS.bytes,
+        LD2461_FRAME_WITHDRAW_AREAS.bytes, LD2461_FRAME_RESET.bytes, LD2461_FRAME_EMPTY_REPORT.bytes};
+    const size_t sizes[] = {LD2461_FRAME_VERSION_REQUEST.size, LD2461_FRAME_READ_AREAS.size,
+        LD2461_FRAME_WITHDRAW_AREAS.size, LD2461_FRAME_RESET.size, LD2461_FRAME_EMPTY_REPORT.size};
+    for(int i=0; i<5; i++)
+    {
+        written &= write_seed(dirs[0], &parser_index, seed_of(0, std::vector<uint8_t>(frames[i], frames[i] + sizes[i])));
+    }
+    std::vector<uint8_t> garbage = {0xFF, 0xEE, 0xDD, 0x00, 0x00, 0x12, 0xFF, 0xEE};
+    garbage.insert(garbage.end(), frames[4], frames[4] + sizes[4]);
+    written &= write_seed(dirs[0], &parser_index, seed_of(0, garbage));
+
+    for(const char* command : command_seeds)
+    {
+        written &= write_seed(dirs[2], &comms_index, std::vector<uint8_t>(command, command + strlen(command)));
+    }
+
+    for(int i=first+1; i<argc; i++)
+    {
+        std::vector<std::vector<uint8_t>> streams;
+        if(!load_recording(argv[i], &streams))
+        {
+            fprintf(stderr, "%s: can not read %s\n", argv[0], argv[i]);
+            return 1;
+        }
+        size_t count = (streams.size() < (size_t)max) ? streams.size() : (size_t)max;
+        for(size_t n=0; n<count; n++)
+        {
+            const std::vector<uint8_t>& stream = streams[n * streams.size() / count];
+            written &= write_seed(dirs[0], &parser_index, seed_of(parser_chunks[n % sizeof(parser_chunks)], stream));
+            written &= write_seed(dirs[1], &detection_index, seed_of(detection_chunks[n % sizeof(detection_chunks)], stream));
+        }
+    }
+    if(!written)
+    {
+        fprintf(stderr, "%s: can not write the corpus in %s\n", argv[0], out.c_str());
+        return 1;
+    }
+    printf("%d ld2461_parser, %d detection and %d comms seeds in %s\n", parser_index, detection_index, comms_index, out.c_str());
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+Counting Accuracy
+-----------------
+Compares crossing times against a reference. A detected crossing and a
+reference crossing match when they are at most a window apart, each one
+matches once. The logs/<day>/ exports give the times:
+
+    data_by_two_*.csv   "id","timestamp","sensor_id","traversed"
+    sensor_data_*.csv   id,timestamp,sensor_id,entered,exited,gave_up
+
+data_by_two is the line crossing counter of server/data_input_bkp, it sums
+the crossings of 5 s. sensor_data holds the firmware counters, published every
+payload_buffer_time. A row counts its crossings at the time it was stored, so
+the window has to cover those periods.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#define ACCURACY_DEFAULT_WINDOW 15000000   // Microseconds, longer than the firmware publish period
+
+typedef struct accuracy{
+    uint32_t detected;
+    uint32_t reference;
+    uint32_t matched;
+    double precision;           // matched / detected, 1 if nothing was detected
+    double recall;              // matched / reference, 1 if there is no reference
+    double net_error;           // |detected - reference| / reference
+}accuracy_t;
+
+/**
+ * @brief Read the crossing times of a counters CSV export
+ * @note A row with N crossings adds its time N times
+ *
+ * @param file CSV with a header, read until its end
+ * @param columns Header names of the columns summed as crossings
+ * @param columns_count Number of columns
+ * @param times Where to add the times (UTC, us), sorted
+ * @return true If the header had the timestamp and every column
+ */
+bool counts_csv_read(FILE* file, const char* const* columns, int columns_count, std::vector<int64_t>* times);
+
+/**
+ * @brief Match detected crossings against the reference
+ *
+ * @param detected Detected crossing times (us), sorted
+ * @param reference Reference crossing times (us), sorted
+ * @param window Largest time between matching crossings (us)
+ * @param result Where to store the counts and ratios
+ */
+void accuracy_match(const std::vector<int64_t>& detected, const std::vector<int64_t>& reference,
+    int64_t window, accuracy_t* result);
+
+/**
+ * @brief Set the ratios of an accuracy from its counts
+ */
+void accuracy_ratios(accuracy_t* result);
+
+/**
+ * @brief Add the counts of an accuracy to a total (days, directions) and set its ratios again
+ */
+void accuracy_add(accuracy_t* total, const accuracy_t* accuracy);
+
+/**
+ * @brief Crossing times during a recording
+ *
+ * @param times Crossing times (us), sorted
+ * @param first UTC (us) of the first report of the recording
+ * @param last UTC (us) of the last report
+ * @param window Margin around the recording (us), the exports count a crossing after it happened
+ */
+std::vector<int64_t> accuracy_span(const std::vector<int64_t>& times, int64_t first, int64_t last, int64_t window);
+
+typedef struct accuracy_day{
+    std::string name;                   // DD-MM-YY, the logs/ directory
+    std::string reference_path;         // data_by_two export
+    bool has_reference;                 // The export had the timestamp and traversed columns
+    std::vector<int64_t> reference;     // Crossing times of data_by_two (us), sorted
+    bool has_firmware;                  // A sensor_data export was read
+    std::vector<int64_t> entered;       // Crossing times of the firmware counters (us), sorted
+    std::vector<int64_t> exited;
+    std::vector<int64_t> firmware;      // Both directions
+    std::string raw_path;               // Raw recording of the day, it may not exist
+}accuracy_day_t;
+
+/**
+ * @brief Read the days of a logs/ directory that have a data_by_two export, in date order
+ *
+ * @param logs_dir Directory of the logs/<DD-MM-YY>/ exports
+ * @param raw_dir Raw recordings, <raw_dir>/<sensor_id>/<YYYY-MM-DD>-ld2461.jsonl
+ * @param sensor_id Sensor of the recordings
+ * @param days Where to add the days
+ * @return true If logs_dir could be read
+ */
+bool accuracy_days_read(const char* logs_dir, const char* raw_dir, const char* sensor_id, std::vector<accuracy_day_t>* days);
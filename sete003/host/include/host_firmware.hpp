@@ -0,0 +1,83 @@
+/*
+Host Firmware
+-------------
+The firmware objects app_main creates (Storage, Sensor, LD2461s, PIR, MQTT,
+Detection) built on the host and wired like on the ESP32: a radar frame goes
+through LD2461::dispatch_frame() (decode, ghost filter, tracker, mount), the
+detection task is notified and counts it, and the detection timers fire as
+the simulated clock moves. Everything runs on the caller thread.
+
+The firmware objects are globals, only one HostFirmware may exist at a time.
+The storage and publisher set with host_set_storage() / host_set_publisher()
+are used, the clock is the SimulatedClock of the HostFirmware.
+
+    HostFirmware firmware(1);
+    firmware.receive_frame(0, &frame, arrival_time);   // Counted before it returns
+    firmware.advance(arrival_time + 10000000);         // Publishes the counters
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "host_platform.hpp"
+#include "detection.hpp"
+#include "ld2461.hpp"
+
+// Firmware globals, set while a HostFirmware exists
+extern Detection* detection;
+extern LD2461* radars[MAX_RADARS];
+extern uint8_t radars_count;
+
+class HostFirmware{
+private:
+    SimulatedClock clock;
+    LD2461Parser parsers[MAX_RADARS];   // For receive_bytes()
+public:
+    /**
+     * @param radar_count LD2461 instances (1 to MAX_RADARS)
+     * @param epoch UTC (us since the epoch) at boot, 0 for a clock never set by SNTP
+     */
+    HostFirmware(uint8_t radar_count = 1, int64_t epoch = 0);
+    ~HostFirmware();
+
+    SimulatedClock* get_clock();
+
+    /**
+     * @brief Move the clock to a time, running the timers due on the way (occupancy, publications)
+     */
+    void advance(int64_t time);
+
+    /**
+     * @brief A radar sent a frame, reports are counted before it returns
+     *
+     * @param radar Radar that sent it
+     * @param frame Valid frame
+     * @param arrival_time esp_timer time of the frame end, the clock is moved there first
+     */
+    void receive_frame(uint8_t radar, ld2461_frame_t* frame, int64_t arrival_time);
+
+    /**
+     * @brief Count a report that already went through the radar pipeline (world coordinates)
+     * @note What the detection task does with a report it pops, without the RX queue
+     *
+     * @param radar Radar that sent it
+     * @param report Report, its timestamp is the arrival time and the clock is moved there first
+     */
+    void receive_report(uint8_t radar, ld2461_detection_t* report);
+
+    /**
+     * @brief A radar sent bytes, every frame completed by them is received at rx_time
+     */
+    void receive_bytes(uint8_t radar, const uint8_t* data, size_t length, int64_t rx_time);
+
+#ifdef SETE003_HOST_COMMS
+    /**
+     * @brief A server command arrived (topic after <root>/command, e.g. "/detection_area/set")
+     */
+    void command(const std::string& topic, const std::string& data);
+#endif
+};
@@ -0,0 +1,167 @@
+/*
+Raw Recording Replay
+--------------------
+The /raw payloads of the firmware are stored by server/data_input/main.py as
+one line per report:
+
+    2025-02-18 14:51:56.468148;{"t_0": {"id": 1,"x": -0.500000,"y": 2.500000,...},...,"radar": 0,"ts": 123}
+
+The time before ';' is when the server received the report (local time, read
+as UTC here), "id", "radar" and "ts" only exist in newer recordings. Lines
+without the server time use "ts", lines with no time at all are taken
+REPLAY_REPORT_PERIOD apart (the LD2461 report rate). The positions are in
+world coordinates and already went through the radar pipeline (ghost filter,
+tracker, mount), so they are counted straight away. With radar_pipeline they are sent as LD2461
+frames instead and go through the pipeline again (e.g. to profile it).
+
+A replay runs a HostFirmware on a SimulatedClock that follows the recording,
+so it takes as long as the counting does, not as long as the recording.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "detection.hpp"
+#include "host_firmware.hpp"
+
+#define REPLAY_REPORT_PERIOD 100000  // Microseconds between the reports of a recording without times
+#define REPLAY_BOOT_TIME 1000000     // Microseconds from boot to the first report
+
+typedef struct raw_record{
+    bool timed;                 // The line had a time
+    int64_t time;               // UTC (us), 0 if not timed
+    uint8_t radar;
+    ld2461_detection_t report;  // Decimeters, timestamp not set
+}raw_record_t;
+
+/**
+ * @brief Read a "YYYY-MM-DD HH:MM:SS[.ffffff]" time as UTC
+ *
+ * @param text Time, anything after it is ignored
+ * @param time Where to store the time (us)
+ * @return true If text starts with a time
+ */
+bool record_time_parse(const char* text, int64_t* time);
+
+/**
+ * @brief Parse a line of a raw recording
+ *
+ * @param line Line, with or without the server time
+ * @param record Where to store the report
+ * @return true If the line had a report
+ */
+bool raw_record_parse(const char* line, raw_record_t* record);
+
+typedef struct replay_recording{
+    std::vector<raw_record_t> records;  // 64 bytes a report, ~55 MB for a day at 10 Hz
+    uint32_t skipped_lines;             // Lines that were not a report
+}replay_recording_t;
+
+/**
+ * @brief Read a recording into memory, to replay it many times (sete_tune)
+ *
+ * @param file Recording, read until its end
+ * @param recording Where to store the reports
+ */
+void replay_recording_read(FILE* file, replay_recording_t* recording);
+
+typedef struct replay_options{
+    uint8_t radars;             // LD2461 instances (1 to MAX_RADARS)
+    bool radar_pipeline;        // Send the positions as frames through the radar pipeline
+    counting_mode_t counting_mode;
+    bool area_set;              // Replace the stored detection area by area
+    point_t area[6];            // D0, D1, D2, D3, S0, S1
+    int64_t publish_period;     // Microseconds, 0 for the firmware default
+    int64_t ghost_timer;        // As /ghost_timer/set (us), negative for the firmware default, radar_pipeline only
+    double threshold_distance;  // As /threshold_distance/set, negative for the firmware default, radar_pipeline only
+    bool enter_exit_inverted;
+}replay_options_t;
+
+/**
+ * @brief Options of a replay with the firmware defaults
+ */
+replay_options_t replay_default_options();
+
+typedef struct replay_event{
+    int64_t timestamp;          // UTC (us)
+    uint8_t type;               // crossing_event_type
+    uint8_t zone;
+    uint16_t track_id;
+    std::string json;           // As published on <root>/events
+}replay_event_t;
+
+typedef struct replay_result{
+    uint32_t reports;
+    uint32_t skipped_lines;             // Lines that were not a report
+    int64_t first_time;                 // UTC (us) of the first and last reports
+    int64_t last_time;
+    uint32_t counts[CROSSING_EVENT_TYPES];  // Summed from the <root>/data publications
+    std::vector<replay_event_t> events;
+    uint32_t dropped_events;            // Overwritten in the firmware ring before they were published
+    int32_t occupancy;                  // Last published
+    detection_latency_t latency;
+}replay_result_t;
+
+class ReplayPublisher;
+
+/**
+ * @brief Counts reports on a new HostFirmware, for recordings and generated reports
+ * @note Only one may exist at a time (HostFirmware)
+ */
+class Replay{
+private:
+    replay_options_t options;
+    replay_result_t* result;
+    int64_t epoch;
+    int64_t time_now;                   // Since boot (us), never goes back
+    ReplayPublisher* publisher;
+    HostPublisher* previous_publisher;
+    HostFirmware* firmware;
+public:
+    /**
+     * @param options Replay options
+     * @param epoch UTC (us) at boot, 0 for a clock never set
+     * @param result Where to store the counts and events, cleared
+     */
+    Replay(const replay_options_t* options, int64_t epoch, replay_result_t* result);
+    ~Replay();
+
+    /**
+     * @brief Count a report
+     *
+     * @param radar Radar that sent it
+     * @param report Report, its timestamp is set to the arrival time
+     * @param time Arrival time since boot (us), an earlier time than the last report is taken as the last
+     */
+    void add(uint8_t radar, ld2461_detection_t* report, int64_t time);
+
+    /**
+     * @brief Time of the last report since boot (us)
+     */
+    int64_t get_time();
+
+    /**
+     * @brief Let the last counters and events be published and read the latency
+     */
+    void finish();
+};
+
+/**
+ * @brief Replay a recording through a new HostFirmware
+ * @note The firmware uses the storage set with host_set_storage(), the zones saved there are counted on
+ *
+ * @param file Recording, read until its end
+ * @param options Replay options
+ * @param result Where to store the counts and events
+ */
+void replay_file(FILE* file, const replay_options_t* options, replay_result_t* result);
+
+/**
+ * @brief Replay a recording read by replay_recording_read() through a new HostFirmware, like replay_file()
+ */
+void replay_recording(const replay_recording_t* recording, const replay_options_t* options, replay_result_t* result);
@@ -0,0 +1,135 @@
+/*
+Scenario Generator
+------------------
+Builds LD2461 reports from a scripted scenario, the same script and seed
+always give the same reports. One command per line, '#' starts a comment,
+times in seconds, positions as x,y in meters (radar coordinates) and speeds in
+m/s:
+
+    rate 10                         # Reports per second (the LD2461 sends 10)
+    duration 30                     # Seconds, otherwise until the last person left
+    seed 1                          # Position noise seed
+    noise 0.05                      # Position noise (m, standard deviation)
+    walk 0 1.2 -1,0.5 -1,4 expect entered
+    walk 2 1.0 1,4 1,2.4 wait 3 1,4 # Loiters 3 s in the door, then turns back
+    crowd 5 6 0.5 1.3 0,0.5 0,4 spread 1.5 expect entered
+    ghost 0 30 1.8,1                # Static target from 0 to 30 s
+    teleport 12 2 -3,5              # Slot 2 jumps to (-3, 5) for one report
+    swap 15 0 1                     # The radar exchanges slots 0 and 1 from 15 s
+
+walk START SPEED P0 P1 [wait S] [P2...] walks through the points, "wait"
+stays at the point before it. crowd START COUNT INTERVAL SPEED FROM TO
+starts COUNT walks INTERVAL apart, moved up to spread meters sideways.
+"expect entered|exited" counts what the walk should be counted as.
+
+A person takes the lowest free slot when it appears and keeps it until it
+leaves, the ones that find every slot taken are not reported (hidden).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ld2461_protocol.hpp"
+
+#define SCENARIO_DEFAULT_RATE 10    // Reports per second
+
+enum scenario_expect{
+    SCENARIO_EXPECT_NONE = 0,
+    SCENARIO_EXPECT_ENTERED,
+    SCENARIO_EXPECT_EXITED,
+    SCENARIO_EXPECT_TYPES
+};
+
+typedef struct scenario_point{
+    float x, y;     // Meters
+}scenario_point_t;
+
+typedef struct scenario_waypoint{
+    scenario_point_t point;
+    float wait;     // Seconds stopped at the point
+}scenario_waypoint_t;
+
+typedef struct scenario_actor{
+    float start;    // Seconds
+    float end;
+    float speed;    // m/s, 0 for a ghost
+    std::vector<scenario_waypoint_t> path;
+    uint8_t expect; // scenario_expect
+    int8_t slot;    // Slot while it is reported, -1 otherwise
+}scenario_actor_t;
+
+typedef struct scenario_spike{
+    float time;     // Seconds
+    uint8_t slot;
+    scenario_point_t point;
+    bool swap;      // Exchange slot and other_slot instead
+    uint8_t other_slot;
+}scenario_spike_t;
+
+class Scenario{
+private:
+    float rate;
+    float duration;                 // 0 until the last actor leaves
+    float noise;
+    uint32_t seed;
+    std::vector<scenario_actor_t> actors;
+    std::vector<scenario_spike_t> spikes;
+
+    // Generation
+    std::mt19937 random;
+    uint32_t report_index;
+    size_t next_spike;
+    uint8_t slot_order[MAX_TARGETS_DETECTION];  // Slot the radar reports each slot in, changed by swaps
+    uint32_t hidden;
+
+    bool parse_walk(char** tokens, int count, scenario_actor_t* actor, std::string* error);
+    float gaussian();
+    scenario_point_t position_at(const scenario_actor_t* actor, float time);
+public:
+    Scenario();
+
+    /**
+     * @brief Add the commands of a script
+     *
+     * @param file Script, read until its end
+     * @param error Line and reason of the first error
+     * @return true If every line was valid
+     */
+    bool parse(FILE* file, std::string* error);
+
+    /**
+     * @brief Add one command
+     *
+     * @param line Command (a comment or blank line is valid)
+     * @param error Reason if it is not valid
+     * @return true If it was valid
+     */
+    bool parse_line(const char* line, std::string* error);
+
+    /**
+     * @brief Start again from the first report, with the same noise
+     */
+    void reset();
+
+    /**
+     * @brief Build the next report
+     *
+     * @param report Where to store it, the timestamp is the time since the start (us)
+     * @return true If the scenario was not over
+     */
+    bool next(ld2461_detection_t* report);
+
+    void set_rate(float rate);
+    void set_seed(uint32_t seed);
+    int64_t get_period();           // Microseconds between reports
+    float get_duration();           // Seconds
+    uint32_t get_expected(uint8_t expect);
+    uint32_t get_hidden();          // Positions not reported so far, every slot was taken
+    size_t get_actors();
+};
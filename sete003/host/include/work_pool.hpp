@@ -0,0 +1,55 @@
+/*
+Work Pool
+---------
+Runs jobs on worker processes that steal work from each other. The firmware
+objects are globals (one HostFirmware per process), so the workers are
+fork()ed processes instead of threads: they see what the caller loaded
+before run() (copy on write) and hand their results back through shared
+memory.
+
+Every worker starts with a contiguous range of the jobs and takes them from
+its front. Once its range is empty it steals the back half of the biggest
+range left, so a worker that drew the long jobs (a busy day) does not keep
+the others waiting.
+
+    WorkPool pool(0);   // A worker per CPU
+    std::vector<result_t> results(count);
+    pool.run(count, sizeof(result_t), results.data(), [&](size_t job, void* result){
+        ((result_t*)result)->value = work_on(job);
+    });
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+
+typedef std::function<void(size_t job, void* result)> work_function_t;
+typedef std::function<void(size_t done, size_t count)> work_progress_t;
+
+class WorkPool{
+private:
+    int workers;
+public:
+    /**
+     * @param workers Worker processes, 0 for one per online CPU
+     */
+    WorkPool(int workers);
+
+    int get_workers();
+
+    /**
+     * @brief Run jobs 0 to count-1 and wait for all of them
+     * @note work runs in the workers, what it changes besides its result is lost
+     *
+     * @param count Number of jobs
+     * @param result_size Bytes of the result of a job (plain data, copied back)
+     * @param results Array of count results, a job writes its own
+     * @param work Runs a job
+     * @param progress Called by the caller process about every second (may be empty)
+     * @return true If every job ran, false if a worker died or could not be started
+     */
+    bool run(size_t count, size_t result_size, void* results, const work_function_t& work,
+        const work_progress_t& progress = work_progress_t());
+};
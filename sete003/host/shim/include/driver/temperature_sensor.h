@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct temperature_sensor_obj* temperature_sensor_handle_t;
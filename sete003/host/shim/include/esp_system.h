@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * @note Exits the host process
+ */
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
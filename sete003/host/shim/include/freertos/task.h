@@ -0,0 +1,51 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+/**
+ * @note Host tasks are created but never run, the caller drives the pipeline (see host_platform.hpp)
+ */
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t task_code,
+    const char* name,
+    uint32_t stack_depth,
+    void* parameters,
+    UBaseType_t priority,
+    TaskHandle_t* created_task,
+    BaseType_t core_id
+);
+BaseType_t xTaskCreate(
+    TaskFunction_t task_code,
+    const char* name,
+    uint32_t stack_depth,
+    void* parameters,
+    UBaseType_t priority,
+    TaskHandle_t* created_task
+);
+void vTaskDelete(TaskHandle_t task);
+
+/**
+ * @note Advances the host clock by the delay
+ */
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+/**
+ * @note Notifications are kept in the task, the waits below only take what is already there
+ */
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
@@ -0,0 +1,112 @@
+/*
+Host Platform
+-------------
+What the ESP32 provides to the firmware, injected by the host program:
+
+    clock       system_clock (clock.hpp): esp_timer_get_time(), the wall clock and every wait
+    storage     the NVS behind the Storage class (HostStorage)
+    publisher   where MQTT::publish() sends the messages (HostPublisher)
+
+Everything runs on the caller thread. Tasks are only run by host_run_tasks(),
+until they wait for a notification that is not there yet, and esp_timers only
+fire inside host_advance(). A wait that can not be satisfied (an UART read, a
+queue receive, vTaskDelay) moves the clock by its timeout, so with a
+SimulatedClock a run is deterministic and as fast as the host can go.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "clock.hpp"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @brief Host monotonic and wall clocks, sleep() really sleeps
+ */
+class SystemClock : public Clock{
+private:
+    int64_t boot;
+public:
+    SystemClock();
+    int64_t now() override;
+    int64_t utc() override;
+    void sleep(int64_t duration) override;
+};
+
+class HostStorage{
+public:
+    virtual ~HostStorage() {}
+
+    /**
+     * @brief Read a value
+     *
+     * @param name_space Storage type name ("SENSORS", "WIFI")
+     * @param key NVS key
+     * @param value Where to copy the value bytes
+     * @return true If the key exists
+     */
+    virtual bool read(const char* name_space, const char* key, std::string* value) = 0;
+    virtual void write(const char* name_space, const char* key, const void* value, size_t length) = 0;
+};
+
+/**
+ * @brief Storage kept in memory, empty like a freshly erased NVS
+ */
+class MemoryStorage : public HostStorage{
+private:
+    std::map<std::string, std::string> values;  // "<name_space>/<key>"
+public:
+    bool read(const char* name_space, const char* key, std::string* value) override;
+    void write(const char* name_space, const char* key, const void* value, size_t length) override;
+    void clear();
+};
+
+class HostPublisher{
+public:
+    virtual ~HostPublisher() {}
+    virtual void publish(const char* topic, const char* payload, bool retain) = 0;
+};
+
+/**
+ * @brief Set the clock, storage and publisher used by the firmware
+ * @note NULL goes back to the default: a SystemClock, a MemoryStorage and no publisher (messages dropped)
+ */
+void host_set_clock(Clock* clock);
+Clock* host_get_clock();
+void host_set_storage(HostStorage* storage);
+HostStorage* host_get_storage();
+void host_set_publisher(HostPublisher* publisher);
+HostPublisher* host_get_publisher();
+
+/**
+ * @brief Move the clock to a time, firing the esp_timers due on the way and running the tasks they notified
+ */
+void host_advance(int64_t time);
+
+/**
+ * @brief Run every task with a pending notification until it waits again
+ */
+void host_run_tasks();
+
+/**
+ * @brief Drop every task, esp_timer, queue and UART buffer the firmware created
+ * @note For a host program that creates the firmware objects again, after deleting them
+ */
+void host_reset();
+
+/**
+ * @brief Bytes sent by the device on the other end of an UART, an UART_DATA event is queued
+ */
+void host_uart_receive(uart_port_t uart_num, const uint8_t* data, size_t length);
+
+/**
+ * @brief Bytes written by the firmware to an UART since the last call (they are taken)
+ */
+std::string host_uart_take_sent(uart_port_t uart_num);
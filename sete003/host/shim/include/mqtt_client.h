@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
@@ -0,0 +1,6 @@
+// OTA on the host, there is no firmware to update
+#pragma once
+
+#include <string>
+
+void ota_update(std::string uri);
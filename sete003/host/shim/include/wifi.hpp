@@ -0,0 +1,7 @@
+// WiFi on the host, only what the firmware sources built for the host use
+#pragma once
+
+class WiFi_STA{
+public:
+    void shutdown();
+};
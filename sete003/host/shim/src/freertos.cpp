@@ -0,0 +1,273 @@
+#include "host_platform.hpp"
+
+#include <string.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+const char* FREERTOS_TAG = "HOST";
+
+/*
+A task runs from its function every time host_run_tasks() finds it notified.
+When it waits for something that is not there it is unwound with
+task_blocked_t and the next run starts it again. The firmware task loops keep
+nothing across their waits, so this is the same as resuming them.
+*/
+struct host_task{
+    TaskFunction_t function;
+    void* parameters;
+    std::string name;
+    uint32_t notification;
+    bool notified;
+    bool deleted;
+};
+
+typedef struct task_blocked{}task_blocked_t;
+
+static std::vector<host_task*> tasks;
+static host_task* current_task = NULL;
+
+/**
+ * @brief Wait for something that is not there
+ * @note Inside a task it unwinds the task, outside it moves the clock by the timeout
+ */
+static void wait_for(TickType_t ticks)
+{
+    if(ticks == 0) return;
+    if(current_task != NULL) throw task_blocked_t();
+    if(ticks == portMAX_DELAY)
+    {
+        ESP_LOGE(FREERTOS_TAG, "Waiting forever outside a task, nothing else runs on the host");
+        abort();
+    }
+    host_get_clock()->sleep((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+// Tasks
+// -----
+
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t task_code,
+    const char* name,
+    uint32_t stack_depth,
+    void* parameters,
+    UBaseType_t priority,
+    TaskHandle_t* created_task,
+    BaseType_t core_id
+)
+{
+    host_task* task = new host_task();
+    task->function = task_code;
+    task->parameters = parameters;
+    task->name = name;
+    task->notification = 0;
+    task->notified = false;
+    task->deleted = false;
+    tasks.push_back(task);
+    if(created_task != NULL) *created_task = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(
+    TaskFunction_t task_code,
+    const char* name,
+    uint32_t stack_depth,
+    void* parameters,
+    UBaseType_t priority,
+    TaskHandle_t* created_task
+)
+{
+    return xTaskCreatePinnedToCore(task_code, name, stack_depth, parameters, priority, created_task, 0);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if(task == NULL) task = current_task;
+    if(task != NULL) task->deleted = true;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_get_clock()->sleep((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_get_clock()->now() / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+void host_run_tasks()
+{
+    bool ran = true;
+    while(ran)
+    {
+        ran = false;
+        for(size_t i=0; i<tasks.size(); i++)
+        {
+            host_task* task = tasks[i];
+            if(task->deleted || !task->notified) continue;
+            host_task* caller = current_task;
+            current_task = task;
+            try
+            {
+                task->function(task->parameters);
+                task->deleted = true; // Returned, a FreeRTOS task must not
+            }
+            catch(task_blocked_t&)
+            {
+            }
+            current_task = caller;
+            ran = true;
+        }
+    }
+}
+
+void host_reset_tasks()
+{
+    for(host_task* task : tasks) delete task;
+    tasks.clear();
+    current_task = NULL;
+}
+
+// Notifications
+// -------------
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if(task == NULL) return pdFAIL;
+    switch(action)
+    {
+        case eSetBits: task->notification |= value; break;
+        case eIncrement: task->notification++; break;
+        case eSetValueWithOverwrite: task->notification = value; break;
+        case eSetValueWithoutOverwrite:
+            if(task->notified) return pdFAIL;
+            task->notification = value;
+            break;
+        default: break;
+    }
+    task->notified = true;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+    host_task* task = current_task;
+    if(task == NULL) return pdFALSE;
+    if(!task->notified)
+    {
+        task->notification &= ~clear_on_entry;
+        wait_for(ticks);
+        return pdFALSE;
+    }
+    if(value != NULL) *value = task->notification;
+    task->notification &= ~clear_on_exit;
+    task->notified = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    host_task* task = current_task;
+    if(task == NULL) return 0;
+    if(task->notification == 0)
+    {
+        task->notified = false;
+        wait_for(ticks);
+        return 0;
+    }
+    uint32_t value = task->notification;
+    task->notification = clear_on_exit ? 0 : value - 1;
+    task->notified = (task->notification != 0);
+    return value;
+}
+
+// Queues
+// ------
+
+struct host_queue{
+    UBaseType_t length;
+    UBaseType_t item_size;
+    std::deque<std::string> items;
+};
+
+static std::vector<host_queue*> queues;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    host_queue* queue = new host_queue();
+    queue->length = length;
+    queue->item_size = item_size;
+    queues.push_back(queue);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    for(size_t i=0; i<queues.size(); i++)
+    {
+        if(queues[i] != queue) continue;
+        queues.erase(queues.begin() + i);
+        break;
+    }
+    delete queue;
+}
+
+// The firmware never deletes its queues (the LD2461 responses), they go with the firmware objects
+void host_reset_queues()
+{
+    for(host_queue* queue : queues) delete queue;
+    queues.clear();
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    if(queue == NULL) return pdFAIL;
+    if(queue->items.size() >= queue->length)
+    {
+        wait_for(ticks);
+        return pdFAIL; // Nothing else runs to take an item
+    }
+    queue->items.push_back(std::string((const char*)item, queue->item_size));
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    if(queue == NULL) return pdFALSE;
+    if(queue->items.empty())
+    {
+        wait_for(ticks);
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    if(queue != NULL) queue->items.clear();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return (queue != NULL) ? queue->items.size() : 0;
+}
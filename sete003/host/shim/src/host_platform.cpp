@@ -0,0 +1,360 @@
+#include "host_platform.hpp"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+static SystemClock host_system_clock;
+static MemoryStorage memory_storage;
+
+Clock* system_clock = &host_system_clock;
+static HostStorage* storage_in_use = &memory_storage;
+static HostPublisher* publisher_in_use = NULL;
+
+// Clocks
+// ------
+
+SystemClock::SystemClock()
+{
+    this->boot = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t SystemClock::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - this->boot;
+}
+
+int64_t SystemClock::utc()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void SystemClock::sleep(int64_t duration)
+{
+    if(duration > 0) std::this_thread::sleep_for(std::chrono::microseconds(duration));
+}
+
+// Storage
+// -------
+
+bool MemoryStorage::read(const char* name_space, const char* key, std::string* value)
+{
+    auto it = this->values.find(std::string(name_space) + "/" + key);
+    if(it == this->values.end()) return false;
+    *value = it->second;
+    return true;
+}
+
+void MemoryStorage::write(const char* name_space, const char* key, const void* value, size_t length)
+{
+    this->values[std::string(name_space) + "/" + key] = std::string((const char*)value, length);
+}
+
+void MemoryStorage::clear()
+{
+    this->values.clear();
+}
+
+// Injection
+// ---------
+
+void host_set_clock(Clock* clock)
+{
+    system_clock = (clock != NULL) ? clock : &host_system_clock;
+}
+
+Clock* host_get_clock()
+{
+    return system_clock;
+}
+
+void host_set_storage(HostStorage* storage)
+{
+    storage_in_use = (storage != NULL) ? storage : &memory_storage;
+}
+
+HostStorage* host_get_storage()
+{
+    return storage_in_use;
+}
+
+void host_set_publisher(HostPublisher* publisher)
+{
+    publisher_in_use = publisher;
+}
+
+HostPublisher* host_get_publisher()
+{
+    return publisher_in_use;
+}
+
+// esp_timer
+// ---------
+
+struct esp_timer{
+    esp_timer_create_args_t args;
+    int64_t period;     // 0 for a one shot timer
+    int64_t due;
+    bool active;
+};
+
+static std::vector<esp_timer*> timers;
+
+int64_t esp_timer_get_time(void)
+{
+    return system_clock->now();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle)
+{
+    if(create_args == NULL || create_args->callback == NULL || out_handle == NULL) return ESP_ERR_INVALID_ARG;
+    esp_timer* timer = new esp_timer();
+    timer->args = *create_args;
+    timer->period = 0;
+    timer->due = 0;
+    timer->active = false;
+    timers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout, uint64_t period)
+{
+    if(timer == NULL) return ESP_ERR_INVALID_ARG;
+    if(timer->active) return ESP_ERR_INVALID_STATE;
+    timer->period = (int64_t)period;
+    timer->due = system_clock->now() + (int64_t)timeout;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if(timer == NULL || !timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return timer_start(timer, timeout_us, (timer->period > 0) ? timeout_us : 0);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if(timer == NULL || !timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if(timer == NULL) return ESP_ERR_INVALID_ARG;
+    if(timer->active) return ESP_ERR_INVALID_STATE;
+    for(size_t i=0; i<timers.size(); i++)
+    {
+        if(timers[i] == timer)
+        {
+            timers.erase(timers.begin() + i);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+void host_advance(int64_t time)
+{
+    while(true)
+    {
+        esp_timer* next = NULL;
+        for(esp_timer* timer : timers)
+        {
+            if(timer->active && timer->due <= time && (next == NULL || timer->due < next->due)) next = timer;
+        }
+        if(next == NULL) break;
+
+        system_clock->sleep(next->due - system_clock->now());
+        if(next->period > 0)
+        {
+            next->due += next->period;
+            // Periods missed by a clock jump fire once, like skip_unhandled_events on the ESP32
+            if(next->args.skip_unhandled_events && next->due <= system_clock->now()) next->due = system_clock->now() + next->period;
+        }
+        else
+        {
+            next->active = false;
+        }
+        next->args.callback(next->args.arg);
+        host_run_tasks();
+    }
+    system_clock->sleep(time - system_clock->now());
+    host_run_tasks();
+}
+
+void host_reset_tasks();
+void host_reset_uarts();
+void host_reset_queues();
+
+void host_reset()
+{
+    for(esp_timer* timer : timers) delete timer;
+    timers.clear();
+    host_reset_tasks();
+    host_reset_uarts();
+    host_reset_queues();
+}
+
+// Logging
+// -------
+
+// Logs go to stderr, stdout is left to the output of the host programs
+static int stderr_vprintf(const char* format, va_list args)
+{
+    return vfprintf(stderr, format, args);
+}
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static vprintf_like_t log_vprintf = stderr_vprintf;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    if(strcmp(tag, "*") == 0) log_level = level;
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t previous = log_vprintf;
+    log_vprintf = func;
+    return previous;
+}
+
+static int log_write(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = log_vprintf(format, args);
+    va_end(args);
+    return length;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    if(level > log_level) return;
+
+    log_write("%c (%lld) %s: ", letters[level], (long long)(system_clock->now() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    log_vprintf(format, args);
+    va_end(args);
+    log_write("\n");
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch(code)
+    {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+// System
+// ------
+
+void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return calloc(n, size);
+}
+
+void heap_caps_free(void* ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 0; // No heap limit on the host
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 0;
+}
+
+void esp_restart(void)
+{
+    ESP_LOGE("HOST", "esp_restart() called, exiting");
+    exit(EXIT_FAILURE);
+}
+
+esp_err_t esp_task_wdt_add(TaskHandle_t task_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_delete(TaskHandle_t task_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reset(void)
+{
+    return ESP_OK;
+}
+
+// GPIO
+// ----
+
+static int gpio_levels[GPIO_NUM_MAX];
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    return (config != NULL) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if(gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    gpio_levels[gpio_num] = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if(gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return 0;
+    return gpio_levels[gpio_num];
+}
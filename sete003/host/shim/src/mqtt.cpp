@@ -0,0 +1,27 @@
+// MQTT on the host, messages go to the HostPublisher set with host_set_publisher()
+#include "mqtt.hpp"
+#include "host_platform.hpp"
+
+MQTT::MQTT(const char* uri)
+{
+    this->client = NULL;
+}
+
+esp_mqtt_client_handle_t MQTT::get_client()
+{
+    return this->client;
+}
+
+esp_err_t MQTT::publish(const char* topic, const char* payload, bool retain)
+{
+    HostPublisher* publisher = host_get_publisher();
+    if(publisher != NULL) publisher->publish(topic, payload, retain);
+    return ESP_OK;
+}
+
+esp_err_t MQTT::subscribe(const char* topic, int qos)
+{
+    return ESP_OK;
+}
+
+void MQTT::shutdown(){}
@@ -0,0 +1,137 @@
+// Sensor on the host, the time comes from the system_clock set with host_set_clock()
+#include "sensor.hpp"
+#include "storage.hpp"
+#include "host_platform.hpp"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+const char* SENSOR_TAG = "Sensor";
+
+extern Storage* storage;
+
+Sensor::Sensor()
+{
+    this->utc_offset = 0;
+    this->utc_offset_lock = portMUX_INITIALIZER_UNLOCKED;
+    this->temperature_sensor = NULL;
+    this->start_free_memory = 0;
+
+    this->name = "Sonare HOST";
+    this->designator = "HOST";
+    this->mqtt_root_topic = "SETE/sensors/host/sete003/" + this->designator;
+    this->mqtt_callback_topic = this->mqtt_root_topic + "/callback";
+
+    int64_t nvs_buffer_time = storage->get_int64(SENSOR_BASIC_DATA, "BUFFER_TIME");
+    if(nvs_buffer_time == 0)
+    {
+        this->payload_buffer_time = 10000000;
+        storage->store_data_int64(SENSOR_BASIC_DATA, "BUFFER_TIME", this->payload_buffer_time);
+    }
+    else
+    {
+        this->payload_buffer_time = nvs_buffer_time;
+    }
+}
+
+std::string Sensor::get_name(){return this->name;}
+std::string Sensor::get_designator(){return this->designator;}
+std::string Sensor::get_mqtt_root_topic(){return this->mqtt_root_topic;}
+std::string Sensor::get_mqtt_callback_topic(){return this->mqtt_callback_topic;}
+int64_t Sensor::get_payload_buffer_time(){return this->payload_buffer_time;}
+
+void Sensor::set_payload_buffer_time(int64_t buffer_time)
+{
+    this->payload_buffer_time = buffer_time;
+    storage->store_data_int64(SENSOR_BASIC_DATA, "BUFFER_TIME", this->payload_buffer_time);
+}
+
+void Sensor::transfer_log_to_mqtt(){}
+void Sensor::rollback_log_to_uart(){}
+
+float Sensor::get_internal_temperature()
+{
+    return 0;
+}
+
+void Sensor::dump_info()
+{
+    ESP_LOGI(SENSOR_TAG, "%s (host build)", this->name.c_str());
+}
+
+std::string Sensor::get_ota_update_uri(){return this->ota_update_uri;}
+void Sensor::set_ota_update_uri(std::string uri){this->ota_update_uri = uri;}
+
+int64_t Sensor::get_free_memory()
+{
+    return 0;
+}
+
+/**
+ * @brief Local time of an UTC time (us), as the firmware prints it
+ */
+static char* format_time(int64_t utc, const char* format, bool milliseconds)
+{
+    static char strftime_buf[64];
+    struct tm timeinfo;
+    time_t seconds = utc / 1000000;
+    localtime_r(&seconds, &timeinfo);
+    size_t length = strftime(strftime_buf, sizeof(strftime_buf), format, &timeinfo);
+    if(milliseconds) snprintf(strftime_buf + length, sizeof(strftime_buf) - length, ".%03ld", (long)((utc % 1000000) / 1000));
+    return strftime_buf;
+}
+
+char* Sensor::time_now()
+{
+    return format_time(host_get_clock()->utc(), "%c", false);
+}
+
+char* Sensor::time_at(int64_t esp_time)
+{
+    Clock* clock = host_get_clock();
+    int64_t at = clock->utc();
+    if(esp_time > 0) at -= clock->now() - esp_time;
+    return format_time(at, "%Y-%m-%d %H:%M:%S", true);
+}
+
+void Sensor::update_utc_offset()
+{
+    Clock* clock = host_get_clock();
+    int64_t utc = clock->utc();
+    if(utc < 1600000000LL * 1000000) return; // Not set (before 2020)
+    taskENTER_CRITICAL(&this->utc_offset_lock);
+    this->utc_offset = utc - clock->now();
+    taskEXIT_CRITICAL(&this->utc_offset_lock);
+}
+
+int64_t Sensor::utc_time_at(int64_t esp_time)
+{
+    taskENTER_CRITICAL(&this->utc_offset_lock);
+    int64_t offset = this->utc_offset;
+    taskEXIT_CRITICAL(&this->utc_offset_lock);
+    if(offset == 0) return 0;
+    return esp_time + offset;
+}
+
+void Sensor::change_time_zone(const char* time_zone)
+{
+    setenv("TZ", time_zone, 1);
+    tzset();
+}
+
+std::string Sensor::get_current_timestamp()
+{
+    int64_t utc = host_get_clock()->utc();
+    struct tm timeinfo;
+    time_t seconds = utc / 1000000;
+    gmtime_r(&seconds, &timeinfo);
+    char buffer[48];
+    size_t length = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    snprintf(buffer + length, sizeof(buffer) - length, ".%06ld+00", (long)(utc % 1000000));
+    return buffer;
+}
+
+void Sensor::shutdown(){}
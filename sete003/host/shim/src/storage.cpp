@@ -0,0 +1,66 @@
+// Storage on the host, the values are kept by the HostStorage set with host_set_storage()
+#include "storage.hpp"
+#include "host_platform.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+static const char* storage_type_name[] = {
+    "SENSORS",
+    "WIFI"
+};
+
+Storage::Storage(){}
+
+static void store(storage_type_t type, const char* key, const void* value, size_t length)
+{
+    host_get_storage()->write(storage_type_name[type], key, value, length);
+}
+
+/**
+ * @brief Read a value of a fixed size, 0 (like the NVS getters) if it is missing or of another size
+ */
+template<typename T> static T get(storage_type_t type, const char* key)
+{
+    std::string value;
+    T result = 0;
+    if(host_get_storage()->read(storage_type_name[type], key, &value) && value.size() == sizeof(T))
+    {
+        memcpy(&result, value.data(), sizeof(T));
+    }
+    return result;
+}
+
+void Storage::store_data_str(storage_type_t type, const char* key, const char* value){store(type, key, value, strlen(value) + 1);}
+void Storage::store_data_int32(storage_type_t type, const char* key, int32_t value){store(type, key, &value, sizeof(value));}
+void Storage::store_data_int64(storage_type_t type, const char* key, int64_t value){store(type, key, &value, sizeof(value));}
+void Storage::store_data_uint8(storage_type_t type, const char* key, uint8_t value){store(type, key, &value, sizeof(value));}
+void Storage::store_data_uint16(storage_type_t type, const char* key, uint16_t value){store(type, key, &value, sizeof(value));}
+void Storage::store_data_uint32(storage_type_t type, const char* key, uint32_t value){store(type, key, &value, sizeof(value));}
+void Storage::store_data_blob(storage_type_t type, const char* key, const void* value, size_t length){store(type, key, value, length);}
+
+char* Storage::get_str(storage_type_t type, const char* key)
+{
+    std::string value;
+    if(!host_get_storage()->read(storage_type_name[type], key, &value)) return NULL;
+    char* result = (char*)malloc(value.size() + 1); // Freed by the caller, like on the ESP32
+    memcpy(result, value.data(), value.size());
+    result[value.size()] = '\0';
+    return result;
+}
+
+int Storage::get_int32(storage_type_t type, const char* key){return get<int32_t>(type, key);}
+int64_t Storage::get_int64(storage_type_t type, const char* key){return get<int64_t>(type, key);}
+uint8_t Storage::get_uint8(storage_type_t type, const char* key){return get<uint8_t>(type, key);}
+uint16_t Storage::get_uint16(storage_type_t type, const char* key){return get<uint16_t>(type, key);}
+uint32_t Storage::get_uint32(storage_type_t type, const char* key){return get<uint32_t>(type, key);}
+
+bool Storage::get_blob(storage_type_t type, const char* key, void* value, size_t length)
+{
+    std::string stored;
+    if(!host_get_storage()->read(storage_type_name[type], key, &stored) || stored.size() != length) return false;
+    memcpy(value, stored.data(), length);
+    return true;
+}
@@ -0,0 +1,12 @@
+// Parts of the device the host does not have
+#include "ota_update.hpp"
+#include "wifi.hpp"
+
+#include "esp_log.h"
+
+void WiFi_STA::shutdown(){}
+
+void ota_update(std::string uri)
+{
+    ESP_LOGW("HOST", "OTA update to %s ignored on the host", uri.c_str());
+}
@@ -0,0 +1,148 @@
+#include "host_platform.hpp"
+
+#include <string.h>
+
+#include <string>
+
+#include "driver/uart.h"
+
+typedef struct host_uart{
+    bool installed;
+    uint32_t baudrate;
+    std::string received;       // Waiting to be read by the firmware
+    std::string sent;           // Written by the firmware, taken by the host
+    QueueHandle_t events;
+}host_uart_t;
+
+static host_uart_t uarts[UART_NUM_MAX];
+
+static host_uart_t* get_uart(uart_port_t uart_num)
+{
+    if(uart_num < 0 || uart_num >= UART_NUM_MAX) return NULL;
+    return &uarts[uart_num];
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t* uart_config)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL || uart_config == NULL) return ESP_ERR_INVALID_ARG;
+    uart->baudrate = uart_config->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    return (get_uart(uart_num) != NULL) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_driver_install(
+    uart_port_t uart_num,
+    int rx_buffer_size,
+    int tx_buffer_size,
+    int queue_size,
+    QueueHandle_t* uart_queue,
+    int intr_alloc_flags
+)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL) return ESP_ERR_INVALID_ARG;
+    // The LD2461 never removes its driver, a new one on the same port replaces it
+    if(uart->installed && uart->events != NULL) vQueueDelete(uart->events);
+    uart->installed = true;
+    uart->received.clear();
+    uart->sent.clear();
+    uart->events = NULL;
+    if(uart_queue != NULL && queue_size > 0)
+    {
+        uart->events = xQueueCreate(queue_size, sizeof(uart_event_t));
+        *uart_queue = uart->events;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, const uint8_t tout_thresh)
+{
+    return (get_uart(uart_num) != NULL) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL) return ESP_ERR_INVALID_ARG;
+    uart->baudrate = baudrate;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t* size)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL || size == NULL) return ESP_ERR_INVALID_ARG;
+    *size = uart->received.size();
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void* buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL || buf == NULL) return -1;
+    if(uart->received.size() < length && ticks_to_wait > 0)
+    {
+        // Nothing else runs on the host to send the rest, the whole timeout passes
+        if(ticks_to_wait != portMAX_DELAY) host_get_clock()->sleep((int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000);
+    }
+    size_t count = (uart->received.size() < length) ? uart->received.size() : length;
+    memcpy(buf, uart->received.data(), count);
+    uart->received.erase(0, count);
+    return (int)count;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void* src, size_t size)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL || src == NULL) return -1;
+    uart->sent.append((const char*)src, size);
+    return (int)size;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    return (get_uart(uart_num) != NULL) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL) return ESP_ERR_INVALID_ARG;
+    uart->received.clear();
+    return ESP_OK;
+}
+
+void host_uart_receive(uart_port_t uart_num, const uint8_t* data, size_t length)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL || length == 0) return;
+    uart->received.append((const char*)data, length);
+    if(uart->events != NULL)
+    {
+        uart_event_t event = {UART_DATA, length, true};
+        xQueueSend(uart->events, &event, 0);
+    }
+}
+
+std::string host_uart_take_sent(uart_port_t uart_num)
+{
+    host_uart_t* uart = get_uart(uart_num);
+    if(uart == NULL) return "";
+    std::string sent;
+    sent.swap(uart->sent);
+    return sent;
+}
+
+void host_reset_uarts()
+{
+    for(int i=0; i<UART_NUM_MAX; i++)
+    {
+        if(uarts[i].events != NULL) vQueueDelete(uarts[i].events);
+        uarts[i] = {};
+    }
+}
@@ -0,0 +1,198 @@
+#include "accuracy.hpp"
+#include "replay.hpp"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+/**
+ * @brief Split a CSV line, quotes are removed (the exports never quote a comma)
+ */
+static void split_csv(const char* line, std::vector<std::string>* fields)
+{
+    fields->clear();
+    std::string field;
+    for(const char* cursor = line; ; cursor++)
+    {
+        if(*cursor == ',' || *cursor == '\0' || *cursor == '\n' || *cursor == '\r')
+        {
+            fields->push_back(field);
+            field.clear();
+            if(*cursor != ',') break;
+        }
+        else if(*cursor != '"')
+        {
+            field += *cursor;
+        }
+    }
+}
+
+bool counts_csv_read(FILE* file, const char* const* columns, int columns_count, std::vector<int64_t>* times)
+{
+    char* line = NULL;
+    size_t capacity = 0;
+    std::vector<std::string> fields;
+    if(getline(&line, &capacity, file) <= 0)
+    {
+        free(line);
+        return false;
+    }
+
+    // Column indexes from the header
+    split_csv(line, &fields);
+    int timestamp_index = -1;
+    std::vector<int> indexes(columns_count, -1);
+    for(size_t i=0; i<fields.size(); i++)
+    {
+        if(fields[i] == "timestamp") timestamp_index = i;
+        for(int c=0; c<columns_count; c++)
+        {
+            if(fields[i] == columns[c]) indexes[c] = i;
+        }
+    }
+    if(timestamp_index < 0 || std::count(indexes.begin(), indexes.end(), -1) > 0)
+    {
+        free(line);
+        return false;
+    }
+
+    while(getline(&line, &capacity, file) > 0)
+    {
+        split_csv(line, &fields);
+        int64_t time;
+        if((int)fields.size() <= timestamp_index || !record_time_parse(fields[timestamp_index].c_str(), &time)) continue;
+        long crossings = 0;
+        for(int index : indexes)
+        {
+            if(index < (int)fields.size()) crossings += strtol(fields[index].c_str(), NULL, 10);
+        }
+        for(long i=0; i<crossings; i++) times->push_back(time);
+    }
+    free(line);
+    std::sort(times->begin(), times->end());
+    return true;
+}
+
+void accuracy_match(const std::vector<int64_t>& detected, const std::vector<int64_t>& reference,
+    int64_t window, accuracy_t* result)
+{
+    *result = {};
+    result->detected = detected.size();
+    result->reference = reference.size();
+
+    // Both sorted, matching each crossing with the earliest one in its window matches the most
+    size_t d = 0, r = 0;
+    while(d < detected.size() && r < reference.size())
+    {
+        if(reference[r] < detected[d] - window) r++;
+        else if(detected[d] < reference[r] - window) d++;
+        else
+        {
+            result->matched++;
+            d++;
+            r++;
+        }
+    }
+
+    accuracy_ratios(result);
+}
+
+void accuracy_ratios(accuracy_t* result)
+{
+    result->precision = (result->detected > 0) ? (double)result->matched / result->detected : 1;
+    result->recall = (result->reference > 0) ? (double)result->matched / result->reference : 1;
+    int64_t difference = (int64_t)result->detected - (int64_t)result->reference;
+    if(result->reference > 0) result->net_error = (double)llabs(difference) / result->reference;
+    else result->net_error = (result->detected > 0) ? 1 : 0;
+}
+
+void accuracy_add(accuracy_t* total, const accuracy_t* accuracy)
+{
+    total->detected += accuracy->detected;
+    total->reference += accuracy->reference;
+    total->matched += accuracy->matched;
+    accuracy_ratios(total);
+}
+
+std::vector<int64_t> accuracy_span(const std::vector<int64_t>& times, int64_t first, int64_t last, int64_t window)
+{
+    std::vector<int64_t> covered;
+    std::copy_if(times.begin(), times.end(), std::back_inserter(covered),
+        [&](int64_t time){return time >= first - window && time <= last + window;});
+    return covered;
+}
+
+/**
+ * @brief First file of a directory whose name starts with prefix and ends with suffix
+ */
+static bool find_file(const std::string& directory, const char* prefix, const char* suffix, std::string* path)
+{
+    DIR* dir = opendir(directory.c_str());
+    if(dir == NULL) return false;
+    bool found = false;
+    struct dirent* entry;
+    while(!found && (entry = readdir(dir)) != NULL)
+    {
+        size_t length = strlen(entry->d_name), suffix_length = strlen(suffix);
+        if(strncmp(entry->d_name, prefix, strlen(prefix)) != 0 || length < suffix_length) continue;
+        if(strcmp(entry->d_name + length - suffix_length, suffix) != 0) continue;
+        *path = directory + "/" + entry->d_name;
+        found = true;
+    }
+    closedir(dir);
+    return found;
+}
+
+static bool read_counts(const std::string& path, const char* const* columns, int columns_count, std::vector<int64_t>* times)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if(file == NULL) return false;
+    bool read = counts_csv_read(file, columns, columns_count, times);
+    fclose(file);
+    return read;
+}
+
+bool accuracy_days_read(const char* logs_dir, const char* raw_dir, const char* sensor_id, std::vector<accuracy_day_t>* days)
+{
+    // Days in order, the directories are DD-MM-YY
+    std::vector<std::string> names;
+    DIR* dir = opendir(logs_dir);
+    if(dir == NULL) return false;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        int day, month, year;
+        if(sscanf(entry->d_name, "%2d-%2d-%2d", &day, &month, &year) == 3) names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b){
+        return a.substr(6, 2) + a.substr(3, 2) + a.substr(0, 2) < b.substr(6, 2) + b.substr(3, 2) + b.substr(0, 2);
+    });
+
+    static const char* const reference_columns[] = {"traversed"};
+    static const char* const entered_columns[] = {"entered"};
+    static const char* const exited_columns[] = {"exited"};
+    for(const std::string& name : names)
+    {
+        std::string day_dir = std::string(logs_dir) + "/" + name;
+        accuracy_day_t day = {};
+        if(!find_file(day_dir, "data_by_two_", ".csv", &day.reference_path)) continue;
+        day.name = name;
+        day.has_reference = read_counts(day.reference_path, reference_columns, 1, &day.reference);
+
+        std::string path;
+        day.has_firmware = find_file(day_dir, "sensor_data_", ".csv", &path) &&
+            read_counts(path, entered_columns, 1, &day.entered) &&
+            read_counts(path, exited_columns, 1, &day.exited);
+        std::merge(day.entered.begin(), day.entered.end(), day.exited.begin(), day.exited.end(), std::back_inserter(day.firmware));
+
+        day.raw_path = std::string(raw_dir) + "/" + sensor_id + "/20" +
+            name.substr(6, 2) + "-" + name.substr(3, 2) + "-" + name.substr(0, 2) + "-ld2461.jsonl";
+        days->push_back(day);
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#include "host_firmware.hpp"
+
+#include "comms.hpp"
+#include "mqtt.hpp"
+#include "pir.hpp"
+#include "sensor.hpp"
+#include "storage.hpp"
+#include "wifi.hpp"
+
+#include "esp_log.h"
+#include "ld2461_codec.hpp"
+
+// Global Variables, as in sete003.cpp
+Storage* storage;
+MQTT* mqtt;
+Sensor* sensor;
+LD2461* radars[MAX_RADARS];
+uint8_t radars_count = 0;
+PIR* pir;
+WiFi_STA* wifi;
+Detection* detection;
+
+static const uart_port_t radar_uart[MAX_RADARS] = {UART_NUM_2, UART_NUM_1};
+static const gpio_num_t radar_tx_pin[MAX_RADARS] = {GPIO_NUM_36, GPIO_NUM_17};
+static const gpio_num_t radar_rx_pin[MAX_RADARS] = {GPIO_NUM_35, GPIO_NUM_18};
+
+HostFirmware::HostFirmware(uint8_t radar_count, int64_t epoch) : clock(epoch)
+{
+    host_set_clock(&this->clock);
+
+    storage = new Storage();
+    wifi = new WiFi_STA();
+    sensor = new Sensor();
+    sensor->update_utc_offset();
+    radars_count = 0;
+    for(int i=0; i<radar_count && i<MAX_RADARS; i++)
+    {
+        radars[i] = new LD2461(radar_uart[i], radar_tx_pin[i], radar_rx_pin[i], 9600, i);
+        radars[i]->load_mount();
+        radars_count++;
+    }
+    pir = new PIR(GPIO_NUM_48);
+    mqtt = new MQTT("");
+
+    // The zones saved in the storage replace this area, like on the ESP32
+    detection = new Detection(
+        {-2, 3},    // D0
+        {-2, 1.8},  // D1
+        {2, 1.8},   // D2
+        {2, 3},     // D3
+        {-2, 1.8},  // S0
+        {2, 1.8}    // S1
+    );
+    // start_detection() waits for the first report of every radar
+    for(int i=0; i<radars_count; i++)
+    {
+        host_uart_receive(radar_uart[i], LD2461_FRAME_EMPTY_REPORT.bytes, LD2461_FRAME_EMPTY_REPORT.size);
+    }
+    detection->start_detection();
+    detection->start_task(sensor->get_payload_buffer_time());
+    for(int i=0; i<radars_count; i++)
+    {
+        radars[i]->set_report_listener(detection->get_task(), DETECTION_EVENT_REPORT);
+    }
+}
+
+HostFirmware::~HostFirmware()
+{
+    delete detection;
+    for(int i=0; i<radars_count; i++)
+    {
+        delete radars[i];
+        radars[i] = NULL;
+    }
+    radars_count = 0;
+    delete mqtt;
+    delete pir;
+    delete sensor;
+    delete wifi;
+    delete storage;
+    detection = NULL; mqtt = NULL; pir = NULL; sensor = NULL; wifi = NULL; storage = NULL;
+
+    host_reset();
+    host_set_clock(NULL);
+}
+
+SimulatedClock* HostFirmware::get_clock()
+{
+    return &this->clock;
+}
+
+void HostFirmware::advance(int64_t time)
+{
+    host_advance(time);
+}
+
+void HostFirmware::receive_frame(uint8_t radar, ld2461_frame_t* frame, int64_t arrival_time)
+{
+    if(radar >= radars_count) return;
+    host_advance(arrival_time);
+    radars[radar]->dispatch_frame(frame, arrival_time);
+    host_run_tasks();
+}
+
+void HostFirmware::receive_report(uint8_t radar, ld2461_detection_t* report)
+{
+    if(radar >= radars_count) return;
+    host_advance(report->timestamp);
+    detection->process_detection(report, radar);
+    detection->log_events();
+}
+
+void HostFirmware::receive_bytes(uint8_t radar, const uint8_t* data, size_t length, int64_t rx_time)
+{
+    if(radar >= radars_count) return;
+    LD2461Parser* parser = &this->parsers[radar];
+    ld2461_frame_t frame;
+    while(length > 0)
+    {
+        size_t accepted = parser->push(data, length);
+        data += accepted;
+        length -= accepted;
+        while(parser->next_frame(&frame)) this->receive_frame(radar, &frame, rx_time);
+        if(accepted == 0) break; // Full of bytes that are not a frame yet, nothing more fits
+    }
+}
+
+#ifdef SETE003_HOST_COMMS
+void HostFirmware::command(const std::string& topic, const std::string& data)
+{
+    process_server_message(topic, data);
+    host_run_tasks();
+}
+#endif
@@ -0,0 +1,313 @@
+#include "replay.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ld2461_codec.hpp"
+#include "sensor.hpp"
+
+extern Sensor* sensor;
+
+/**
+ * @brief Find a key in [begin, end) and read the number after it
+ */
+static bool json_number(const char* begin, const char* end, const char* key, double* value)
+{
+    char quoted[32];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    const char* found = strstr(begin, quoted);
+    if(found == NULL || found >= end) return false;
+    const char* cursor = found + strlen(quoted);
+    while(cursor < end && (*cursor == ' ' || *cursor == ':')) cursor++;
+    char* parsed;
+    *value = strtod(cursor, &parsed);
+    return parsed != cursor && parsed <= end;
+}
+
+bool record_time_parse(const char* text, int64_t* time)
+{
+    struct tm timeinfo = {};
+    int consumed = 0;
+    if(sscanf(text, "%d-%d-%d %d:%d:%d%n", &timeinfo.tm_year, &timeinfo.tm_mon, &timeinfo.tm_mday,
+        &timeinfo.tm_hour, &timeinfo.tm_min, &timeinfo.tm_sec, &consumed) != 6) return false;
+    timeinfo.tm_year -= 1900;
+    timeinfo.tm_mon -= 1;
+    int64_t micros = 0;
+    const char* fraction = text + consumed;
+    if(*fraction == '.')
+    {
+        int64_t scale = 100000;
+        for(fraction++; *fraction >= '0' && *fraction <= '9'; fraction++)
+        {
+            micros += (*fraction - '0') * scale;
+            scale /= 10;
+        }
+    }
+    *time = (int64_t)timegm(&timeinfo) * 1000000 + micros;
+    return true;
+}
+
+static int8_t meters_to_report(double meters)
+{
+    long decimeters = lround(meters * 10);
+    if(decimeters > INT8_MAX) return INT8_MAX;
+    if(decimeters < INT8_MIN) return INT8_MIN;
+    return (int8_t)decimeters;
+}
+
+bool raw_record_parse(const char* line, raw_record_t* record)
+{
+    const char* json = strchr(line, '{');
+    if(json == NULL) return false;
+    const char* end = json + strlen(json);
+
+    *record = {};
+    ld2461_setup_detection(&record->report);
+    double value;
+    record->timed = record_time_parse(line, &record->time);
+    if(!record->timed && json_number(json, end, "ts", &value))
+    {
+        record->time = (int64_t)value;
+        record->timed = true;
+    }
+    if(json_number(json, end, "radar", &value)) record->radar = (uint8_t)value;
+
+    bool has_target = false;
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        char key[8];
+        snprintf(key, sizeof(key), "\"t_%d\"", i);
+        const char* target = strstr(json, key);
+        if(target == NULL) continue;
+        has_target = true;
+        const char* target_end = strchr(target, '}');
+        if(target_end == NULL) target_end = end;
+
+        double x = 0, y = 0;
+        json_number(target, target_end, "x", &x);
+        json_number(target, target_end, "y", &y);
+        record->report.target[i] = {meters_to_report(x), meters_to_report(y)};
+        if(json_number(target, target_end, "id", &value)) record->report.track_id[i] = (uint16_t)value;
+        if(record->report.target[i].x != 0 || record->report.target[i].y != 0)
+        {
+            record->report.is_target_available[i] = LD2461_TARGET_AVAILABLE;
+            record->report.detected_targets++;
+        }
+    }
+    return has_target;
+}
+
+replay_options_t replay_default_options()
+{
+    replay_options_t options = {};
+    options.radars = 1;
+    options.radar_pipeline = false;
+    options.counting_mode = COUNTING_AREA;
+    options.area_set = false;
+    options.publish_period = 0;
+    options.ghost_timer = -1;
+    options.threshold_distance = -1;
+    options.enter_exit_inverted = false;
+    return options;
+}
+
+/**
+ * @brief Keeps what the firmware publishes during a replay
+ */
+class ReplayPublisher : public HostPublisher{
+private:
+    replay_result_t* result;
+
+    static bool ends_with(const char* topic, const char* suffix)
+    {
+        size_t length = strlen(topic), suffix_length = strlen(suffix);
+        return length >= suffix_length && strcmp(topic + length - suffix_length, suffix) == 0;
+    }
+
+    void add_events(const char* payload)
+    {
+        const char* end = payload + strlen(payload);
+        double value;
+        if(json_number(payload, end, "dropped", &value)) this->result->dropped_events += (uint32_t)value;
+
+        const char* cursor = strchr(payload, '[');
+        while(cursor != NULL && (cursor = strchr(cursor, '{')) != NULL)
+        {
+            const char* object_end = strchr(cursor, '}');
+            if(object_end == NULL) break;
+            replay_event_t event = {};
+            event.json.assign(cursor, object_end + 1);
+            if(json_number(cursor, object_end, "ts", &value)) event.timestamp = (int64_t)value;
+            if(json_number(cursor, object_end, "zone", &value)) event.zone = (uint8_t)value;
+            if(json_number(cursor, object_end, "track", &value)) event.track_id = (uint16_t)value;
+            const char* type = strstr(cursor, "\"type\": \"");
+            if(type != NULL && type < object_end)
+            {
+                type += strlen("\"type\": \"");
+                const char* type_end = strchr(type, '"');
+                std::string name(type, type_end);
+                int index = crossing_index_of(name.c_str(), crossing_event_str, CROSSING_EVENT_TYPES);
+                event.type = (index < 0) ? CROSSING_NONE : index;
+            }
+            this->result->events.push_back(event);
+            cursor = object_end + 1;
+        }
+    }
+
+public:
+    ReplayPublisher(replay_result_t* result)
+    {
+        this->result = result;
+    }
+
+    void publish(const char* topic, const char* payload, bool retain) override
+    {
+        const char* end = payload + strlen(payload);
+        double value;
+        if(ends_with(topic, "/events"))
+        {
+            this->add_events(payload);
+        }
+        else if(ends_with(topic, "/data"))
+        {
+            // The totals come before the counters of each zone
+            if(json_number(payload, end, "entered", &value)) this->result->counts[CROSSING_ENTERED] += (uint32_t)value;
+            if(json_number(payload, end, "exited", &value)) this->result->counts[CROSSING_EXITED] += (uint32_t)value;
+            if(json_number(payload, end, "gave_up", &value)) this->result->counts[CROSSING_GAVE_UP] += (uint32_t)value;
+        }
+        else if(ends_with(topic, "/occupancy"))
+        {
+            if(json_number(payload, end, "occupancy", &value)) this->result->occupancy = (int32_t)value;
+        }
+    }
+};
+
+Replay::Replay(const replay_options_t* options, int64_t epoch, replay_result_t* result)
+{
+    *result = {};
+    this->options = *options;
+    this->result = result;
+    this->epoch = epoch;
+    this->time_now = REPLAY_BOOT_TIME;
+
+    this->publisher = new ReplayPublisher(result);
+    this->previous_publisher = host_get_publisher();
+    host_set_publisher(this->publisher);
+    this->firmware = new HostFirmware(options->radars, epoch);
+    if(options->area_set)
+    {
+        const point_t* area = options->area;
+        detection->set_detection_area(area[0], area[1], area[2], area[3], area[4], area[5]);
+    }
+    detection->set_counting_mode(options->counting_mode);
+    if(options->enter_exit_inverted) detection->set_enter_exit_inverted(true);
+    for(int i=0; i<radars_count; i++)
+    {
+        if(options->ghost_timer >= 0) radars[i]->set_ghost_timer_timeout(options->ghost_timer);
+        if(options->threshold_distance >= 0) radars[i]->set_max_threshold_distance(options->threshold_distance);
+    }
+    if(options->publish_period > 0)
+    {
+        sensor->set_payload_buffer_time(options->publish_period);
+        detection->set_publish_period(options->publish_period);
+    }
+}
+
+Replay::~Replay()
+{
+    delete this->firmware;
+    host_set_publisher(this->previous_publisher);
+    delete this->publisher;
+}
+
+void Replay::add(uint8_t radar, ld2461_detection_t* report, int64_t time)
+{
+    if(radar >= radars_count) return;
+    if(time > this->time_now) this->time_now = time;
+    if(this->result->reports == 0) this->result->first_time = this->epoch + this->time_now;
+    this->result->last_time = this->epoch + this->time_now;
+    this->result->reports++;
+    report->timestamp = this->time_now;
+
+    if(this->options.radar_pipeline)
+    {
+        // The radar only sends up to the last valid target
+        size_t count = 0;
+        for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+        {
+            if(report->is_target_available[i] == LD2461_TARGET_AVAILABLE) count = i + 1;
+        }
+        uint8_t frame[LD2461_MAX_FRAME_SIZE];
+        size_t size = ld2461_encode_report(frame, sizeof(frame), report->target, count);
+        this->firmware->receive_bytes(radar, frame, size, this->time_now);
+    }
+    else
+    {
+        this->firmware->receive_report(radar, report);
+    }
+}
+
+int64_t Replay::get_time()
+{
+    return this->time_now;
+}
+
+void Replay::finish()
+{
+    this->firmware->advance(this->time_now + sensor->get_payload_buffer_time());
+    detection->get_latency(&this->result->latency);
+}
+
+void replay_recording_read(FILE* file, replay_recording_t* recording)
+{
+    *recording = {};
+    char* line = NULL;
+    size_t capacity = 0;
+    raw_record_t record;
+    while(getline(&line, &capacity, file) > 0)
+    {
+        if(raw_record_parse(line, &record)) recording->records.push_back(record);
+        else recording->skipped_lines++;
+    }
+    free(line);
+}
+
+void replay_recording(const replay_recording_t* recording, const replay_options_t* options, replay_result_t* result)
+{
+    *result = {};
+    if(recording->records.empty()) return;
+
+    // The clock starts at the first report, the whole recording is relative to it
+    // A recording without times never had its clock set
+    const raw_record_t* first = &recording->records.front();
+    int64_t epoch = first->timed ? first->time - REPLAY_BOOT_TIME : 0;
+
+    uint32_t skipped_lines = recording->skipped_lines;
+    {
+        Replay replay(options, epoch, result);
+        for(const raw_record_t& record : recording->records)
+        {
+            if(record.radar >= options->radars)
+            {
+                skipped_lines++;
+                continue;
+            }
+            // The recording is in the order the server received it, the clock never goes back
+            int64_t time = record.timed ? record.time - epoch : replay.get_time() + REPLAY_REPORT_PERIOD;
+            if(result->reports == 0) time = REPLAY_BOOT_TIME;
+            ld2461_detection_t report = record.report;
+            replay.add(record.radar, &report, time);
+        }
+        replay.finish();
+    }
+    result->skipped_lines = skipped_lines;
+}
+
+void replay_file(FILE* file, const replay_options_t* options, replay_result_t* result)
+{
+    replay_recording_t recording;
+    replay_recording_read(file, &recording);
+    replay_recording(&recording, options, result);
+}
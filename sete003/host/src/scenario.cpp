@@ -0,0 +1,422 @@
+#include "scenario.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#define SCENARIO_MAX_TOKENS 64
+#define SCENARIO_MAX_LINE 512
+
+static bool parse_float(const char* text, float* value)
+{
+    char* end;
+    *value = strtof(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool parse_point(const char* text, scenario_point_t* point)
+{
+    char* end;
+    point->x = strtof(text, &end);
+    if(end == text || *end != ',') return false;
+    const char* y = end + 1;
+    point->y = strtof(y, &end);
+    return end != y && *end == '\0';
+}
+
+static bool parse_expect(const char* text, uint8_t* expect)
+{
+    if(strcmp(text, "entered") == 0) *expect = SCENARIO_EXPECT_ENTERED;
+    else if(strcmp(text, "exited") == 0) *expect = SCENARIO_EXPECT_EXITED;
+    else if(strcmp(text, "none") == 0) *expect = SCENARIO_EXPECT_NONE;
+    else return false;
+    return true;
+}
+
+/**
+ * @brief Seconds from the start of a walk to its end
+ */
+static float walk_time(const scenario_actor_t* actor)
+{
+    float time = 0;
+    for(size_t i=0; i<actor->path.size(); i++)
+    {
+        time += actor->path[i].wait;
+        if(i + 1 == actor->path.size()) break;
+        float dx = actor->path[i+1].point.x - actor->path[i].point.x;
+        float dy = actor->path[i+1].point.y - actor->path[i].point.y;
+        time += sqrtf(dx*dx + dy*dy) / actor->speed;
+    }
+    return time;
+}
+
+static int8_t meters_to_report(float meters)
+{
+    long decimeters = lroundf(meters * 10);
+    if(decimeters > INT8_MAX) return INT8_MAX;
+    if(decimeters < INT8_MIN) return INT8_MIN;
+    return (int8_t)decimeters;
+}
+
+Scenario::Scenario()
+{
+    this->rate = SCENARIO_DEFAULT_RATE;
+    this->duration = 0;
+    this->noise = 0;
+    this->seed = 1;
+    this->reset();
+}
+
+bool Scenario::parse(FILE* file, std::string* error)
+{
+    char line[SCENARIO_MAX_LINE];
+    int number = 0;
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+        std::string reason;
+        if(!this->parse_line(line, &reason))
+        {
+            *error = "line " + std::to_string(number) + ": " + reason;
+            return false;
+        }
+    }
+    this->reset();
+    return true;
+}
+
+bool Scenario::parse_walk(char** tokens, int count, scenario_actor_t* actor, std::string* error)
+{
+    for(int i=0; i<count; i++)
+    {
+        scenario_waypoint_t waypoint = {};
+        if(strcmp(tokens[i], "wait") == 0 && i+1 < count)
+        {
+            if(actor->path.empty() || !parse_float(tokens[++i], &actor->path.back().wait) || actor->path.back().wait < 0)
+            {
+                *error = "wait needs a point before it and a time";
+                return false;
+            }
+        }
+        else if(strcmp(tokens[i], "expect") == 0 && i+1 < count)
+        {
+            if(!parse_expect(tokens[++i], &actor->expect))
+            {
+                *error = "expect is entered, exited or none";
+                return false;
+            }
+        }
+        else if(parse_point(tokens[i], &waypoint.point))
+        {
+            actor->path.push_back(waypoint);
+        }
+        else
+        {
+            *error = std::string("not a point: ") + tokens[i];
+            return false;
+        }
+    }
+    if(actor->path.size() < 2)
+    {
+        *error = "a walk needs two points";
+        return false;
+    }
+    actor->end = actor->start + walk_time(actor);
+    return true;
+}
+
+bool Scenario::parse_line(const char* line, std::string* error)
+{
+    char buffer[SCENARIO_MAX_LINE];
+    snprintf(buffer, sizeof(buffer), "%s", line);
+    char* comment = strchr(buffer, '#');
+    if(comment != NULL) *comment = '\0';
+
+    char* tokens[SCENARIO_MAX_TOKENS];
+    int count = 0;
+    char* save = NULL;
+    for(char* token = strtok_r(buffer, " \t\r\n", &save); token != NULL && count < SCENARIO_MAX_TOKENS;
+        token = strtok_r(NULL, " \t\r\n", &save))
+    {
+        tokens[count++] = token;
+    }
+    if(count == 0) return true;
+
+    const char* command = tokens[0];
+    float value;
+    if(strcmp(command, "rate") == 0 || strcmp(command, "duration") == 0 ||
+       strcmp(command, "noise") == 0 || strcmp(command, "seed") == 0)
+    {
+        if(count != 2 || !parse_float(tokens[1], &value) || value < 0)
+        {
+            *error = std::string(command) + " needs a positive value";
+            return false;
+        }
+        if(command[0] == 'r') this->rate = (value > 0) ? value : SCENARIO_DEFAULT_RATE;
+        else if(command[0] == 'd') this->duration = value;
+        else if(command[0] == 'n') this->noise = value;
+        else this->seed = (uint32_t)value;
+        return true;
+    }
+    if(strcmp(command, "walk") == 0)
+    {
+        scenario_actor_t actor = {};
+        actor.slot = -1;
+        if(count < 5 || !parse_float(tokens[1], &actor.start) || !parse_float(tokens[2], &actor.speed) || actor.speed <= 0)
+        {
+            *error = "walk START SPEED P0 P1 [wait S] [P2...] [expect entered|exited]";
+            return false;
+        }
+        if(!this->parse_walk(tokens + 3, count - 3, &actor, error)) return false;
+        this->actors.push_back(actor);
+        return true;
+    }
+    if(strcmp(command, "crowd") == 0)
+    {
+        float start, people, interval, speed, spread = 0;
+        scenario_point_t from, to;
+        uint8_t expect = SCENARIO_EXPECT_NONE;
+        bool valid = count >= 7 && parse_float(tokens[1], &start) && parse_float(tokens[2], &people) &&
+            parse_float(tokens[3], &interval) && parse_float(tokens[4], &speed) && speed > 0 &&
+            parse_point(tokens[5], &from) && parse_point(tokens[6], &to);
+        for(int i=7; valid && i<count; i+=2)
+        {
+            if(i+1 >= count) valid = false;
+            else if(strcmp(tokens[i], "spread") == 0) valid = parse_float(tokens[i+1], &spread);
+            else if(strcmp(tokens[i], "expect") == 0) valid = parse_expect(tokens[i+1], &expect);
+            else valid = false;
+        }
+        if(!valid)
+        {
+            *error = "crowd START COUNT INTERVAL SPEED FROM TO [spread M] [expect entered|exited]";
+            return false;
+        }
+
+        // Sideways offsets spread evenly (golden ratio sequence), the same for any seed
+        float dx = to.x - from.x, dy = to.y - from.y;
+        float length = sqrtf(dx*dx + dy*dy);
+        scenario_point_t side = (length > 0) ? scenario_point_t{-dy / length, dx / length} : scenario_point_t{0, 0};
+        for(int i=0; i<(int)people; i++)
+        {
+            float fraction = fmodf(i * 0.6180340f, 1.0f);
+            float offset = spread * (2 * fraction - 1);
+            scenario_actor_t actor = {};
+            actor.slot = -1;
+            actor.start = start + i * interval;
+            actor.speed = speed;
+            actor.expect = expect;
+            actor.path.push_back({{from.x + side.x * offset, from.y + side.y * offset}, 0});
+            actor.path.push_back({{to.x + side.x * offset, to.y + side.y * offset}, 0});
+            actor.end = actor.start + walk_time(&actor);
+            this->actors.push_back(actor);
+        }
+        return true;
+    }
+    if(strcmp(command, "ghost") == 0)
+    {
+        scenario_actor_t actor = {};
+        scenario_waypoint_t waypoint = {};
+        actor.slot = -1;
+        if(count != 4 || !parse_float(tokens[1], &actor.start) || !parse_float(tokens[2], &actor.end) ||
+           !parse_point(tokens[3], &waypoint.point))
+        {
+            *error = "ghost START END X,Y";
+            return false;
+        }
+        actor.path.push_back(waypoint);
+        this->actors.push_back(actor);
+        return true;
+    }
+    if(strcmp(command, "teleport") == 0 || strcmp(command, "swap") == 0)
+    {
+        scenario_spike_t spike = {};
+        float slot, other = 0;
+        spike.swap = (command[0] == 's');
+        bool valid = count == 4 && parse_float(tokens[1], &spike.time) && parse_float(tokens[2], &slot) &&
+            slot >= 0 && slot < MAX_TARGETS_DETECTION;
+        if(valid && spike.swap) valid = parse_float(tokens[3], &other) && other >= 0 && other < MAX_TARGETS_DETECTION;
+        else if(valid) valid = parse_point(tokens[3], &spike.point);
+        if(!valid)
+        {
+            *error = spike.swap ? "swap TIME SLOT SLOT" : "teleport TIME SLOT X,Y";
+            return false;
+        }
+        spike.slot = (uint8_t)slot;
+        spike.other_slot = (uint8_t)other;
+        this->spikes.push_back(spike);
+        return true;
+    }
+    *error = std::string("unknown command ") + command;
+    return false;
+}
+
+void Scenario::reset()
+{
+    this->random.seed(this->seed);
+    this->report_index = 0;
+    this->next_spike = 0;
+    this->hidden = 0;
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++) this->slot_order[i] = i;
+    for(scenario_actor_t& actor : this->actors) actor.slot = -1;
+    std::stable_sort(this->spikes.begin(), this->spikes.end(),
+        [](const scenario_spike_t& a, const scenario_spike_t& b){return a.time < b.time;});
+}
+
+float Scenario::gaussian()
+{
+    // Box-Muller on the generator output, std::normal_distribution differs between libraries
+    double u1 = (this->random() + 0.5) / 4294967296.0;
+    double u2 = (this->random() + 0.5) / 4294967296.0;
+    return (float)(sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+}
+
+scenario_point_t Scenario::position_at(const scenario_actor_t* actor, float time)
+{
+    float t = time - actor->start;
+    const std::vector<scenario_waypoint_t>& path = actor->path;
+    for(size_t i=0; i<path.size(); i++)
+    {
+        if(t <= path[i].wait || i + 1 == path.size()) return path[i].point;
+        t -= path[i].wait;
+        float dx = path[i+1].point.x - path[i].point.x;
+        float dy = path[i+1].point.y - path[i].point.y;
+        float segment = sqrtf(dx*dx + dy*dy) / actor->speed;
+        if(t <= segment)
+        {
+            float fraction = (segment > 0) ? t / segment : 1;
+            return {path[i].point.x + dx * fraction, path[i].point.y + dy * fraction};
+        }
+        t -= segment;
+    }
+    return path.back().point;
+}
+
+bool Scenario::next(ld2461_detection_t* report)
+{
+    float time = this->report_index / this->rate;
+    if(time >= this->get_duration()) return false;
+
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        report->target[i] = {0, 0};
+        report->is_target_available[i] = LD2461_TARGET_UNAVAILABLE;
+        report->track_id[i] = 0;
+    }
+    report->detected_targets = 0;
+    report->timestamp = (int64_t)this->report_index * this->get_period();
+    this->report_index++;
+
+    // People keep their slot while they are seen, new ones take the lowest free one
+    bool taken[MAX_TARGETS_DETECTION] = {};
+    for(scenario_actor_t& actor : this->actors)
+    {
+        if(time < actor.start || time >= actor.end) actor.slot = -1;
+        else if(actor.slot >= 0) taken[actor.slot] = true;
+    }
+    ld2461_coordinate_t slots[MAX_TARGETS_DETECTION] = {};
+    bool present[MAX_TARGETS_DETECTION] = {};
+    for(scenario_actor_t& actor : this->actors)
+    {
+        if(time < actor.start || time >= actor.end) continue;
+        if(actor.slot < 0)
+        {
+            for(int i=0; i<MAX_TARGETS_DETECTION && actor.slot < 0; i++)
+            {
+                if(!taken[i]) actor.slot = i;
+            }
+            if(actor.slot < 0)
+            {
+                this->hidden++;
+                continue;
+            }
+            taken[actor.slot] = true;
+        }
+        scenario_point_t position = this->position_at(&actor, time);
+        if(this->noise > 0)
+        {
+            position.x += this->noise * this->gaussian();
+            position.y += this->noise * this->gaussian();
+        }
+        slots[actor.slot] = {meters_to_report(position.x), meters_to_report(position.y)};
+        if(slots[actor.slot].x == 0 && slots[actor.slot].y == 0) slots[actor.slot].y = 1; // (0, 0) is no target
+        present[actor.slot] = true;
+    }
+
+    // Slots in the order the radar reports them
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        if(!present[i]) continue;
+        report->target[this->slot_order[i]] = slots[i];
+        report->is_target_available[this->slot_order[i]] = LD2461_TARGET_AVAILABLE;
+    }
+    for(; this->next_spike < this->spikes.size() && this->spikes[this->next_spike].time <= time; this->next_spike++)
+    {
+        const scenario_spike_t* spike = &this->spikes[this->next_spike];
+        if(spike->swap)
+        {
+            for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+            {
+                if(this->slot_order[i] == spike->slot) this->slot_order[i] = spike->other_slot;
+                else if(this->slot_order[i] == spike->other_slot) this->slot_order[i] = spike->slot;
+            }
+            std::swap(report->target[spike->slot], report->target[spike->other_slot]);
+            std::swap(report->is_target_available[spike->slot], report->is_target_available[spike->other_slot]);
+        }
+        else
+        {
+            report->target[spike->slot] = {meters_to_report(spike->point.x), meters_to_report(spike->point.y)};
+            report->is_target_available[spike->slot] = LD2461_TARGET_AVAILABLE;
+        }
+    }
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        if(report->is_target_available[i] == LD2461_TARGET_AVAILABLE) report->detected_targets++;
+    }
+    return true;
+}
+
+void Scenario::set_rate(float rate)
+{
+    if(rate > 0) this->rate = rate;
+}
+
+void Scenario::set_seed(uint32_t seed)
+{
+    this->seed = seed;
+    this->reset();
+}
+
+int64_t Scenario::get_period()
+{
+    return (int64_t)llroundf(1000000 / this->rate);
+}
+
+float Scenario::get_duration()
+{
+    if(this->duration > 0) return this->duration;
+    float end = 0;
+    for(const scenario_actor_t& actor : this->actors) end = std::max(end, actor.end);
+    return end;
+}
+
+uint32_t Scenario::get_expected(uint8_t expect)
+{
+    uint32_t count = 0;
+    for(const scenario_actor_t& actor : this->actors)
+    {
+        if(actor.expect == expect && actor.speed > 0) count++;
+    }
+    return count;
+}
+
+uint32_t Scenario::get_hidden()
+{
+    return this->hidden;
+}
+
+size_t Scenario::get_actors()
+{
+    return this->actors.size();
+}
@@ -0,0 +1,151 @@
+#include "work_pool.hpp"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#define WORK_POOL_POLL_PERIOD 100000000L   // Nanoseconds between the checks of the workers
+#define WORK_POOL_PROGRESS_POLLS 10        // Progress reported every N polls
+
+typedef struct work_range{
+    size_t begin;               // Next job of the worker
+    size_t end;                 // One past its last job
+}work_range_t;
+
+// Shared by the workers, followed by the ranges, the done flags and the results
+typedef struct work_shared{
+    pthread_mutex_t lock;       // Guards the ranges
+    size_t done;                // Jobs finished (atomic)
+}work_shared_t;
+
+WorkPool::WorkPool(int workers)
+{
+    if(workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    this->workers = (workers > 0) ? workers : 1;
+}
+
+int WorkPool::get_workers()
+{
+    return this->workers;
+}
+
+/**
+ * @brief Next job of a worker, from its range or stolen from the biggest one
+ *
+ * @return true If there was a job left
+ */
+static bool next_job(work_shared_t* shared, work_range_t* ranges, int workers, int worker, size_t* job)
+{
+    pthread_mutex_lock(&shared->lock);
+    work_range_t* own = &ranges[worker];
+    if(own->begin == own->end)
+    {
+        work_range_t* victim = NULL;
+        for(int i=0; i<workers; i++)
+        {
+            if(ranges[i].end - ranges[i].begin > 0 &&
+               (victim == NULL || ranges[i].end - ranges[i].begin > victim->end - victim->begin)) victim = &ranges[i];
+        }
+        if(victim == NULL)
+        {
+            pthread_mutex_unlock(&shared->lock);
+            return false;
+        }
+        // The back half, the victim keeps the jobs next to the one it runs
+        size_t stolen = (victim->end - victim->begin + 1) / 2;
+        own->begin = victim->end - stolen;
+        own->end = victim->end;
+        victim->end -= stolen;
+    }
+    *job = own->begin++;
+    pthread_mutex_unlock(&shared->lock);
+    return true;
+}
+
+bool WorkPool::run(size_t count, size_t result_size, void* results, const work_function_t& work,
+    const work_progress_t& progress)
+{
+    if(count == 0) return true;
+    int workers = ((size_t)this->workers < count) ? this->workers : (int)count;
+
+    size_t ranges_offset = sizeof(work_shared_t);
+    size_t done_offset = ranges_offset + workers * sizeof(work_range_t);
+    size_t results_offset = (done_offset + count + 15) & ~(size_t)15;
+    size_t size = results_offset + count * result_size;
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED) return false;
+    work_shared_t* shared = (work_shared_t*)memory;
+    work_range_t* ranges = (work_range_t*)((uint8_t*)memory + ranges_offset);
+    uint8_t* done = (uint8_t*)memory + done_offset;
+    uint8_t* shared_results = (uint8_t*)memory + results_offset;
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&shared->lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    for(int i=0; i<workers; i++) ranges[i] = {count * i / workers, count * (i + 1) / workers};
+
+    // Buffered output would be written again by every worker
+    fflush(NULL);
+    std::vector<pid_t> pids;
+    bool started = true;
+    for(int worker=0; worker<workers && started; worker++)
+    {
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            size_t job;
+            while(next_job(shared, ranges, workers, worker, &job))
+            {
+                work(job, shared_results + job * result_size);
+                done[job] = 1;
+                __atomic_add_fetch(&shared->done, 1, __ATOMIC_RELAXED);
+            }
+            fflush(NULL);
+            _exit(0);
+        }
+        if(pid < 0) started = false;
+        else pids.push_back(pid);
+    }
+
+    // The workers that started take the jobs of those that did not, a worker that died leaves its range to the others
+    bool failed = pids.empty();
+    int polls = 0;
+    while(!pids.empty())
+    {
+        for(size_t i=0; i<pids.size(); )
+        {
+            int status;
+            pid_t pid = waitpid(pids[i], &status, WNOHANG);
+            if(pid == 0)
+            {
+                i++;
+                continue;
+            }
+            if(pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = true;
+            pids.erase(pids.begin() + i);
+        }
+        if(pids.empty()) break;
+        struct timespec period = {0, WORK_POOL_POLL_PERIOD};
+        nanosleep(&period, NULL);
+        if(progress && ++polls % WORK_POOL_PROGRESS_POLLS == 0) progress(__atomic_load_n(&shared->done, __ATOMIC_RELAXED), count);
+    }
+
+    for(size_t job=0; job<count; job++)
+    {
+        if(!done[job]) failed = true;
+    }
+    if(progress) progress(shared->done, count);
+    memcpy(results, shared_results, count * result_size);
+    pthread_mutex_destroy(&shared->lock);
+    munmap(memory, size);
+    return !failed;
+}
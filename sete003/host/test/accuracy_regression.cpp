@@ -0,0 +1,215 @@
+/*
+Counting Accuracy Regression
+----------------------------
+For every logs/<DD-MM-YY>/ day with a data_by_two export, replays the raw
+recording of the sensor (<raw>/<sensor>/<YYYY-MM-DD>-ld2461.jsonl, as
+server/data_input stores it) through the host Detection and matches its
+entered and exited events against data_by_two. One JSON line per day gives
+the precision, recall and net count error of the replay, and of the counters
+the firmware published that day (sensor_data export).
+
+A day fails when the replay is worse than its baseline by more than the
+tolerance. The baseline is the line of the day in the baseline file
+(day,precision,recall,net_error, written with --write-baseline), or the
+firmware of that day when the file does not have it.
+
+Exit code 0 if every replayed day passed, 1 if one regressed, 77 (skipped)
+if no day had a raw recording.
+
+Usage: accuracy_regression --logs DIR --raw DIR [--sensor D80C] [--window S] [--tolerance T]
+                           [--area ...] [--baseline FILE] [--write-baseline FILE]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "accuracy.hpp"
+#include "esp_log.h"
+#include "host_platform.hpp"
+#include "replay.hpp"
+
+#define EXIT_SKIPPED 77
+#define DEFAULT_TOLERANCE 0.02
+
+typedef struct baseline{
+    double precision;
+    double recall;
+    double net_error;
+}baseline_t;
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s --logs DIR --raw DIR [--sensor D80C] [--window S] [--tolerance T]\n"
+        "       [--area D0x,D0y,D1x,D1y,D2x,D2y,D3x,D3y,S0x,S0y,S1x,S1y] [--baseline FILE] [--write-baseline FILE]\n", name);
+}
+
+static void read_baseline(const char* path, std::map<std::string, baseline_t>* baselines)
+{
+    FILE* file = fopen(path, "r");
+    if(file == NULL) return;
+    char line[128];
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        char day[16];
+        baseline_t baseline;
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%15[^,],%lf,%lf,%lf", day, &baseline.precision, &baseline.recall, &baseline.net_error) != 4) continue;
+        (*baselines)[day] = baseline;
+    }
+    fclose(file);
+}
+
+static bool parse_area(const char* text, point_t* area)
+{
+    float values[12];
+    if(sscanf(text, "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f",
+        &values[0], &values[1], &values[2], &values[3], &values[4], &values[5],
+        &values[6], &values[7], &values[8], &values[9], &values[10], &values[11]) != 12) return false;
+    for(int i=0; i<6; i++) area[i] = {values[2*i], values[2*i+1]};
+    return true;
+}
+
+static void print_accuracy(const char* name, const accuracy_t* accuracy)
+{
+    printf("\"%s\": {\"detected\": %u,\"reference\": %u,\"matched\": %u,\"precision\": %.3f,\"recall\": %.3f,\"net_error\": %.3f}",
+        name, accuracy->detected, accuracy->reference, accuracy->matched,
+        accuracy->precision, accuracy->recall, accuracy->net_error);
+}
+
+int main(int argc, char** argv)
+{
+    const char* logs_dir = NULL;
+    const char* raw_dir = NULL;
+    const char* sensor_id = "D80C";
+    const char* baseline_path = NULL;
+    const char* write_baseline_path = NULL;
+    int64_t window = ACCURACY_DEFAULT_WINDOW;
+    double tolerance = DEFAULT_TOLERANCE;
+    replay_options_t options = replay_default_options();
+
+    for(int i=1; i<argc; i++)
+    {
+        bool has_value = i+1 < argc;
+        if(strcmp(argv[i], "--logs") == 0 && has_value) logs_dir = argv[++i];
+        else if(strcmp(argv[i], "--raw") == 0 && has_value) raw_dir = argv[++i];
+        else if(strcmp(argv[i], "--sensor") == 0 && has_value) sensor_id = argv[++i];
+        else if(strcmp(argv[i], "--window") == 0 && has_value) window = (int64_t)(atof(argv[++i]) * 1000000);
+        else if(strcmp(argv[i], "--tolerance") == 0 && has_value) tolerance = atof(argv[++i]);
+        else if(strcmp(argv[i], "--baseline") == 0 && has_value) baseline_path = argv[++i];
+        else if(strcmp(argv[i], "--write-baseline") == 0 && has_value) write_baseline_path = argv[++i];
+        else if(strcmp(argv[i], "--area") == 0 && has_value && parse_area(argv[i+1], options.area))
+        {
+            options.area_set = true;
+            i++;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(logs_dir == NULL || raw_dir == NULL)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    std::map<std::string, baseline_t> baselines;
+    if(baseline_path != NULL) read_baseline(baseline_path, &baselines);
+
+    std::vector<accuracy_day_t> days;
+    if(!accuracy_days_read(logs_dir, raw_dir, sensor_id, &days))
+    {
+        fprintf(stderr, "%s: can not open %s\n", argv[0], logs_dir);
+        return EXIT_SKIPPED;
+    }
+
+    MemoryStorage storage;
+    host_set_storage(&storage);
+    FILE* baseline_file = (write_baseline_path != NULL) ? fopen(write_baseline_path, "w") : NULL;
+    if(baseline_file != NULL) fprintf(baseline_file, "# day,precision,recall,net_error\n");
+    int replayed = 0, failed = 0;
+
+    for(const accuracy_day_t& day : days)
+    {
+        if(!day.has_reference)
+        {
+            fprintf(stderr, "%s: %s is not a data_by_two export\n", argv[0], day.reference_path.c_str());
+            continue;
+        }
+        accuracy_t firmware_accuracy;
+        accuracy_match(day.firmware, day.reference, window, &firmware_accuracy);
+        FILE* raw = fopen(day.raw_path.c_str(), "r");
+
+        printf("{\"day\": \"%s\",", day.name.c_str());
+        if(raw == NULL)
+        {
+            if(day.has_firmware)
+            {
+                print_accuracy("firmware", &firmware_accuracy);
+                printf(",");
+            }
+            printf("\"replay\": null}\n");
+            continue;
+        }
+
+        storage.clear();
+        replay_result_t result;
+        replay_file(raw, &options, &result);
+        fclose(raw);
+        replayed++;
+
+        // Only the crossings during the recording are compared, the firmware ones too
+        std::vector<int64_t> detected;
+        for(const replay_event_t& event : result.events)
+        {
+            if(event.type == CROSSING_ENTERED || event.type == CROSSING_EXITED) detected.push_back(event.timestamp);
+        }
+        std::sort(detected.begin(), detected.end());
+        std::vector<int64_t> covered_reference = accuracy_span(day.reference, result.first_time, result.last_time, window);
+        accuracy_t accuracy;
+        accuracy_match(detected, covered_reference, window, &accuracy);
+        accuracy_match(accuracy_span(day.firmware, result.first_time, result.last_time, window), covered_reference, window, &firmware_accuracy);
+
+        baseline_t baseline;
+        auto stored = baselines.find(day.name);
+        if(stored != baselines.end()) baseline = stored->second;
+        else baseline = {firmware_accuracy.precision, firmware_accuracy.recall, firmware_accuracy.net_error};
+        bool passed = accuracy.precision >= baseline.precision - tolerance &&
+            accuracy.recall >= baseline.recall - tolerance &&
+            accuracy.net_error <= baseline.net_error + tolerance;
+        // Without a baseline of its own the day is only reported
+        if(stored == baselines.end() && !day.has_firmware) passed = true;
+        if(!passed) failed++;
+
+        if(day.has_firmware)
+        {
+            print_accuracy("firmware", &firmware_accuracy);
+            printf(",");
+        }
+        print_accuracy("replay", &accuracy);
+        printf(",\"baseline\": {\"precision\": %.3f,\"recall\": %.3f,\"net_error\": %.3f},\"passed\": %s}\n",
+            baseline.precision, baseline.recall, baseline.net_error, passed ? "true" : "false");
+        if(baseline_file != NULL)
+        {
+            fprintf(baseline_file, "%s,%.3f,%.3f,%.3f\n", day.name.c_str(), accuracy.precision, accuracy.recall, accuracy.net_error);
+        }
+    }
+    if(baseline_file != NULL) fclose(baseline_file);
+    host_set_storage(NULL);
+
+    if(replayed == 0)
+    {
+        fprintf(stderr, "%s: no raw recording of %s in %s, nothing replayed\n", argv[0], sensor_id, raw_dir);
+        return EXIT_SKIPPED;
+    }
+    return failed ? 1 : 0;
+}
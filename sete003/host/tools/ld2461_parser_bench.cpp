@@ -0,0 +1,169 @@
+/*
+LD2461 Parser Benchmark
+-----------------------
+Feeds a byte stream through LD2461Parser in UART sized chunks and reports the
+throughput in bytes/second.
+
+The stream comes from a recorded raw radar JSONL (the "<timestamp>;{"t_0": ...}"
+lines saved by server/data_input) re-encoded as RADAR_REPORT_1 frames, or from
+a raw capture of the UART (--raw).
+
+Usage: ld2461_parser_bench [--raw] [--chunk N] [--bytes N] [--noise P] <file>
+*/
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ld2461_codec.hpp"
+#include "ld2461_parser.hpp"
+
+static void append_report_frame(std::vector<uint8_t>* stream, const ld2461_coordinate_t* targets, int count)
+{
+    uint8_t frame[LD2461_MAX_FRAME_SIZE];
+    size_t size = ld2461_encode_report(frame, sizeof(frame), targets, count);
+    stream->insert(stream->end(), frame, frame + size);
+}
+
+/**
+ * @brief Encode every line of a raw radar JSONL as a report frame
+ *
+ * @return size_t Number of frames encoded
+ */
+static size_t load_jsonl(const char* path, std::vector<uint8_t>* stream)
+{
+    FILE* file = fopen(path, "r");
+    if(file == NULL) return 0;
+
+    size_t frames = 0;
+    char line[1024];
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        const char* cursor = strchr(line, ';');
+        if(cursor == NULL) continue;
+
+        ld2461_coordinate_t targets[16];
+        int count = 0;
+        while(count < 16 && (cursor = strstr(cursor, "\"x\":")) != NULL)
+        {
+            float x = strtof(cursor + 4, (char**)&cursor);
+            cursor = strstr(cursor, "\"y\":");
+            if(cursor == NULL) break;
+            float y = strtof(cursor + 4, (char**)&cursor);
+            targets[count].x = (int8_t)lroundf(x * 10);
+            targets[count].y = (int8_t)lroundf(y * 10);
+            count++;
+        }
+        // The radar only reports up to the last valid target
+        append_report_frame(stream, targets, ld2461_report_length(targets, count));
+        frames++;
+    }
+    fclose(file);
+    return frames;
+}
+
+static size_t load_raw(const char* path, std::vector<uint8_t>* stream)
+{
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) return 0;
+    uint8_t chunk[4096];
+    size_t length;
+    while((length = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        stream->insert(stream->end(), chunk, chunk + length);
+    }
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool raw = false;
+    size_t chunk = 128;
+    size_t minimum_bytes = 64 * 1024 * 1024;
+    double noise = 0;
+    const char* path = NULL;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--raw") == 0) raw = true;
+        else if(strcmp(argv[i], "--chunk") == 0 && i+1 < argc) chunk = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--bytes") == 0 && i+1 < argc) minimum_bytes = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--noise") == 0 && i+1 < argc) noise = strtod(argv[++i], NULL);
+        else path = argv[i];
+    }
+    if(path == NULL || chunk == 0)
+    {
+        fprintf(stderr, "Usage: %s [--raw] [--chunk N] [--bytes N] [--noise P] <file>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> recording;
+    size_t recorded_frames = raw ? load_raw(path, &recording) : load_jsonl(path, &recording);
+    if(recording.empty())
+    {
+        fprintf(stderr, "No data found in %s\n", path);
+        return 1;
+    }
+
+    // Repeat the recording until the stream is big enough to be timed
+    std::vector<uint8_t> stream;
+    size_t expected_frames = 0;
+    while(stream.size() < minimum_bytes)
+    {
+        stream.insert(stream.end(), recording.begin(), recording.end());
+        expected_frames += recorded_frames;
+    }
+
+    // Flip random bytes to exercise the resynchronisation path
+    size_t corrupted = 0;
+    if(noise > 0)
+    {
+        srand(2461);
+        for(size_t i=0; i<stream.size(); i++)
+        {
+            if((double)rand() / RAND_MAX < noise) {stream[i] ^= 0x5A; corrupted++;}
+        }
+    }
+
+    LD2461Parser* parser = new LD2461Parser();
+    ld2461_frame_t frame;
+    size_t frames = 0;
+    uint32_t value_sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t offset=0; offset<stream.size(); offset += chunk)
+    {
+        size_t length = (stream.size() - offset < chunk) ? (stream.size() - offset) : chunk;
+        parser->push(stream.data() + offset, length);
+        while(parser->next_frame(&frame))
+        {
+            frames++;
+            value_sum += frame.command_value[0];
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    const ld2461_parser_stats_t* stats = parser->get_stats();
+    printf("Stream: %zu bytes (%zu corrupted), chunk %zu bytes\n", stream.size(), corrupted, chunk);
+    printf("Parsed: %zu frames in %.3f s (checksum %u | trailer %u | length %u | discarded %u | overrun %u)\n",
+        frames, seconds,
+        stats->checksum_errors, stats->trailer_errors, stats->length_errors,
+        stats->discarded_bytes, stats->overruns
+    );
+    printf("Throughput: %.1f MB/s | %.0f frames/s (checksum of values %u)\n",
+        stream.size() / seconds / 1e6, frames / seconds, value_sum);
+
+    delete parser;
+    if(!raw && noise == 0 && frames != expected_frames)
+    {
+        fprintf(stderr, "Expected %zu frames, parsed %zu\n", expected_frames, frames);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+Replay
+------
+Counts raw radar recordings (radar_raw_data/<sensor>/<date>-ld2461.jsonl,
+the .jsonl files of tools/test_env/data_sender) with the firmware detection on a
+simulated clock, as fast as the host goes. Every file is a run, for each one
+a JSON line with the counts is printed, preceded by its events with --events.
+
+Usage: sete_replay [--radars N] [--radar-pipeline] [--line] [--period US]
+                   [--area D0x,D0y,D1x,D1y,D2x,D2y,D3x,D3y,S0x,S0y,S1x,S1y]
+                   [--events] [--verbose] FILE...
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "host_platform.hpp"
+#include "replay.hpp"
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s [--radars N] [--radar-pipeline] [--line] [--period US]\n"
+        "       [--area D0x,D0y,D1x,D1y,D2x,D2y,D3x,D3y,S0x,S0y,S1x,S1y] [--events] [--verbose] FILE...\n", name);
+}
+
+static bool parse_area(const char* text, point_t* area)
+{
+    float values[12];
+    if(sscanf(text, "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f",
+        &values[0], &values[1], &values[2], &values[3], &values[4], &values[5],
+        &values[6], &values[7], &values[8], &values[9], &values[10], &values[11]) != 12) return false;
+    for(int i=0; i<6; i++) area[i] = {values[2*i], values[2*i+1]};
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    replay_options_t options = replay_default_options();
+    bool print_events = false;
+    bool verbose = false;
+    int first_file = argc;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--radars") == 0 && i+1 < argc) options.radars = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--radar-pipeline") == 0) options.radar_pipeline = true;
+        else if(strcmp(argv[i], "--line") == 0) options.counting_mode = COUNTING_LINE;
+        else if(strcmp(argv[i], "--period") == 0 && i+1 < argc) options.publish_period = strtoll(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--area") == 0 && i+1 < argc)
+        {
+            if(!parse_area(argv[++i], options.area))
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            options.area_set = true;
+        }
+        else if(strcmp(argv[i], "--events") == 0) print_events = true;
+        else if(strcmp(argv[i], "--verbose") == 0) verbose = true;
+        else if(argv[i][0] == '-')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            first_file = i;
+            break;
+        }
+    }
+    if(first_file >= argc || options.radars < 1 || options.radars > MAX_RADARS)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+    MemoryStorage storage;
+    host_set_storage(&storage);
+    int failed = 0;
+    for(int i=first_file; i<argc; i++)
+    {
+        FILE* file = fopen(argv[i], "r");
+        if(file == NULL)
+        {
+            fprintf(stderr, "%s: can not open %s\n", argv[0], argv[i]);
+            failed++;
+            continue;
+        }
+
+        storage.clear(); // Every run starts from an erased NVS
+        replay_result_t result;
+        auto start = std::chrono::steady_clock::now();
+        replay_file(file, &options, &result);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fclose(file);
+
+        if(print_events)
+        {
+            for(const replay_event_t& event : result.events) printf("%s\n", event.json.c_str());
+        }
+        double span = (result.last_time - result.first_time) / 1e6;
+        printf("{\"file\": \"%s\",\"reports\": %u,\"skipped\": %u,\"span_s\": %.3f,\"replay_s\": %.3f,\"speedup\": %.0f,"
+            "\"entered\": %u,\"exited\": %u,\"gave_up\": %u,\"events\": %zu,\"dropped_events\": %u,\"occupancy\": %d}\n",
+            argv[i], result.reports, result.skipped_lines, span, elapsed, (elapsed > 0) ? span / elapsed : 0,
+            result.counts[CROSSING_ENTERED], result.counts[CROSSING_EXITED], result.counts[CROSSING_GAVE_UP],
+            result.events.size(), result.dropped_events, result.occupancy);
+    }
+    host_set_storage(NULL);
+    return failed ? 1 : 0;
+}
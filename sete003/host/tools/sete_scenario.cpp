@@ -0,0 +1,202 @@
+/*
+Scenario
+--------
+Generates the LD2461 reports of a scenario script (include/scenario.hpp) and
+counts them on the host firmware, through the whole radar pipeline or, with
+--direct, straight into the detection. Prints a JSON line with the counts,
+what the script expected and the time the firmware took per report, preceded
+by the events with --events. The exit code is 1 when the entrances or exits
+differ from what the script expected, so a script is a test.
+
+With --bytes or --jsonl the reports are written instead: a raw LD2461 byte
+stream (the UART of the radar) or a raw recording like the server stores
+(sete_replay reads it), with only the reports that had a target like the
+server keeps them. "-" is the standard output. --start sets the UTC time the
+scenario starts at (2025-01-01 00:00:00 by default), e.g. to write a recording
+next to the logs/ exports of a day.
+
+Usage: sete_scenario [--rate HZ] [--seed N] [--direct] [--line] [--start "YYYY-MM-DD HH:MM:SS"]
+                     [--area D0x,D0y,D1x,D1y,D2x,D2y,D3x,D3y,S0x,S0y,S1x,S1y] [--events]
+                     [--bytes FILE | --jsonl FILE] SCRIPT
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "host_platform.hpp"
+#include "ld2461_codec.hpp"
+#include "replay.hpp"
+#include "scenario.hpp"
+
+#define SCENARIO_EPOCH 1735689600000000LL   // 2025-01-01 00:00:00 UTC (us), the scenario starts at boot
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s [--rate HZ] [--seed N] [--direct] [--line] [--start \"YYYY-MM-DD HH:MM:SS\"]\n"
+        "       [--area D0x,D0y,D1x,D1y,D2x,D2y,D3x,D3y,S0x,S0y,S1x,S1y] [--events]\n"
+        "       [--bytes FILE | --jsonl FILE] SCRIPT\n", name);
+}
+
+static bool parse_area(const char* text, point_t* area)
+{
+    float values[12];
+    if(sscanf(text, "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f",
+        &values[0], &values[1], &values[2], &values[3], &values[4], &values[5],
+        &values[6], &values[7], &values[8], &values[9], &values[10], &values[11]) != 12) return false;
+    for(int i=0; i<6; i++) area[i] = {values[2*i], values[2*i+1]};
+    return true;
+}
+
+static FILE* open_output(const char* path)
+{
+    return (strcmp(path, "-") == 0) ? stdout : fopen(path, "wb");
+}
+
+/**
+ * @brief One line of a raw recording: server time;payload
+ */
+static void write_record(FILE* out, const ld2461_detection_t* report, int64_t epoch)
+{
+    int64_t utc = epoch + REPLAY_BOOT_TIME + report->timestamp;
+    time_t seconds = utc / 1000000;
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    fprintf(out, "%s.%06ld;{", date, (long)(utc % 1000000));
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        fprintf(out, "\"t_%d\": {\"x\": %f,\"y\": %f},", i, report->target[i].x / 10.0, report->target[i].y / 10.0);
+    }
+    fprintf(out, "\"radar\": 0}\n");
+}
+
+int main(int argc, char** argv)
+{
+    replay_options_t options = replay_default_options();
+    options.radar_pipeline = true;
+    float rate = 0;
+    long seed = -1;
+    int64_t epoch = SCENARIO_EPOCH;
+    bool print_events = false;
+    const char* bytes_path = NULL;
+    const char* jsonl_path = NULL;
+    const char* script_path = NULL;
+
+    for(int i=1; i<argc; i++)
+    {
+        bool has_value = i+1 < argc;
+        if(strcmp(argv[i], "--rate") == 0 && has_value) rate = atof(argv[++i]);
+        else if(strcmp(argv[i], "--seed") == 0 && has_value) seed = strtol(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--direct") == 0) options.radar_pipeline = false;
+        else if(strcmp(argv[i], "--line") == 0) options.counting_mode = COUNTING_LINE;
+        else if(strcmp(argv[i], "--events") == 0) print_events = true;
+        else if(strcmp(argv[i], "--bytes") == 0 && has_value) bytes_path = argv[++i];
+        else if(strcmp(argv[i], "--jsonl") == 0 && has_value) jsonl_path = argv[++i];
+        else if(strcmp(argv[i], "--start") == 0 && has_value && record_time_parse(argv[i+1], &epoch)) i++;
+        else if(strcmp(argv[i], "--area") == 0 && has_value && parse_area(argv[i+1], options.area))
+        {
+            options.area_set = true;
+            i++;
+        }
+        else if(argv[i][0] != '-' && script_path == NULL) script_path = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(script_path == NULL || (bytes_path != NULL && jsonl_path != NULL))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Scenario scenario;
+    FILE* script = fopen(script_path, "r");
+    if(script == NULL)
+    {
+        fprintf(stderr, "%s: can not open %s\n", argv[0], script_path);
+        return 1;
+    }
+    std::string error;
+    bool parsed = scenario.parse(script, &error);
+    fclose(script);
+    if(!parsed)
+    {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], script_path, error.c_str());
+        return 1;
+    }
+    if(rate > 0) scenario.set_rate(rate);
+    if(seed >= 0) scenario.set_seed((uint32_t)seed);
+
+    ld2461_detection_t report;
+    if(bytes_path != NULL || jsonl_path != NULL)
+    {
+        FILE* out = open_output((bytes_path != NULL) ? bytes_path : jsonl_path);
+        if(out == NULL)
+        {
+            fprintf(stderr, "%s: can not write %s\n", argv[0], (bytes_path != NULL) ? bytes_path : jsonl_path);
+            return 1;
+        }
+        while(scenario.next(&report))
+        {
+            if(jsonl_path != NULL)
+            {
+                if(report.detected_targets > 0) write_record(out, &report, epoch);
+                continue;
+            }
+            uint8_t frame[LD2461_MAX_FRAME_SIZE];
+            size_t size = ld2461_encode_report(frame, sizeof(frame), report.target,
+                ld2461_report_length(report.target, MAX_TARGETS_DETECTION));
+            fwrite(frame, 1, size, out);
+        }
+        if(out != stdout) fclose(out);
+        return 0;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    MemoryStorage storage;
+    host_set_storage(&storage);
+    replay_result_t result;
+    double total = 0, worst = 0;
+    int max_targets = 0;
+    {
+        Replay replay(&options, epoch, &result);
+        while(scenario.next(&report))
+        {
+            if(report.detected_targets > max_targets) max_targets = report.detected_targets;
+            auto start = std::chrono::steady_clock::now();
+            replay.add(0, &report, REPLAY_BOOT_TIME + report.timestamp);
+            double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            total += elapsed;
+            if(elapsed > worst) worst = elapsed;
+        }
+        replay.finish();
+    }
+    host_set_storage(NULL);
+
+    if(print_events)
+    {
+        for(const replay_event_t& event : result.events) printf("%s\n", event.json.c_str());
+    }
+    printf("{\"scenario\": \"%s\",\"reports\": %u,\"period_us\": %lld,\"max_targets\": %d,\"hidden\": %u,"
+        "\"report_us_avg\": %.3f,\"report_us_worst\": %.3f,"
+        "\"entered\": %u,\"exited\": %u,\"gave_up\": %u,\"expected_entered\": %u,\"expected_exited\": %u,\"events\": %zu}\n",
+        script_path, result.reports, (long long)scenario.get_period(), max_targets, scenario.get_hidden(),
+        result.reports ? total / result.reports : 0, worst,
+        result.counts[CROSSING_ENTERED], result.counts[CROSSING_EXITED], result.counts[CROSSING_GAVE_UP],
+        scenario.get_expected(SCENARIO_EXPECT_ENTERED), scenario.get_expected(SCENARIO_EXPECT_EXITED), result.events.size());
+    if(result.counts[CROSSING_ENTERED] != scenario.get_expected(SCENARIO_EXPECT_ENTERED) ||
+       result.counts[CROSSING_EXITED] != scenario.get_expected(SCENARIO_EXPECT_EXITED))
+    {
+        fprintf(stderr, "%s: %s: the counts differ from the expected ones\n", argv[0], script_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,455 @@
+/*
+Parameter Tuning
+----------------
+Replays the raw recordings of the logs/ days (found like accuracy_regression
+does) through the radar pipeline of the host firmware with every
+configuration of the tuned parameters, on a WorkPool with a worker per CPU,
+and ranks the configurations by the accuracy of their entered and exited
+events: the F1 of the matched crossings over all the days, then the net count
+error. Every configuration not swept keeps the firmware default, and the
+defaults are always scored for comparison.
+
+    --ghost-timer S     Ghost filter timeout in seconds (/ghost_timer/set)
+    --threshold D       Ghost filter teleport distance (/threshold_distance/set, radar units of 0.1 m)
+    --center M          Detection area, a rectangle from center - width/2 to center + width/2
+    --width M
+    --near M            and from near to far, with the counting line S0-S1 on its near side
+    --far M
+    --inverted          Sweep enter_exit_inverted too (--reference sensor_data only)
+
+A value is "V" or "MIN:MAX:STEPS". The grid is every combination of them,
+--random N draws N configurations uniformly from the ranges instead.
+
+--threshold is the jump of a target between two reports, on either axis,
+that the ghost filter flags as a teleport. The tracker keeps the flag on the
+slot and the detection holds the target at its last position for that
+report, a lower threshold drops more of the fast movements.
+
+data_by_two only counts traversals, the direction of a crossing is not known
+and enter_exit_inverted does not change the score. --reference sensor_data
+scores against the entered and exited columns of the sensor_data exports
+instead (a unit whose counters were checked), each direction apart.
+
+The ranking goes to stderr. The winner goes to stdout as a /detection_area/set
+payload, with the ghost_timer, threshold_distance and enter_exit_inverted it
+was scored with (ignored there, they are set by /ghost_timer/set,
+/threshold_distance/set and /detection_area/invert).
+
+Usage: sete_tune --logs DIR --raw DIR [--sensor D80C] [--reference data_by_two|sensor_data]
+                 [--ghost-timer S] [--threshold D] [--center M] [--width M] [--near M] [--far M]
+                 [--inverted] [--random N] [--seed N] [--jobs N] [--window S] [--line] [--top N]
+*/
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "accuracy.hpp"
+#include "esp_log.h"
+#include "ghost_filter.hpp"
+#include "host_platform.hpp"
+#include "replay.hpp"
+#include "work_pool.hpp"
+
+#define TUNE_MAX_CONFIGS 1000000
+#define TUNE_DEFAULT_TOP 10
+
+// Detection area of the firmware (sete003.cpp), -2,3 / -2,1.8 / 2,1.8 / 2,3
+#define TUNE_DEFAULT_CENTER 0.0
+#define TUNE_DEFAULT_WIDTH 4.0
+#define TUNE_DEFAULT_NEAR 1.8
+#define TUNE_DEFAULT_FAR 3.0
+
+typedef enum tune_parameter{
+    TUNE_GHOST_TIMER,           // Seconds
+    TUNE_THRESHOLD,
+    TUNE_CENTER,                // Meters
+    TUNE_WIDTH,
+    TUNE_NEAR,
+    TUNE_FAR,
+    TUNE_PARAMETERS
+}tune_parameter_t;
+
+static const char* const tune_parameter_option[TUNE_PARAMETERS] = {
+    "--ghost-timer", "--threshold", "--center", "--width", "--near", "--far"
+};
+
+typedef struct tune_range{
+    double min;
+    double max;
+    int steps;                  // Grid values from min to max, 1 for min only
+}tune_range_t;
+
+typedef struct tune_config{
+    double value[TUNE_PARAMETERS];
+    bool inverted;
+}tune_config_t;
+
+typedef struct tune_day{
+    std::string name;
+    replay_recording_t recording;
+    const accuracy_day_t* reference;
+}tune_day_t;
+
+// Result of a replay of a day, copied back from the worker
+typedef struct tune_result{
+    accuracy_t accuracy;
+    uint32_t reports;
+}tune_result_t;
+
+typedef struct tune_score{
+    size_t config;
+    accuracy_t accuracy;        // Every day
+    double f1;
+}tune_score_t;
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s --logs DIR --raw DIR [--sensor D80C] [--reference data_by_two|sensor_data]\n"
+        "       [--ghost-timer S] [--threshold D] [--center M] [--width M] [--near M] [--far M]\n"
+        "       [--inverted] [--random N] [--seed N] [--jobs N] [--window S] [--line] [--top N]\n"
+        "       A value is V or MIN:MAX:STEPS\n", name);
+}
+
+static bool parse_range(const char* text, tune_range_t* range)
+{
+    int consumed = 0;
+    if(sscanf(text, "%lf:%lf:%d%n", &range->min, &range->max, &range->steps, &consumed) == 3 && text[consumed] == '\0')
+    {
+        return range->steps >= 1 && range->max >= range->min;
+    }
+    if(sscanf(text, "%lf%n", &range->min, &consumed) == 1 && text[consumed] == '\0')
+    {
+        range->max = range->min;
+        range->steps = 1;
+        return true;
+    }
+    return false;
+}
+
+static double range_value(const tune_range_t* range, int step)
+{
+    if(range->steps <= 1) return range->min;
+    return range->min + (range->max - range->min) * step / (range->steps - 1);
+}
+
+static bool config_valid(const tune_config_t* config)
+{
+    const double* value = config->value;
+    return value[TUNE_GHOST_TIMER] >= 0 && value[TUNE_THRESHOLD] >= 0 &&
+        value[TUNE_WIDTH] > 0 && value[TUNE_NEAR] < value[TUNE_FAR];
+}
+
+static bool config_equal(const tune_config_t* a, const tune_config_t* b)
+{
+    return memcmp(a->value, b->value, sizeof(a->value)) == 0 && a->inverted == b->inverted;
+}
+
+/**
+ * @brief D0..D3 and S0, S1 of the rectangle of a configuration
+ */
+static void config_area(const tune_config_t* config, point_t* area)
+{
+    float left = config->value[TUNE_CENTER] - config->value[TUNE_WIDTH] / 2;
+    float right = config->value[TUNE_CENTER] + config->value[TUNE_WIDTH] / 2;
+    float near = config->value[TUNE_NEAR], far = config->value[TUNE_FAR];
+    area[0] = {left, far};
+    area[1] = {left, near};
+    area[2] = {right, near};
+    area[3] = {right, far};
+    area[4] = area[1];
+    area[5] = area[2];
+}
+
+/**
+ * @brief Every combination of the ranges, the defaults first
+ */
+static bool grid_configs(const tune_range_t* ranges, bool sweep_inverted, const tune_config_t* defaults,
+    std::vector<tune_config_t>* configs)
+{
+    size_t total = sweep_inverted ? 2 : 1;
+    for(int p=0; p<TUNE_PARAMETERS; p++)
+    {
+        total *= ranges[p].steps;
+        if(total > TUNE_MAX_CONFIGS) return false;
+    }
+    configs->push_back(*defaults);
+    for(size_t index=0; index<total; index++)
+    {
+        tune_config_t config;
+        size_t rest = index;
+        for(int p=0; p<TUNE_PARAMETERS; p++)
+        {
+            config.value[p] = range_value(&ranges[p], rest % ranges[p].steps);
+            rest /= ranges[p].steps;
+        }
+        config.inverted = sweep_inverted ? (rest % 2) : defaults->inverted;
+        if(config_valid(&config) && !config_equal(&config, defaults)) configs->push_back(config);
+    }
+    return true;
+}
+
+/**
+ * @brief count configurations drawn uniformly from the ranges, the defaults first
+ */
+static void random_configs(const tune_range_t* ranges, bool sweep_inverted, const tune_config_t* defaults,
+    long count, uint32_t seed, std::vector<tune_config_t>* configs)
+{
+    std::mt19937 generator(seed);
+    configs->push_back(*defaults);
+    long attempts = 0;
+    while((long)configs->size() <= count && attempts++ < count * 100)
+    {
+        tune_config_t config;
+        for(int p=0; p<TUNE_PARAMETERS; p++)
+        {
+            config.value[p] = std::uniform_real_distribution<double>(ranges[p].min, ranges[p].max)(generator);
+        }
+        config.inverted = sweep_inverted ? (generator() & 1) : defaults->inverted;
+        if(config_valid(&config)) configs->push_back(config);
+    }
+}
+
+/**
+ * @brief Times of the events of a type, sorted
+ */
+static std::vector<int64_t> event_times(const replay_result_t* result, uint8_t type)
+{
+    std::vector<int64_t> times;
+    for(const replay_event_t& event : result->events)
+    {
+        if(event.type == type) times.push_back(event.timestamp);
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+static void print_config(FILE* out, const tune_config_t* config)
+{
+    fprintf(out, "ghost_timer %5.2f s  threshold %5.2f  center %5.2f  width %5.2f  near %5.2f  far %5.2f  inverted %d",
+        config->value[TUNE_GHOST_TIMER], config->value[TUNE_THRESHOLD], config->value[TUNE_CENTER],
+        config->value[TUNE_WIDTH], config->value[TUNE_NEAR], config->value[TUNE_FAR], config->inverted);
+}
+
+static void print_score(FILE* out, const tune_score_t* score)
+{
+    fprintf(out, "f1 %.3f  precision %.3f  recall %.3f  net_error %.3f  (%u detected, %u reference, %u matched)",
+        score->f1, score->accuracy.precision, score->accuracy.recall, score->accuracy.net_error,
+        score->accuracy.detected, score->accuracy.reference, score->accuracy.matched);
+}
+
+int main(int argc, char** argv)
+{
+    const char* logs_dir = NULL;
+    const char* raw_dir = NULL;
+    const char* sensor_id = "D80C";
+    bool directional = false;
+    bool sweep_inverted = false;
+    long random_count = 0;
+    uint32_t seed = 1;
+    int jobs = 0;
+    int top = TUNE_DEFAULT_TOP;
+    int64_t window = ACCURACY_DEFAULT_WINDOW;
+    counting_mode_t counting_mode = COUNTING_AREA;
+
+    GhostFilter ghost_filter;
+    tune_config_t defaults;
+    defaults.value[TUNE_GHOST_TIMER] = ghost_filter.get_ghost_timer_timeout() / 1e6;
+    defaults.value[TUNE_THRESHOLD] = ghost_filter.get_max_threshold_distance();
+    defaults.value[TUNE_CENTER] = TUNE_DEFAULT_CENTER;
+    defaults.value[TUNE_WIDTH] = TUNE_DEFAULT_WIDTH;
+    defaults.value[TUNE_NEAR] = TUNE_DEFAULT_NEAR;
+    defaults.value[TUNE_FAR] = TUNE_DEFAULT_FAR;
+    defaults.inverted = false;
+    tune_range_t ranges[TUNE_PARAMETERS];
+    for(int p=0; p<TUNE_PARAMETERS; p++) ranges[p] = {defaults.value[p], defaults.value[p], 1};
+
+    for(int i=1; i<argc; i++)
+    {
+        bool has_value = i+1 < argc;
+        int parameter = -1;
+        for(int p=0; p<TUNE_PARAMETERS; p++)
+        {
+            if(strcmp(argv[i], tune_parameter_option[p]) == 0) parameter = p;
+        }
+        if(parameter >= 0 && has_value && parse_range(argv[i+1], &ranges[parameter])) i++;
+        else if(strcmp(argv[i], "--logs") == 0 && has_value) logs_dir = argv[++i];
+        else if(strcmp(argv[i], "--raw") == 0 && has_value) raw_dir = argv[++i];
+        else if(strcmp(argv[i], "--sensor") == 0 && has_value) sensor_id = argv[++i];
+        else if(strcmp(argv[i], "--reference") == 0 && has_value && strcmp(argv[i+1], "data_by_two") == 0) i++;
+        else if(strcmp(argv[i], "--reference") == 0 && has_value && strcmp(argv[i+1], "sensor_data") == 0)
+        {
+            directional = true;
+            i++;
+        }
+        else if(strcmp(argv[i], "--inverted") == 0) sweep_inverted = true;
+        else if(strcmp(argv[i], "--random") == 0 && has_value) random_count = strtol(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--seed") == 0 && has_value) seed = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--jobs") == 0 && has_value) jobs = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--window") == 0 && has_value) window = (int64_t)(atof(argv[++i]) * 1000000);
+        else if(strcmp(argv[i], "--line") == 0) counting_mode = COUNTING_LINE;
+        else if(strcmp(argv[i], "--top") == 0 && has_value) top = atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(logs_dir == NULL || raw_dir == NULL || random_count < 0 || random_count > TUNE_MAX_CONFIGS)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if(sweep_inverted && !directional)
+    {
+        fprintf(stderr, "%s: --inverted needs --reference sensor_data, data_by_two has no direction\n", argv[0]);
+        return 2;
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    std::vector<tune_config_t> configs;
+    if(random_count > 0) random_configs(ranges, sweep_inverted, &defaults, random_count, seed, &configs);
+    else if(!grid_configs(ranges, sweep_inverted, &defaults, &configs))
+    {
+        fprintf(stderr, "%s: more than %d configurations, use --random\n", argv[0], TUNE_MAX_CONFIGS);
+        return 2;
+    }
+
+    // The recordings are read once, the workers share them
+    std::vector<accuracy_day_t> references;
+    if(!accuracy_days_read(logs_dir, raw_dir, sensor_id, &references))
+    {
+        fprintf(stderr, "%s: can not open %s\n", argv[0], logs_dir);
+        return 1;
+    }
+    std::vector<tune_day_t> days;
+    for(const accuracy_day_t& reference : references)
+    {
+        if(directional ? !reference.has_firmware : !reference.has_reference) continue;
+        FILE* raw = fopen(reference.raw_path.c_str(), "r");
+        if(raw == NULL) continue;
+        tune_day_t day;
+        day.name = reference.name;
+        day.reference = &reference;
+        replay_recording_read(raw, &day.recording);
+        fclose(raw);
+        if(!day.recording.records.empty()) days.push_back(std::move(day));
+    }
+    if(days.empty())
+    {
+        fprintf(stderr, "%s: no raw recording of %s in %s for the days of %s\n", argv[0], sensor_id, raw_dir, logs_dir);
+        return 1;
+    }
+    size_t reports = 0;
+    for(const tune_day_t& day : days) reports += day.recording.records.size();
+
+    WorkPool pool(jobs);
+    size_t count = configs.size() * days.size();
+    fprintf(stderr, "%zu configurations x %zu days (%zu reports), %zu replays on %d workers\n",
+        configs.size(), days.size(), reports, count, pool.get_workers());
+
+    std::vector<tune_result_t> results(count);
+    auto work = [&](size_t job, void* output){
+        const tune_config_t* config = &configs[job / days.size()];
+        const tune_day_t* day = &days[job % days.size()];
+        replay_options_t options = replay_default_options();
+        options.radar_pipeline = true;
+        options.counting_mode = counting_mode;
+        options.area_set = true;
+        config_area(config, options.area);
+        options.ghost_timer = llround(config->value[TUNE_GHOST_TIMER] * 1e6);
+        options.threshold_distance = config->value[TUNE_THRESHOLD];
+        options.enter_exit_inverted = config->inverted;
+
+        MemoryStorage storage;
+        host_set_storage(&storage);
+        replay_result_t result;
+        replay_recording(&day->recording, &options, &result);
+        host_set_storage(NULL);
+
+        tune_result_t* tuned = (tune_result_t*)output;
+        *tuned = {};
+        tuned->reports = result.reports;
+        std::vector<int64_t> entered = event_times(&result, CROSSING_ENTERED);
+        std::vector<int64_t> exited = event_times(&result, CROSSING_EXITED);
+        const accuracy_day_t* reference = day->reference;
+        if(directional)
+        {
+            accuracy_t accuracy;
+            accuracy_match(entered, accuracy_span(reference->entered, result.first_time, result.last_time, window), window, &accuracy);
+            accuracy_add(&tuned->accuracy, &accuracy);
+            accuracy_match(exited, accuracy_span(reference->exited, result.first_time, result.last_time, window), window, &accuracy);
+            accuracy_add(&tuned->accuracy, &accuracy);
+        }
+        else
+        {
+            std::vector<int64_t> detected;
+            std::merge(entered.begin(), entered.end(), exited.begin(), exited.end(), std::back_inserter(detected));
+            accuracy_match(detected, accuracy_span(reference->reference, result.first_time, result.last_time, window),
+                window, &tuned->accuracy);
+        }
+    };
+    bool interactive = isatty(STDERR_FILENO);
+    auto progress = [&](size_t done, size_t total){
+        if(interactive) fprintf(stderr, "\r%zu/%zu replays", done, total);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    bool completed = pool.run(count, sizeof(tune_result_t), results.data(), work, progress);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(interactive) fprintf(stderr, "\n");
+    if(!completed)
+    {
+        fprintf(stderr, "%s: a worker failed, the ranking would be incomplete\n", argv[0]);
+        return 1;
+    }
+    fprintf(stderr, "%zu replays in %.1f s, %.0f reports/s\n", count, elapsed, elapsed > 0 ? reports * configs.size() / elapsed : 0);
+
+    std::vector<tune_score_t> scores(configs.size());
+    for(size_t c=0; c<configs.size(); c++)
+    {
+        tune_score_t* score = &scores[c];
+        *score = {};
+        score->config = c;
+        for(size_t d=0; d<days.size(); d++) accuracy_add(&score->accuracy, &results[c * days.size() + d].accuracy);
+        double precision = score->accuracy.precision, recall = score->accuracy.recall;
+        score->f1 = (precision + recall > 0) ? 2 * precision * recall / (precision + recall) : 0;
+    }
+    std::sort(scores.begin(), scores.end(), [](const tune_score_t& a, const tune_score_t& b){
+        if(a.f1 != b.f1) return a.f1 > b.f1;
+        if(a.accuracy.net_error != b.accuracy.net_error) return a.accuracy.net_error < b.accuracy.net_error;
+        return a.config < b.config;
+    });
+
+    for(size_t rank=0; rank<scores.size(); rank++)
+    {
+        const tune_score_t* score = &scores[rank];
+        bool is_default = (score->config == 0);
+        if((int)rank >= top && !is_default) continue;
+        fprintf(stderr, "%4zu  ", rank + 1);
+        print_score(stderr, score);
+        fprintf(stderr, "\n      ");
+        print_config(stderr, &configs[score->config]);
+        fprintf(stderr, "%s\n", is_default ? "  (firmware defaults)" : "");
+    }
+
+    const tune_config_t* best = &configs[scores[0].config];
+    point_t area[6];
+    config_area(best, area);
+    const char* names[6] = {"D0", "D1", "D2", "D3", "S0", "S1"};
+    printf("{");
+    for(int i=0; i<6; i++) printf("\"%s\": {\"x\": %.3f,\"y\": %.3f},", names[i], area[i].x, area[i].y);
+    printf("\"ghost_timer\": %lld,\"threshold_distance\": %.3f,\"enter_exit_inverted\": %s}\n",
+        llround(best->value[TUNE_GHOST_TIMER] * 1e6), best->value[TUNE_THRESHOLD], best->inverted ? "true" : "false");
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+Tracker Benchmark
+-----------------
+Runs the Tracker over synthetic reports of MAX_TARGETS_DETECTION people
+walking across each other while the slots are sorted like the LD2461 does,
+and reports the time per report (worst and average) and how many times a
+person changed track.
+
+Usage: tracker_bench [--reports N] [--period US]
+*/
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "tracker.hpp"
+
+typedef struct person{
+    float x, y;     // Decimeters
+    float vx, vy;   // Decimeters per second
+}person_t;
+
+int main(int argc, char** argv)
+{
+    size_t reports = 1000000;
+    int64_t period = 100000; // 10 reports per second
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--reports") == 0 && i+1 < argc) reports = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--period") == 0 && i+1 < argc) period = strtoll(argv[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "Usage: %s [--reports N] [--period US]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // People bounce inside a 4 x 4 meters room, their paths keep crossing
+    person_t people[MAX_TARGETS_DETECTION];
+    srand(2461);
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        people[i] = {
+            (float)(rand() % 40 - 20), (float)(rand() % 40 + 5),
+            (float)(rand() % 24 - 12), (float)(rand() % 24 - 12)
+        };
+    }
+
+    Tracker* tracker = new Tracker();
+    uint16_t person_track[MAX_TARGETS_DETECTION] = {};
+    size_t id_switches = 0;
+    double worst = 0, total = 0;
+
+    for(size_t r=0; r<reports; r++)
+    {
+        ld2461_detection_t report = {};
+        report.timestamp = (int64_t)r * period;
+
+        // The radar reports the people in its own order, here by x
+        int order[MAX_TARGETS_DETECTION];
+        for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+        {
+            person_t* p = &people[i];
+            p->x += p->vx * period / 1e6f;
+            p->y += p->vy * period / 1e6f;
+            if(p->x < -20 || p->x > 20) p->vx = -p->vx;
+            if(p->y < 5 || p->y > 45) p->vy = -p->vy;
+            order[i] = i;
+        }
+        std::sort(order, order + MAX_TARGETS_DETECTION, [&](int a, int b){return people[a].x < people[b].x;});
+        for(int slot=0; slot<MAX_TARGETS_DETECTION; slot++)
+        {
+            report.target[slot] = {(int8_t)lroundf(people[order[slot]].x), (int8_t)lroundf(people[order[slot]].y)};
+            if(report.target[slot].x == 0 && report.target[slot].y == 0) report.target[slot].y = 1;
+            report.is_target_available[slot] = LD2461_TARGET_AVAILABLE;
+        }
+        report.detected_targets = MAX_TARGETS_DETECTION;
+        ld2461_detection_t sent = report;
+
+        auto start = std::chrono::steady_clock::now();
+        tracker->update(&report);
+        auto end = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double, std::micro>(end - start).count();
+        total += elapsed;
+        if(elapsed > worst) worst = elapsed;
+
+        // Follow every person to the track that got its position
+        for(int slot=0; slot<MAX_TARGETS_DETECTION; slot++)
+        {
+            if(report.track_id[slot] == 0) continue;
+            for(int s=0; s<MAX_TARGETS_DETECTION; s++)
+            {
+                if(sent.target[s].x != report.target[slot].x || sent.target[s].y != report.target[slot].y) continue;
+                int person = order[s];
+                if(person_track[person] != 0 && person_track[person] != report.track_id[slot]) id_switches++;
+                person_track[person] = report.track_id[slot];
+                break;
+            }
+        }
+    }
+
+    printf("Reports: %zu with %d targets, period %lld us\n", reports, MAX_TARGETS_DETECTION, (long long)period);
+    printf("Update: %.3f us average | %.3f us worst\n", total / reports, worst);
+    printf("Tracks created: %u | slot swaps followed: %u | identity switches: %zu\n",
+        tracker->get_created(), tracker->get_swaps(), id_switches);
+
+    delete tracker;
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+Clock
+-----
+Where the firmware reads the time: the esp_timer time the reports, timeouts
+and latencies are measured in, and the wall clock of the event timestamps and
+of the scheduled occupancy reset. Everything reads it from the global
+system_clock, an EspClock on the ESP32.
+
+The host build (sete003/host) puts a SimulatedClock there, moved to the
+arrival time of every frame. The ghost filter, tracker and detection only
+see the report timestamps and this clock, so a replay gives the same result
+as fast as the host goes.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+class Clock{
+public:
+    virtual ~Clock() {}
+
+    /**
+     * @brief Monotonic time since boot (us), the esp_timer time
+     */
+    virtual int64_t now() = 0;
+
+    /**
+     * @brief Wall clock (us since the epoch, UTC), before 2020 if SNTP did not set it
+     */
+    virtual int64_t utc() = 0;
+
+    /**
+     * @brief Wait for a duration (us)
+     */
+    virtual void sleep(int64_t duration) = 0;
+};
+
+/**
+ * @brief esp_timer, the system time set by SNTP and vTaskDelay()
+ */
+class EspClock : public Clock{
+public:
+    int64_t now() override;
+    int64_t utc() override;
+    void sleep(int64_t duration) override;
+};
+
+/**
+ * @brief Clock moved by its owner (frame timestamps, a replay), sleep() moves it instantly
+ */
+class SimulatedClock : public Clock{
+private:
+    int64_t time;
+    int64_t epoch;      // UTC at time 0
+public:
+    /**
+     * @param epoch UTC (us since the epoch) at boot, 0 for a clock never set by SNTP
+     */
+    SimulatedClock(int64_t epoch = 0);
+    int64_t now() override;
+    int64_t utc() override;
+    void sleep(int64_t duration) override;
+
+    /**
+     * @brief Move the clock to a time, never backwards
+     */
+    void set(int64_t time);
+};
+
+extern Clock* system_clock;
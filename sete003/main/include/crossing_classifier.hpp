@@ -0,0 +1,171 @@
+/*
+Crossing Classifier
+-------------------
+A target that traversed the detection area is classified by the side it
+entered, the side it exited, whether its first point is trusted and whether
+entrance/exit is inverted. Every combination is one entry of a table giving
+the event to count and a reason code (the "id" printed in the logs):
+
+    rule = table.rule[crossing_rule_index(entered, exited, trusted, inverted)];
+
+The default table is built at compile time from the rules the firmware always
+used, the live one can be replaced over MQTT and is kept in NVS.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum detection_area_side{
+    LEFT,
+    BOTTOM,
+    RIGHT,
+    TOP,
+    NONE
+}detection_area_side_t;
+
+#define CROSSING_SIDES 5            // detection_area_side_t values, NONE included
+#define CROSSING_RULES (CROSSING_SIDES * CROSSING_SIDES * 2 * 2)
+#define CROSSING_EVENT_QUEUE_SIZE 32
+
+enum crossing_event_type : uint8_t
+{
+    CROSSING_NONE = 0,          // Nothing is counted
+    CROSSING_ENTERED = 1,
+    CROSSING_EXITED = 2,
+    CROSSING_GAVE_UP = 3,
+    CROSSING_UNDEFINED = 4,     // Traversed but the sides do not tell what happened, only logged
+    CROSSING_EVENT_TYPES
+};
+
+typedef struct crossing_rule{
+    uint8_t event;      // crossing_event_type
+    uint8_t reason;     // Reason code
+}crossing_rule_t;
+
+typedef struct crossing_table{
+    crossing_rule_t rule[CROSSING_RULES];
+}crossing_table_t;
+
+/**
+ * @brief Classified traversal, queued by the detection and logged later
+ */
+typedef struct crossing_event{
+    int64_t time;               // Arrival time of the report where the target exited (esp_timer, us)
+    uint16_t track_id;
+    uint8_t zone;
+    uint8_t entered_side;
+    uint8_t exited_side;
+    uint8_t trusted;
+    uint8_t inverted;
+    uint8_t line;               // Counted by the counting line instead of the sides, entered is where the line was crossed
+    uint16_t speed;             // Speed across the counting line (cm/s)
+    crossing_rule_t rule;
+    float previous[2];          // Position before entering (x, y)
+    float entered[2];           // Entry position (x, y)
+    float exited[2];            // Exit position (x, y)
+}crossing_event_t;
+
+inline constexpr const char* crossing_side_str[CROSSING_SIDES] = {"LEFT", "BOTTOM", "RIGHT", "TOP", "NONE"};
+inline constexpr const char* crossing_event_str[CROSSING_EVENT_TYPES] = {"none", "entered", "exited", "gave_up", "undefined"};
+
+constexpr size_t crossing_rule_index(uint8_t entered, uint8_t exited, uint8_t trusted, uint8_t inverted)
+{
+    return (((((size_t)entered * CROSSING_SIDES) + exited) * 2 + (trusted ? 1 : 0)) * 2) + (inverted ? 1 : 0);
+}
+
+/**
+ * @brief Swap entered and exited, what the same crossing means when entrance/exit is inverted
+ */
+constexpr uint8_t crossing_invert(uint8_t event)
+{
+    return (event == CROSSING_ENTERED) ? (uint8_t)CROSSING_EXITED : (event == CROSSING_EXITED) ? (uint8_t)CROSSING_ENTERED : event;
+}
+
+/**
+ * @brief Check every rule of a table is a known event, a stored table may come from another firmware
+ */
+constexpr bool crossing_table_valid(const crossing_table_t& table)
+{
+    for(size_t i=0; i<CROSSING_RULES; i++)
+    {
+        if(table.rule[i].event >= CROSSING_EVENT_TYPES) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Rules used before the table could be changed
+ */
+constexpr crossing_table_t crossing_default_table()
+{
+    crossing_table_t table = {};
+    auto set = [&table](uint8_t entered, uint8_t exited, uint8_t trusted, uint8_t event, uint8_t reason, uint8_t inverted_reason)
+    {
+        table.rule[crossing_rule_index(entered, exited, trusted, 0)] = {event, reason};
+        table.rule[crossing_rule_index(entered, exited, trusted, 1)] = {crossing_invert(event), inverted_reason};
+    };
+
+    // Untrusted first point, the entry side is not known and only the exit side counts
+    for(uint8_t entered=0; entered<CROSSING_SIDES; entered++)
+    {
+        set(entered, TOP, 0, CROSSING_EXITED, 0, 0);
+        set(entered, LEFT, 0, CROSSING_UNDEFINED, 10, 10);
+        set(entered, RIGHT, 0, CROSSING_UNDEFINED, 11, 11);
+        set(entered, BOTTOM, 0, CROSSING_ENTERED, 20, 21);
+        set(entered, NONE, 0, CROSSING_UNDEFINED, 30, 30);
+    }
+
+    set(TOP, BOTTOM, 1, CROSSING_ENTERED, 0, 0);
+    set(TOP, TOP, 1, CROSSING_GAVE_UP, 1, 1);
+    set(TOP, LEFT, 1, CROSSING_EXITED, 2, 2);
+    set(TOP, RIGHT, 1, CROSSING_ENTERED, 3, 3);
+    set(TOP, NONE, 1, CROSSING_UNDEFINED, 4, 4);
+
+    set(BOTTOM, TOP, 1, CROSSING_EXITED, 10, 10);
+    set(BOTTOM, BOTTOM, 1, CROSSING_GAVE_UP, 11, 11);
+    set(BOTTOM, LEFT, 1, CROSSING_GAVE_UP, 12, 12);
+    set(BOTTOM, RIGHT, 1, CROSSING_GAVE_UP, 12, 12);
+    set(BOTTOM, NONE, 1, CROSSING_UNDEFINED, 12, 12);
+
+    set(LEFT, BOTTOM, 1, CROSSING_ENTERED, 20, 20);
+    set(LEFT, TOP, 1, CROSSING_ENTERED, 21, 21);
+    set(LEFT, LEFT, 1, CROSSING_GAVE_UP, 22, 22);
+    set(LEFT, RIGHT, 1, CROSSING_GAVE_UP, 22, 22);
+    set(LEFT, NONE, 1, CROSSING_UNDEFINED, 22, 22);
+
+    set(RIGHT, TOP, 1, CROSSING_EXITED, 30, 30);
+    set(RIGHT, BOTTOM, 1, CROSSING_GAVE_UP, 31, 31);
+    set(RIGHT, RIGHT, 1, CROSSING_GAVE_UP, 32, 32);
+    set(RIGHT, LEFT, 1, CROSSING_GAVE_UP, 32, 32);
+    set(RIGHT, NONE, 1, CROSSING_UNDEFINED, 32, 32);
+
+    for(uint8_t exited=0; exited<CROSSING_SIDES; exited++)
+    {
+        set(NONE, exited, 1, CROSSING_UNDEFINED, 40, 40);
+    }
+    return table;
+}
+
+inline constexpr crossing_table_t CROSSING_DEFAULT_TABLE = crossing_default_table();
+
+static_assert(crossing_table_valid(CROSSING_DEFAULT_TABLE), "Default crossing table");
+static_assert(CROSSING_DEFAULT_TABLE.rule[crossing_rule_index(TOP, BOTTOM, 1, 0)].event == CROSSING_ENTERED, "Default crossing table");
+static_assert(CROSSING_DEFAULT_TABLE.rule[crossing_rule_index(TOP, BOTTOM, 1, 1)].event == CROSSING_EXITED, "Default crossing table");
+
+/**
+ * @brief Value of a name in a list of names
+ *
+ * @return int Index of the name, -1 if it is not in the list
+ */
+inline int crossing_index_of(const char* name, const char* const* names, size_t count)
+{
+    if(name == NULL) return -1;
+    for(size_t i=0; i<count; i++)
+    {
+        if(strcmp(name, names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
@@ -18,10 +18,20 @@ D1-------------------Top-----------------D2    D1--------D2
 
 #pragma once
 
+#include "esp_timer.h"
+
+#include "crossing_classifier.hpp"
 #include "ld2461.hpp"
 #include "mqtt.hpp"
 #include "sensor.hpp"
 
+#define RADAR_ZONE_MARGIN_METERS 1.0    // Zone filter margin around the detection area, targets must be seen before entering
+
+// Every radar owns MAX_TARGETS_DETECTION slots of the world target list, radar N starts at slot N * MAX_TARGETS_DETECTION
+#define MAX_WORLD_TARGETS (MAX_TARGETS_DETECTION * MAX_RADARS)
+#define RADAR_DEDUP_DISTANCE_DECIMETERS 4    // Targets closer than this seen by two radars are the same person
+#define RADAR_DEDUP_MAX_AGE 500000      // Microseconds a position of another radar is still used for the de-duplication
+
 typedef struct point{
     float x;
     float y;
@@ -29,108 +39,410 @@ typedef struct point{
 
 typedef point vec2_t;
 
-typedef struct detection_area{
-    /*
-    D0: Top left corner
-    D1: Bottom left corner
-    D2: Bottom right corner
-    D3: Top right corner
-
-    F0: D0-D1
-    F1: D1-D2
-    F2: D2-D3
-    F3: D3-D0
-
-    F_D0: distance(D0-D1)
-    F_D1: distance(D1-D2)
-    F_D2: distance(D2-D3)
-    F_D3: distance(D3-D0)
-
-    L: S0-S1
-    L_D: sqrt((S0.x - S1.x)^2 + (S0.y - S1.y)^2)
-    */
-    point_t D[4];                   // Points of the detection area
-    point_t S[2];                   // Points of the detection segment
-    vec2_t F[4];                    // Segment of detection area faces
-    float F_D[4];                   // Length of the detection area faces
-    vec2_t L;                       // Segment of the detection area
-    float L_D;                      // Length of the detection line
-    uint8_t portrait_landscape;     // 0: Portrait, 1: Landscape
-}detection_area_t;
-
-typedef enum detection_area_side{
-    LEFT,
-    BOTTOM,
-    RIGHT,
-    TOP,
-    NONE
-}detection_area_side_t;
+/**
+ * @brief Point in decimeters, the unit the LD2461 reports in
+ * @note The counting runs on these, meters only exist in the configuration and in what is reported
+ */
+typedef struct dm_point{
+    int16_t x;
+    int16_t y;
+}dm_point_t;
+
+/*
+Detection Zones
+---------------
+Any number of vertices, in order, the last one connects back to the first (the
+polygon may be concave, L shaped entrances work). Each edge is labeled with the
+side it counts as for the crossing classifier, edges labeled NONE are walls and
+a traversal through them is not counted. Every zone has its own counting line
+and counters.
+
+The legacy detection area is a zone with the 4 vertices D0, D1, D2, D3 and the
+edges LEFT (D0-D1), TOP (D1-D2), RIGHT (D2-D3) and BOTTOM (D3-D0).
+*/
+#define MAX_ZONES 4
+#define ZONE_MAX_VERTICES 8
+
+typedef struct zone_config{
+    uint8_t vertex_count;
+    point_t vertex[ZONE_MAX_VERTICES];
+    uint8_t edge_side[ZONE_MAX_VERTICES];   // detection_area_side_t of the edge vertex[i] -> vertex[i + 1]
+    point_t line[2];                        // Counting line (S0, S1)
+}zone_config_t;
+
+typedef struct zone_edge{
+    dm_point_t origin;      // vertex[i]
+    dm_point_t delta;       // vertex[i + 1] - vertex[i]
+    int32_t length_sq;      // delta . delta
+}zone_edge_t;
+
+/*
+Zone Lookup Tables
+------------------
+World positions are int8 decimeters, so a zone can be rasterised once: every
+cell of its bounding box (plus ZONE_LUT_MARGIN_DECIMETERS) keeps whether it
+is inside the zone and the side of the nearest edge. Membership and the
+crossed side are then one load per target. Tables live in internal RAM and
+are only rebuilt for the zones that changed; a zone whose table does not fit
+in ZONE_LUT_BUDGET_BYTES, or a point out of its table, uses the exact geometry.
+*/
+#ifndef ZONE_LUT_BUDGET_BYTES
+#define ZONE_LUT_BUDGET_BYTES 32768     // Internal RAM shared by the tables of every zone
+#endif
+#define ZONE_LUT_MARGIN_DECIMETERS 10   // Exits are classified just outside the zone, same margin as the radar zone filter
+
+#define ZONE_LUT_INSIDE 0x08            // Cell flag, the side is in the low 3 bits
+
+typedef struct zone_lut{
+    uint8_t* cells;         // Two cells per byte (even cell in the low nibble), NULL if the zone has no table
+    int16_t min_x;          // World position of the first cell
+    int16_t min_y;
+    uint16_t width;         // Cells
+    uint16_t height;
+}zone_lut_t;
+
+typedef struct detection_zone{
+    zone_config_t config;
+    zone_edge_t edge[ZONE_MAX_VERTICES];    // In decimeters, precomputed when the zone is set
+    dm_point_t line_origin;                 // S0
+    dm_point_t line_delta;                  // S1 - S0, 0 if the line has no length
+    int32_t line_length;                    // |line_delta|, rounded
+    zone_lut_t lut;
+}detection_zone_t;
+
+/*
+Counting Modes
+--------------
+AREA: a target is classified by the sides it entered and exited the zone
+through (crossing table).
+LINE: a target is counted when the movement between two of its reports
+crosses the counting line S0 -> S1, so a fast walker that jumps over the
+whole zone between two reports is still counted. Moving from the right of
+S0 -> S1 to its left (away from the radar for a line drawn left to right)
+is an entrance. The crossing point and time are interpolated on the
+movement. Positions are whole decimeters and people stop on the line, so
+a target within COUNTING_LINE_DEAD_BAND of it keeps the side it came from:
+a crossing is counted when the side it was last seen off the band flips,
+from that position to the first one off the band on the other side.
+*/
+typedef enum counting_mode{
+    COUNTING_AREA,
+    COUNTING_LINE
+}counting_mode_t;
+
+#define COUNTING_LINE_ENTERED_REASON 50 // Reason codes of the line crossings, next to the crossing table ones
+#define COUNTING_LINE_EXITED_REASON 51
+#define COUNTING_LINE_DEAD_BAND 1       // Decimeters each side of the counting line that belong to no side
+
+/*
+Kinematics
+----------
+Every target keeps its last TRAJECTORY_LENGTH positions and its velocity is
+the least squares fit of them (cm/s, smoothed over about a second at 10
+reports per second). When a minimum crossing speed is set, a crossing only
+counts if the target moves across the counting line of the zone (along its
+normal) at least that fast, so static clutter jittering over an edge is not
+counted. The speed of the counted crossings is aggregated in a histogram of
+SPEED_HISTOGRAM_BINS bins of SPEED_HISTOGRAM_BIN_WIDTH, published with the
+counters.
+*/
+#define TRAJECTORY_LENGTH 8
+#define SPEED_HISTOGRAM_BINS 8
+#define SPEED_HISTOGRAM_BIN_WIDTH 25    // cm/s, the last bin has every faster crossing
 
 typedef struct target{
-    point_t current_position;                   // Current position of the target
-    point_t previous_position;                  // Previous position of the target
-    float previous_distance;                    // Distance from the previous position to the detection line
-    bool line_side;                             // Side of the detection line where the target is
-    point_t entered_position;                   // Position where the target entered the detection area
-    point_t exited_position;                    // Position where the target exited the detection area
-    point_t detection_segment_crossed_position; // Position where the target crossed the detection segment
+    dm_point_t current_position;                // Current position of the target
+    int64_t timestamp;                          // Arrival time of the report with the current position (esp_timer, us)
+    int64_t previous_timestamp;                 // Arrival time of the report with the previous position
+    uint16_t track_id;                          // Track in this slot (0 for none), the history is dropped when it changes
+    dm_point_t trajectory[TRAJECTORY_LENGTH];   // Last positions, a ring
+    int64_t trajectory_time[TRAJECTORY_LENGTH];
+    uint8_t trajectory_head;                    // Next position to write
+    uint8_t trajectory_count;
+    int16_t velocity_x;                         // cm/s, 0 until there are two positions
+    int16_t velocity_y;
+}target_t;
+
+/**
+ * @brief History of a target slot in one zone
+ */
+typedef struct zone_target{
+    dm_point_t previous_position;               // Previous position of the target
+    int32_t previous_distance;                  // Distance from the previous position to the detection line, times the line length
+    int8_t line_side;                           // Side of the detection line where the target is (1 left, -1 right, 0 on it)
+    dm_point_t off_line_position;               // LINE mode: last position off the dead band of the counting line
+    int64_t off_line_time;                      // LINE mode: arrival time of the report with that position
+    int8_t off_line_side;                       // LINE mode: side of that position, 0 until the target left the dead band
+    dm_point_t entered_position;                // Position where the target entered the detection area
+    dm_point_t exited_position;                 // Position where the target exited the detection area
+    dm_point_t detection_segment_crossed_position; // Position where the target crossed the detection segment
     detection_area_side_t entered_side;         // Side where the target entered the detection area
     detection_area_side_t exited_side;          // Side where the target exited the detection area
     bool traversed;                             // Flag to indicate if the target traversed the detection area
     bool timeout;                               // Flag to indicate if the target timed out
     uint8_t trusted_vector;                     // 0: First point is not trusted, 1: First point is trusted
-}target_t;
+    int64_t entered_time;                       // Arrival time of the report where the target entered the detection area
+    int64_t exited_time;                        // Arrival time of the report where the target exited the detection area
+}zone_target_t;
+
+/*
+Occupancy
+---------
+Entrances and exits of every zone move a single room occupancy, clamped to
+0..max. It goes back to 0 at reset_minute (local time, e.g. when the store
+closes) and when the room looked empty for empty_timeout seconds: no target
+in front of any radar and no PIR motion (drift correction, people that left
+without being counted). It is published retained on <root>/occupancy when it
+changes (at most every OCCUPANCY_PUBLISH_INTERVAL) and every
+OCCUPANCY_REFRESH_INTERVAL, so a dashboard reads the current value directly.
+*/
+#define OCCUPANCY_PUBLISH_INTERVAL 5000000      // Microseconds
+#define OCCUPANCY_REFRESH_INTERVAL 300000000    // Microseconds
+
+typedef struct occupancy_config{
+    uint16_t max;               // 0 for no limit
+    int16_t reset_minute;       // Minute of the day, -1 for no scheduled reset
+    uint32_t empty_timeout;     // Seconds, 0 to disable the drift correction
+}occupancy_config_t;
+
+/*
+Event Stream
+------------
+Every counted crossing is kept in a ring of EVENT_BUFFER_SIZE entries (the
+oldest is overwritten when full) and flushed to <root>/events every payload
+period, EVENT_BATCH_SIZE per message. Times are UTC microseconds from the
+cached esp_timer to UTC mapping of the Sensor, 0 if SNTP never set the clock.
+*/
+#define EVENT_BUFFER_SIZE 64
+#define EVENT_BATCH_SIZE 16
+
+/*
+Detection Task
+--------------
+The counting runs on its own task, woken by task notifications: the RX tasks
+set DETECTION_EVENT_REPORT when they queue a report, so it is counted as soon
+as it arrives, and esp_timers set DETECTION_EVENT_TICK (occupancy) and
+DETECTION_EVENT_PUBLISH (counters and events, every payload period). All the
+counting state is only touched by this task. The time from the arrival of a
+report to the end of its counting is checked against DETECTION_DEADLINE.
+
+The server commands run on the MQTT task: the setters only write the
+detection_settings_t (under settings_lock, the getters read it) and set
+DETECTION_EVENT_SETTINGS, the task applies the changes before the next report
+(lookup tables, target history, counters). Before start_task() they are
+applied at once.
+*/
+#define DETECTION_TASK_STACK 8192
+#define DETECTION_TASK_PRIORITY 9           // Below the RX tasks, they must never wait for the counting
+#define DETECTION_TASK_CORE 1
+#define DETECTION_DEADLINE 50000            // Microseconds, half of the report period
+#define DETECTION_TICK_PERIOD 1000000       // Microseconds
+
+#define DETECTION_EVENT_REPORT (1 << 0)
+#define DETECTION_EVENT_TICK (1 << 1)
+#define DETECTION_EVENT_PUBLISH (1 << 2)
+#define DETECTION_EVENT_SETTINGS (1 << 3)
+
+// detection_settings_t fields changed since the task applied them
+#define DETECTION_SETTING_ZONES (1 << 0)
+#define DETECTION_SETTING_COUNTING_MODE (1 << 1)
+#define DETECTION_SETTING_ENTER_EXIT_INVERTED (1 << 2)
+#define DETECTION_SETTING_MIN_CROSSING_SPEED (1 << 3)
+#define DETECTION_SETTING_CROSSING_TABLE (1 << 4)
+#define DETECTION_SETTING_OCCUPANCY_CONFIG (1 << 5)
+#define DETECTION_SETTING_OCCUPANCY (1 << 6)
+#define DETECTION_SETTING_ALL 0x7F
+
+typedef struct detection_settings{
+    uint8_t zone_count;
+    zone_config_t zones[MAX_ZONES];
+    counting_mode_t counting_mode;
+    bool enter_exit_inverted;
+    uint16_t min_crossing_speed;
+    crossing_table_t crossing_table;
+    occupancy_config_t occupancy_config;
+    int32_t occupancy;                  // Set by hand, only applied with DETECTION_SETTING_OCCUPANCY
+}detection_settings_t;
+
+typedef struct detection_latency{
+    uint32_t reports;           // Reports counted
+    uint32_t deadline_misses;   // Reports counted later than DETECTION_DEADLINE after they arrived
+    int64_t last;               // Microseconds from arrival to counted
+    int64_t max;
+}detection_latency_t;
 
 typedef struct payload_buffer{
-    std::string timestamp;
-    point_t entered_position;
+    int64_t timestamp;                  // UTC (us)
+    uint16_t track_id;
+    uint8_t zone;
+    uint8_t event;                      // crossing_event_type
+    uint8_t entered_side;               // detection_area_side_t (NONE for line crossings)
+    uint8_t exited_side;
+    point_t entered_position;           // Crossing point of the line crossings
     point_t exited_position;
-    detection_area_side_t entered_side;
-    detection_area_side_t exited_side;
 }payload_buffer_t;
 
 class Detection{
 private:
-    detection_area_t detection_area;
-    point_t targets_previous[MAX_TARGETS_DETECTION];
-    target_t targets[MAX_TARGETS_DETECTION];
+    detection_zone_t zones[MAX_ZONES];
+    uint8_t zone_count;
+    size_t lut_bytes;                       // Used by the zone lookup tables
+    dm_point_t targets_previous[MAX_WORLD_TARGETS];
+    target_t targets[MAX_WORLD_TARGETS];
+    zone_target_t zone_targets[MAX_ZONES][MAX_WORLD_TARGETS];
 
-    int entered_detections;
-    int exited_detections;
-    int gave_up_detections;
+    int event_counters[MAX_ZONES][CROSSING_EVENT_TYPES];  // Indexed by crossing_event_type, reset when published
+
+    payload_buffer_t event_buffer[EVENT_BUFFER_SIZE];        // Events waiting to be published, a ring
+    uint16_t event_buffer_head;                             // Oldest event
+    uint16_t event_buffer_count;
+    uint32_t event_buffer_dropped;                          // Overwritten before they were published, reset when published
+
+    int32_t occupancy;
+    occupancy_config_t occupancy_config;
+    int64_t last_presence_time;             // Last time a target or PIR motion was seen (esp_timer, us)
+    int last_reset_day;                     // Day of the year of the last scheduled reset
+    int32_t published_occupancy;
+    int64_t last_occupancy_publish;
+    uint32_t occupancy_corrections;         // Times the drift correction emptied the room
+
+    crossing_table_t crossing_table;
+    SPSCQueue<crossing_event_t, CROSSING_EVENT_QUEUE_SIZE> crossing_events; // Classified traversals waiting to be logged
+
+    portMUX_TYPE settings_lock;             // The settings are changed by the MQTT task and applied by the detection task
+    detection_settings_t settings;
+    uint32_t settings_changed;              // DETECTION_SETTING_ bits
+
+    TaskHandle_t task_handle;
+    esp_timer_handle_t tick_timer;
+    esp_timer_handle_t publish_timer;
+    detection_latency_t latency;
 
     bool send_raw_detection_payload;
     bool enter_exit_inverted;
+    counting_mode_t counting_mode;
+
+    uint16_t min_crossing_speed;                        // cm/s across the counting line, 0 to count every crossing
+    uint32_t speed_histogram[SPEED_HISTOGRAM_BINS];     // Counted crossings by speed, reset when published
+    uint32_t slow_crossings;                            // Crossings not counted by the speed gate, reset when published
 
     /**
-     * @brief Vector product of the two vectors
-     * @note This vector product is altered to use the values pre-calculated 
-     * from the detection_area, so it is not necessary to calculate the vector again
-     * 
-     * @param vecAB_index Index of the vector AB in the detection_area
-     * @param pointA_index Index of point A from AB in the detection_area
-     * @param pointC Target point detected from the LD2461
-     * @return true If the target is on the left of the vector AB
-     * @return false If the target is not on the left of the vector AB
-     */
-    std::pair<bool, float> _pre_calc_vector_product_area(
-        uint8_t vecAB_index,
-        uint8_t pointA_index,
-        point_t pointC
-    );
+     * @brief Precompute the edges and the counting line of a zone
+     *
+     * @param config Zone as configured
+     * @param zone Where to store the zone
+     */
+    static void build_zone(const zone_config_t* config, detection_zone_t* zone);
+
+    /**
+     * @brief Set a zone, its lookup table is kept when the zone did not change
+     *
+     * @param index Zone to set
+     * @param config Zone as configured
+     */
+    void apply_zone(uint8_t index, const zone_config_t* config);
+
+    /**
+     * @brief Rasterise the lookup table of a zone, if it fits in the budget left
+     */
+    void build_lut(detection_zone_t* zone);
+    void free_lut(detection_zone_t* zone);
+
+    /**
+     * @brief Crossing number test on the zone edges, what the lookup table stores
+     */
+    static bool _is_target_in_polygon(const detection_zone_t* zone, dm_point_t point);
+
+    /**
+     * @brief Side of the edge segment closest to the point, what the lookup table stores
+     */
+    static detection_area_side_t _nearest_side(const detection_zone_t* zone, dm_point_t point);
 
     /**
-     * @brief Check if the target is inside the detection area
+     * @brief Check if the target is inside a zone (lookup table, crossing number out of it)
      * 
+     * @param zone Zone to check
      * @param target Target point detected from the LD2461
-     * @return true If the target is inside the detection area
-     * @return false If the target is not inside the detection area
+     * @return true If the target is inside the zone
+     * @return false If the target is not inside the zone
+     */
+    bool _is_target_in_zone(const detection_zone_t* zone, dm_point_t target);
+
+    /**
+     * @brief Side of the counting line where the point is, and its distance to the line times the line length
+     *
+     * @return 1 on the left of S0 -> S1, -1 on its right, 0 within COUNTING_LINE_DEAD_BAND of the line
+     */
+    std::pair<int8_t, int32_t> _line_side(const detection_zone_t* zone, dm_point_t point);
+
+    /**
+     * @brief Count the target if it moved to the other side of the counting line of a zone (LINE mode)
+     *
+     * @param zone Zone of the counting line
+     * @param target_index Target slot
+     * @return true If the line was crossed
+     */
+    bool check_line_crossing(uint8_t zone, int target_index);
+
+    /**
+     * @brief Flag changed settings, the detection task applies them (at once if it is not started)
+     *
+     * @param changed DETECTION_SETTING_ bits, the caller already wrote the settings
+     */
+    void settings_updated(uint32_t changed);
+
+    /**
+     * @brief Move the changed settings into the counting state, on the detection task
+     */
+    void apply_settings();
+
+    /**
+     * @brief Detection task entry point, runs task_loop() of the Detection passed as argument
+     */
+    static void task(void* arg);
+
+    /**
+     * @brief Wait for the notifications and run what they ask for
+     */
+    void task_loop();
+
+    /**
+     * @brief esp_timer callbacks, notify the task of the Detection passed as argument
+     */
+    static void tick_timer_callback(void* arg);
+    static void publish_timer_callback(void* arg);
+
+    /**
+     * @brief Least squares velocity of the target trajectory
      */
-    bool _is_target_in_detection_area(point_t target);
+    static void update_velocity(target_t* target);
+
+    /**
+     * @brief Speed of the target across the counting line of a zone (cm/s)
+     */
+    uint16_t crossing_speed(uint8_t zone, int target_index);
+
+    /**
+     * @brief Apply the speed gate to a classified crossing and count it in the histogram
+     *
+     * @param event Crossing with its rule and speed, the rule event becomes CROSSING_NONE if it is too slow
+     */
+    void gate_crossing_speed(crossing_event_t* event);
+
+    /**
+     * @brief Move the occupancy by a counted event
+     */
+    void count_occupancy(uint8_t event);
+
+    /**
+     * @brief Clear the history of a target slot in a zone
+     */
+    static void clear_zone_target(zone_target_t* target);
 
 public:
     /**
      * @brief Construct a new Detection object
+     * @note The zones saved in NVS replace the detection area given here
      * 
      * @param D0 Top left corner
      * @param D1 Bottom left corner
@@ -149,7 +461,13 @@ public:
     );
 
     /**
-     * @brief Set the detection area
+     * @brief Free the zone lookup tables
+     * @note The task and timers are not stopped, only the host build deletes a Detection
+     */
+    ~Detection();
+
+    /**
+     * @brief Set the detection area, a single 4 vertices zone
      * 
      * @param D0 Top left corner
      * @param D1 Bottom left corner
@@ -166,25 +484,175 @@ public:
     );
 
     /**
-     * @brief Get the detection area
+     * @brief Replace every zone (and save them)
+     * @note The history of the targets and the counters not published yet are dropped
+     *
+     * @param configs Zones
+     * @param count Number of zones (1 to MAX_ZONES)
+     * @return true If the zones were valid and applied
+     */
+    bool set_zones(const zone_config_t* configs, uint8_t count);
+
+    /**
+     * @brief Get the zones
+     *
+     * @param configs Where to copy the zones, MAX_ZONES of them
+     * @return uint8_t Number of zones
+     */
+    uint8_t get_zones(zone_config_t* configs);
+
+    /**
+     * @brief Bounding region of every zone as a LD2461 zone filter
      * 
-     * @return detection_area_t 
+     * @param margin Meters added around the detection area
+     * @param radar Radar the zone is for, the region is given in its coordinates
+     * @return ld2461_zone_filter_t Zone 0 with the region, zones 1 and 2 unused
      */
-    detection_area_t get_detection_area();
+    ld2461_zone_filter_t get_radar_zone(float margin, LD2461* radar);
 
-    point_t* get_detection_area_point();
+    /**
+     * @brief Program the zone filter of every LD2461 with the current detection area
+     * 
+     * @return true If all radars applied the zone
+     */
+    bool sync_radar_zone();
 
-    detection_area_side_t get_crossed_side(point_t point);
+    /**
+     * @brief Side of the zone edge closest to the point (lookup table, exact out of it)
+     */
+    detection_area_side_t get_crossed_side(uint8_t zone, dm_point_t point);
 
     void set_raw_data_sent(bool send_raw_data);
     void set_enter_exit_inverted(bool inverted);
 
-    std::pair<bool, float> _pre_calc_vector_product_segment(point_t pointC);
+    /**
+     * @brief Count by the zone sides or by the counting line (saved)
+     * @note The history of the targets is dropped
+     */
+    void set_counting_mode(counting_mode_t mode);
+    counting_mode_t get_counting_mode();
+
+    /**
+     * @brief Minimum speed across the counting line for a crossing to count (saved)
+     *
+     * @param speed cm/s, 0 to count every crossing
+     */
+    void set_min_crossing_speed(uint16_t speed);
+    uint16_t get_min_crossing_speed();
 
-    bool check_if_detected(uint8_t target_index);
+    bool check_if_detected(uint8_t zone, uint8_t target_index);
     void start_detection();
-    void update_targets(ld2461_detection_t* report);
-    void count_detections(int target_index);
+
+    /**
+     * @brief Start the detection task and its timers
+     * @note Every radar must be told to notify get_task() with DETECTION_EVENT_REPORT
+     *
+     * @param publish_period Microseconds between the counter publications
+     */
+    void start_task(int64_t publish_period);
+    TaskHandle_t get_task();
+
+    /**
+     * @brief Change the time between the counter publications
+     */
+    void set_publish_period(int64_t publish_period);
+
+    /**
+     * @brief Get the latency of the counting since boot
+     */
+    void get_latency(detection_latency_t* latency);
+
+    /**
+     * @brief Move the report positions into the radar target slots
+     * @note Slots follow the tracks of the radar, when the track of a slot changes the slot history is dropped
+     *
+     * @param report Report in world coordinates
+     * @param radar Radar that sent the report
+     */
+    void update_targets(ld2461_detection_t* report, uint8_t radar);
+
+    /**
+     * @brief Drop the targets of a report that a lower numbered radar is already tracking
+     *
+     * @param report Report in world coordinates
+     * @param radar Radar that sent the report
+     */
+    void remove_duplicated_targets(ld2461_detection_t* report, uint8_t radar);
+
+    /**
+     * @brief Classify a target that traversed the detection area and count it
+     * @note The event is only queued, log_events() writes the logs
+     *
+     * @param zone Zone the target traversed
+     * @param target_index Target slot
+     */
+    void count_detections(uint8_t zone, int target_index);
+
+    /**
+     * @brief Log the events counted since the last call and keep them for mqtt_send_events()
+     */
+    void log_events();
+
+    /**
+     * @brief Publish the buffered events in batches
+     */
+    void mqtt_send_events();
+
+    /**
+     * @brief Change one entry of the crossing table
+     * @note Not saved, call save_crossing_table() after the changes
+     */
+    void set_crossing_rule(
+        detection_area_side_t entered,
+        detection_area_side_t exited,
+        bool trusted,
+        bool inverted,
+        crossing_rule_t rule
+    );
+    crossing_rule_t get_crossing_rule(
+        detection_area_side_t entered,
+        detection_area_side_t exited,
+        bool trusted,
+        bool inverted
+    );
+
+    /**
+     * @brief Go back to the default crossing table (and save it)
+     */
+    void reset_crossing_table();
+    void save_crossing_table();
+
+    /**
+     * @brief Apply the scheduled reset and the drift correction, and publish the occupancy when due
+     *
+     * @param time_now esp_timer time (us)
+     */
+    void update_occupancy(int64_t time_now);
+
+    /**
+     * @brief Replace the occupancy configuration (saved)
+     */
+    void set_occupancy_config(occupancy_config_t config);
+    occupancy_config_t get_occupancy_config();
+
+    /**
+     * @brief Set the occupancy by hand (e.g. a recount), it is published on the next update
+     */
+    void set_occupancy(int32_t value);
+    int32_t get_occupancy();
+
+    /**
+     * @brief Process every report queued by the LD2461 RX tasks, merged in arrival order
+     */
     void detect();
+
+    /**
+     * @brief Run a single report through the counting
+     * @note The report is already ghost filtered and in world coordinates (done by the RX task)
+     *
+     * @param report Report received from the LD2461
+     * @param radar Radar that sent the report
+     */
+    void process_detection(ld2461_detection_t* report, uint8_t radar);
     void mqtt_send_detections();
 };
\ No newline at end of file
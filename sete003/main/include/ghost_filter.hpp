@@ -0,0 +1,66 @@
+/*
+Ghost Filter
+------------
+The LD2461 keeps reporting targets that stopped existing (reflections, people
+that left the area) at the exact same coordinate, and sometimes a target jumps
+across the room between two frames. Each radar owns one filter, since the
+history is per target slot of that radar.
+
+Times come from the report timestamps, nothing here uses ESP-IDF.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ld2461_protocol.hpp"
+
+enum ld2461_flags : uint8_t
+{
+    LD2461_FLAG_GHOST_TIMER = 0,
+    LD2461_FLAG_MAX_THRESHOLD_DISTANCE = 1
+};
+
+class GhostFilter{
+private:
+    ld2461_detection_t previous_detection;      // Last report, without the ghosts
+    int64_t timeout[MAX_TARGETS_DETECTION];     // Since when each target is standing still (0 if moving)
+
+    int64_t GHOST_TIMER_TIMEOUT = 4000000; // Microseconds
+    double MAX_THRESHOLD_DISTANCE_METERS = 2.5; // Meters
+
+    // Flags
+    uint8_t flag_ghost_timer = 1;
+    uint8_t flag_max_threshold_distance = 1;
+
+    uint32_t ghosts;        // Targets removed by the ghost timer
+    uint32_t teleports;     // Targets flagged by the threshold distance
+
+public:
+    GhostFilter();
+
+    /**
+     * @brief Forget the targets history
+     */
+    void reset();
+
+    /**
+     * @brief Flag the ghost and teleported targets of a report
+     * @note Ghosts are zeroed and flagged LD2461_TARGET_GHOST, teleported targets are flagged LD2461_TARGET_TELEPORTED
+     * 
+     * @param detection Report to filter, in the radar coordinates
+     */
+    void filter(ld2461_detection_t* detection);
+
+    void set_ghost_timer_timeout(int64_t timeout);
+    int64_t get_ghost_timer_timeout();
+
+    void set_max_threshold_distance(double distance);
+    double get_max_threshold_distance();
+
+    void set_flag(ld2461_flags flag, uint8_t value);
+    uint8_t get_flag(ld2461_flags flag);
+
+    uint32_t get_ghosts();
+    uint32_t get_teleports();
+};
@@ -11,53 +11,52 @@ FRAME HEADER - DATA LENGHT - COMMAND WORD - COMMAND VALUE - CHECKSUM - FRAME END
 #include <stdint.h>
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "ld2461_protocol.hpp"
+#include "ld2461_parser.hpp"
+#include "ghost_filter.hpp"
+#include "tracker.hpp"
+#include "spsc_queue.hpp"
 
-#define MAX_TARGETS_DETECTION 5
+#define LD2461_DETECTION_QUEUE_SIZE 16  // Reports waiting for the detection stage (power of two)
+#define LD2461_RESPONSE_QUEUE_SIZE 2    // Command responses waiting for the caller
+#define LD2461_RX_TIMEOUT_SYMBOLS 3     // Line idle time (in bytes) that raises UART_DATA after a frame
+#define LD2461_RX_TASK_STACK 4096
+#define LD2461_RX_TASK_PRIORITY 10
+#define LD2461_RX_TASK_CORE 1
 
-enum ld2461_flags : uint8_t
-{
-    LD2461_FLAG_GHOST_TIMER = 0,
-    LD2461_FLAG_MAX_THRESHOLD_DISTANCE = 1
-};
+#define MAX_RADARS 2                        // LD2461 instances, each on its own UART
 
-enum ld2461_available_target : uint8_t
-{
-    LD2461_TARGET_UNAVAILABLE = 0,
-    LD2461_TARGET_AVAILABLE = 1,
-    LD2461_TARGET_GHOST = 2,
-    LD2461_TARGET_TELEPORTED = 3
-};
+#define LD2461_PROBE_TIMEOUT_MS 300         // Time to wait for a valid frame when probing a baudrate
+#define LD2461_LINK_CHECK_MS 1000           // RX task wakes at least this often to check the link
+#define LD2461_LINK_LOST_TIMEOUT 3000000    // Microseconds without a valid frame before probing again
+#define LD2461_COMMAND_TIMEOUT_MS 500       // Time to wait for a command acknowledge
+#define LD2461_RESET_TIME_MS 1000           // Time the radar takes to boot after a reset
+#define LD2461_MAX_FAILED_RESYNCS 5         // Consecutive failed resynchronisations before rebooting the ESP
 
-enum ld2461_baudrate_t
+typedef struct ld2461_link_stats
 {
-    LD2461_BAUDRATE_9600 = 0x002580,
-    LD2461_BAUDRATE_19200 = 0x004B00,
-    LD2461_BAUDRATE_38400 = 0x009600,
-    LD2461_BAUDRATE_57600 = 0x00E100,
-    LD2461_BAUDRATE_115200 = 0x01C200,
-    LD2461_BAUDRATE_256000 = 0x03E800
-};
+    uint32_t frames;                // Valid frames received
+    uint32_t checksum_errors;       // Frames rejected by the checksum
+    uint32_t trailer_errors;        // Frames rejected by the frame end
+    uint32_t length_errors;         // Frames rejected by an impossible data length
+    uint32_t discarded_bytes;       // Bytes skipped while hunting for a header
+    uint32_t fifo_overflows;        // UART_FIFO_OVF events
+    uint32_t buffer_full;           // UART_BUFFER_FULL events
+    uint32_t resyncs;               // Successful resynchronisations
+    uint32_t failed_resyncs;        // Resynchronisations that did not bring the link back
+    int64_t last_resync_duration;   // Microseconds
+    int64_t max_resync_duration;    // Microseconds
+}ld2461_link_stats_t;
 
-enum ld2461_command_word_t : uint8_t
+typedef struct ld2461_mount
 {
-    LD2461_COMMAND_NULL = 0x00,
-    LD2461_COMMAND_CHANGE_BAUDRATE = 0x01,
-    LD2461_COMMAND_SET_RADAR = 0x02,
-    LD2461_COMMAND_READ_RADAR = 0x03,
-    LD2461_COMMAND_ZONE_FILTERING = 0x04,
-    LD2461_COMMAND_WITHDRAW_AREAS = 0x05,
-    LD2461_COMMAND_READING_AREAS = 0x06,
-    LD2461_COMMAND_RADAR_REPORT_1 = 0x07,
-    LD2461_COMMAND_RADAR_REPORT_2 = 0x08,
-    LD2461_COMMAND_ID_AND_VERSION = 0x09,
-    LD2461_COMMAND_RESET = 0x0A,
-};
-
-enum ld2461_frame_guard_t : uint32_t
-{
-    LD2461_FRAME_HEADER = 0xFFEEDD,
-    LD2461_FRAME_END = 0xDDEEFF
-};
+    float rotation;     // Degrees, counter clockwise from the world X axis
+    float offset_x;     // Meters, radar position in the world
+    float offset_y;     // Meters, radar position in the world
+}ld2461_mount_t;
 
 typedef struct ld2461_version
 {
@@ -76,27 +75,6 @@ typedef struct ld2461
     uart_port_t uart_num;
 }ld2461_t;
 
-typedef struct ld2461_frame
-{
-    uint8_t data_length;                // 2 bytes
-    ld2461_command_word_t command_word; // 1 byte
-    uint8_t* command_value;             // N bytes
-    uint8_t checksum;                   // 1 byte
-}ld2461_frame_t;
-
-typedef struct ld2461_coordinate
-{
-    int8_t x;
-    int8_t y;
-}ld2461_coordinate_t;
-
-typedef struct ld2461_detection
-{
-    struct ld2461_coordinate target[MAX_TARGETS_DETECTION];
-    int8_t detected_targets; // Number of detected targets
-    int8_t is_target_available[MAX_TARGETS_DETECTION]; // ID of the detected targets (0 for not available, 1 for available)
-}ld2461_detection_t;
-
 /**
  * @brief Setup a frame with the default values
  * 
@@ -109,16 +87,112 @@ ld2461_frame_t ld2461_setup_frame();
  */
 void ld2461_setup_detection(ld2461_detection_t* detection);
 
-/**
- * @brief Free the memory allocated for the frame
- * 
- * @param frame Pointer to the frame
- */
-void free_ld2461_frame(ld2461_frame_t* frame);
-
 class LD2461{
 private:
     uart_port_t uart_num;
+    uint8_t index;                  // Radar number, 0 is the one used before multi-radar
+    char baud_key[16];              // NVS key of the negotiated baudrate
+    uint32_t baudrate;
+    LD2461Parser parser;
+    int64_t last_frame_time;        // esp_timer time of the last valid frame
+    ld2461_link_stats_t link_stats; // Parser counters are merged in get_link_stats()
+    uint8_t consecutive_failed_resyncs;
+
+    QueueHandle_t uart_queue;       // UART driver events
+    QueueHandle_t response_queue;   // Frames that are not reports, while the RX task is running
+    TaskHandle_t rx_task_handle;
+    SPSCQueue<ld2461_detection_t, LD2461_DETECTION_QUEUE_SIZE> detection_queue;
+    TaskHandle_t report_listener;   // Notified by the RX task when a report is queued
+    uint32_t report_listener_bits;
+
+    GhostFilter ghost_filter;       // Per radar, the history belongs to this radar target slots
+    Tracker tracker;                // Per radar, keeps a person in the same slot when the radar reorders them
+    ld2461_mount_t mount;
+    float mount_cos;
+    float mount_sin;
+    portMUX_TYPE mount_lock;        // The mount is changed by the MQTT task and read by the RX task
+
+    /**
+     * @brief Move the report targets from the radar coordinates to the world coordinates
+     *
+     * @param detection Report to transform
+     */
+    void apply_mount(ld2461_detection_t* detection);
+
+    /**
+     * @brief RX task entry point, runs rx_loop() of the LD2461 passed as argument
+     */
+    static void rx_task(void* arg);
+
+    /**
+     * @brief Block on the UART events and dispatch every frame as soon as it arrives
+     */
+    void rx_loop();
+
+    /**
+     * @brief Move every byte buffered by the UART driver into the parser
+     */
+    void drain_uart();
+
+    /**
+     * @brief Decode a RADAR_REPORT_1 frame
+     *
+     * @param frame Report frame
+     * @param detection Where to store the targets
+     * @param timestamp Arrival time of the frame
+     */
+    void frame_to_detection(ld2461_frame_t* frame, ld2461_detection_t* detection, int64_t timestamp);
+
+    /**
+     * @brief Estimate when the last byte of a frame arrived
+     * @note Bytes still waiting in the parser arrived after the frame, one byte takes 10 bits on the line
+     *
+     * @param rx_time Time the UART event was received
+     * @param idle_symbols Line idle time (in bytes) before the event was raised
+     * @return int64_t esp_timer time of the frame end
+     */
+    int64_t frame_arrival_time(int64_t rx_time, size_t idle_symbols);
+
+    /**
+     * @brief Read the next valid frame, giving up after the timeout
+     *
+     * @param frame Frame to store the data readed
+     * @param timeout Maximum time to wait
+     * @return true If a frame was read
+     */
+    bool read_frame(ld2461_frame_t* frame, TickType_t timeout);
+
+    /**
+     * @brief Check if the radar is talking at the given baudrate
+     * @note Changes the local UART baudrate
+     *
+     * @param baudrate Baudrate to try
+     * @return true If valid frames were received
+     */
+    bool probe_baudrate(uint32_t baudrate);
+
+    /**
+     * @brief Wait for a frame with the given Command Word
+     * @note Uses the RX task responses when it is running, reads the UART directly otherwise.
+     * Without a timeout a UART that stays silent is resynchronised
+     *
+     * @param command_word Command Word to wait for
+     * @param frame Frame to store the data readed
+     * @param timeout Maximum time to wait
+     * @return true If the frame arrived
+     * @return false If the timeout expired
+     */
+    bool wait_for_frame(ld2461_command_word_t command_word, ld2461_frame_t* frame, TickType_t timeout);
+
+    /**
+     * @brief Send a command frame, the Data Length and Checksum are filled here
+     *
+     * @param command_word Command Word
+     * @param command_value Command Value (may be NULL when length is 0)
+     * @param length Command Value length
+     */
+    void send_command(ld2461_command_word_t command_word, const uint8_t* command_value, uint16_t length);
+
     /**
      * @brief Generate the checksum for the frame
      * 
@@ -127,12 +201,6 @@ private:
      */
     uint8_t ld2461_generate_checksum(ld2461_frame_t* frame);
 
-    int64_t GHOST_TIMER_TIMEOUT = 4000000; // Microseconds
-    double MAX_THRESHOLD_DISTANCE_METERS = 2.5; // Meters
-
-    // Flags
-    uint8_t flag_ghost_timer = 1;
-    uint8_t flag_max_threshold_distance = 1;
 public:
     /**
      * @brief Construct a new LD2461 object
@@ -144,20 +212,71 @@ public:
      * @param tx_pin TX Pin GPIO Number
      * @param rx_pin RX Pin GPIO Number
      * @param baudrate Baudrate for the communication
+     * @param index Radar number, used for its NVS keys and task name
      */
     LD2461(
         uart_port_t uart_num,
         gpio_num_t tx_pin,
         gpio_num_t rx_pin,
-        int baudrate
+        int baudrate,
+        uint8_t index = 0
     );
 
     /**
-     * @brief Read data from the LD2461
+     * @brief Bring the link back without rebooting
+     * @note Flushes the UART and hunts for a header, if none shows up the radar is
+     * reset and the baudrate is detected again
      * 
-     * @param frame Frame to store the data readed
+     * @return true If valid frames are being received again
      */
-    void read_data(ld2461_frame_t* frame);
+    bool resync();
+
+    /**
+     * @brief Get the link quality counters since boot
+     * 
+     * @param stats Where to copy the counters
+     */
+    void get_link_stats(ld2461_link_stats_t* stats);
+
+    /**
+     * @brief Start the task that receives the radar frames as soon as they arrive
+     * @note After this, reports are taken with pop_detection()
+     */
+    void start_rx_task();
+
+    /**
+     * @brief Task to notify every time a report is queued for pop_detection()
+     * @note Set it before start_rx_task()
+     *
+     * @param task Task to notify (NULL for none)
+     * @param bits Notification bits set on the task
+     */
+    void set_report_listener(TaskHandle_t task, uint32_t bits);
+
+    /**
+     * @brief Take the oldest report parsed by the RX task
+     * @note Only one task may consume the reports
+     *
+     * @param detection Where to store the targets
+     * @return true If a report was available
+     */
+    bool pop_detection(ld2461_detection_t* detection);
+
+    /**
+     * @brief Run a received frame through the radar pipeline
+     * @note Reports are decoded, ghost filtered, tracked, moved to the world and queued for
+     * pop_detection(), any other frame is a command response. Called by the RX task, and by
+     * the host build with recorded or generated frames
+     *
+     * @param frame Valid frame
+     * @param arrival_time esp_timer time of the frame end
+     */
+    void dispatch_frame(ld2461_frame_t* frame, int64_t arrival_time);
+
+    /**
+     * @brief Number of reports dropped because the detection stage was not consuming them
+     */
+    uint32_t get_dropped_detections();
 
     /**
      * @brief Change the LD2461 baudrate
@@ -165,8 +284,28 @@ public:
      * @warning Note that the baudrate change can not be reverted by reseting to factory settings
      * 
      * @param baudrate Baudrate to change
+     * @return true If the radar acknowledged the change at the new baudrate
+     */
+    bool change_baudrate(ld2461_baudrate_t baudrate);
+
+    /**
+     * @brief Find the baudrate the radar is using, trying the one stored in NVS first
+     * 
+     * @return uint32_t Baudrate found, 0 if the radar did not answer
+     */
+    uint32_t detect_baudrate();
+
+    /**
+     * @brief Detect the current baudrate and move the link to the target one
+     * @note Falls back to the detected baudrate when the target does not validate,
+     * the baudrate that works is stored in NVS
+     * 
+     * @param target Baudrate wanted
+     * @return uint32_t Baudrate in use, 0 if the radar did not answer
      */
-    void change_baudrate(ld2461_baudrate_t baudrate);
+    uint32_t negotiate_baudrate(ld2461_baudrate_t target);
+
+    uint32_t get_baudrate();
     
     /**
      * @brief Get the version and id
@@ -178,11 +317,44 @@ public:
 
     /**
      * @brief Get the detected targets
+     * @warning Do not use it after start_rx_task(), use pop_detection() instead
      * 
      * @param detection Targets detected
      */
     void report_detections(ld2461_detection_t* detection);
 
+    /**
+     * @brief Program the radar zone filter
+     * 
+     * @param filter Zones and filtering mode
+     * @return true If the radar acknowledged the zones
+     */
+    bool set_zone_filter(const ld2461_zone_filter_t* filter);
+
+    /**
+     * @brief Read the zones programmed in the radar
+     * 
+     * @param filter Where to store the zones
+     * @return true If the radar answered
+     */
+    bool read_zone_filter(ld2461_zone_filter_t* filter);
+
+    /**
+     * @brief Remove every zone, the radar reports all targets again
+     * 
+     * @return true If the radar acknowledged
+     */
+    bool withdraw_zone_filter();
+
+    /**
+     * @brief Program the zone filter and read it back to be sure it was applied
+     * @note Withdraws the zones if they can not be verified, so no target is hidden by a bad zone
+     * 
+     * @param filter Zones and filtering mode
+     * @return true If the zones read back match
+     */
+    bool apply_zone_filter(const ld2461_zone_filter_t* filter);
+
     /**
      * @brief Convert the frame to a cstring
      * 
@@ -206,8 +378,6 @@ public:
      */
     const char* detection_to_json(ld2461_frame_t* frame);
 
-    void filter_ghost_targets(ld2461_detection_t* detection);
-
     void set_ghost_timer_timeout(int64_t timeout);
     int64_t get_ghost_timer_timeout();
 
@@ -216,4 +386,37 @@ public:
 
     void set_flag(ld2461_flags flag, uint8_t value);
     uint8_t get_flag(ld2461_flags flag);
+
+    uint32_t get_tracks_created();
+    uint32_t get_track_swaps();
+
+    /**
+     * @brief Set where the radar is in the world coordinates
+     * @note Applied by the RX task, reports are published already in the world coordinates
+     * 
+     * @param mount Rotation and offset of the radar
+     */
+    void set_mount(ld2461_mount_t mount);
+    ld2461_mount_t get_mount();
+
+    /**
+     * @brief Load the mount stored in NVS (LD2461_<index>_ROT, _X and _Y)
+     * @note Keeps the current mount if nothing is stored
+     */
+    void load_mount();
+
+    /**
+     * @brief Store a radar mount in NVS, the radar does not need to be running
+     * 
+     * @param index Radar number
+     * @param mount Rotation and offset of the radar
+     */
+    static void save_mount(uint8_t index, ld2461_mount_t mount);
+
+    /**
+     * @brief Convert a world point (meters) to this radar coordinates (meters)
+     */
+    void world_to_radar(float x, float y, float* radar_x, float* radar_y);
+
+    uint8_t get_index();
 };
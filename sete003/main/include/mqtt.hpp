@@ -26,9 +26,10 @@ public:
      * 
      * @param topic Topic to publish
      * @param payload Payload to publish
+     * @param retain Keep the message in the broker for new subscribers
      * @return esp_err_t ESP_OK if success
      */
-    esp_err_t publish(const char* topic, const char* payload);
+    esp_err_t publish(const char* topic, const char* payload, bool retain = false);
 
     /**
      * @brief Subscribe to a topic
@@ -3,6 +3,7 @@
 #include <string>
 
 #include "driver/temperature_sensor.h"
+#include "freertos/FreeRTOS.h"
 
 class Sensor{
 private:
@@ -13,6 +14,8 @@ private:
 
     int64_t payload_buffer_time;
     std::string ota_update_uri;
+    int64_t utc_offset;     // UTC minus esp_timer time (us), 0 until the clock is set
+    portMUX_TYPE utc_offset_lock;   // Written by the detection task, read by the telemetry timer (64 bits are two accesses on the ESP32)
 
     temperature_sensor_handle_t temperature_sensor;
 public:
@@ -76,8 +79,30 @@ public:
     int64_t get_free_memory();
 
     char* time_now();
+
+    /**
+     * @brief Local time of an esp_timer timestamp
+     * 
+     * @param esp_time esp_timer time in microseconds (0 for now)
+     * @return char* Formatted time, valid until the next call
+     */
+    char* time_at(int64_t esp_time);
     void change_time_zone(const char* time_zone);
 
+    /**
+     * @brief Refresh the esp_timer to UTC mapping from the wall clock (kept in time by SNTP)
+     * @note Cheap, called every payload period so the mapping follows the SNTP corrections
+     */
+    void update_utc_offset();
+
+    /**
+     * @brief UTC time of an esp_timer timestamp, from the cached mapping
+     * 
+     * @param esp_time esp_timer time in microseconds
+     * @return int64_t Microseconds since the epoch, 0 if the clock was never set
+     */
+    int64_t utc_time_at(int64_t esp_time);
+
     std::string get_current_timestamp();
 
     void shutdown();
@@ -0,0 +1,73 @@
+/*
+Single Producer / Single Consumer Queue
+---------------------------------------
+Lock-free ring of N items (N must be a power of two). Only one task may call
+push() and only one task may call pop(). When the queue is full the newest
+item is dropped and counted, the producer never blocks.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, size_t N>
+class SPSCQueue{
+private:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SPSCQueue size must be a power of two");
+
+    T items[N];
+    std::atomic<size_t> head;       // Written by the producer
+    std::atomic<size_t> tail;       // Written by the consumer
+    std::atomic<uint32_t> dropped;  // Items rejected because the queue was full
+
+public:
+    SPSCQueue() : head(0), tail(0), dropped(0) {}
+
+    /**
+     * @brief Add an item to the queue (producer only)
+     *
+     * @param item Item to copy into the queue
+     * @return true If the item was queued
+     * @return false If the queue was full and the item was dropped
+     */
+    bool push(const T& item)
+    {
+        size_t current_head = head.load(std::memory_order_relaxed);
+        if(current_head - tail.load(std::memory_order_acquire) == N)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[current_head & (N - 1)] = item;
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item from the queue (consumer only)
+     *
+     * @param item Where to copy the item
+     * @return true If an item was copied
+     * @return false If the queue was empty
+     */
+    bool pop(T* item)
+    {
+        size_t current_tail = tail.load(std::memory_order_relaxed);
+        if(current_tail == head.load(std::memory_order_acquire)) return false;
+        *item = items[current_tail & (N - 1)];
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size()
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    uint32_t get_dropped()
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
@@ -20,6 +20,7 @@ public:
     void store_data_uint8(storage_type_t type, const char* key, uint8_t value);   // Store Integers
     void store_data_uint16(storage_type_t type, const char* key, uint16_t value); // Store Integers
     void store_data_uint32(storage_type_t type, const char* key, uint32_t value); // Store Integers
+    void store_data_blob(storage_type_t type, const char* key, const void* value, size_t length); // Store Binary
 
     // Get Data
     char* get_str(storage_type_t type, const char* key);       // Get String
@@ -29,5 +30,6 @@ public:
     uint8_t get_uint8(storage_type_t type, const char* key);   // Get Integers
     uint16_t get_uint16(storage_type_t type, const char* key); // Get Integers
     uint32_t get_uint32(storage_type_t type, const char* key); // Get Integers
+    bool get_blob(storage_type_t type, const char* key, void* value, size_t length); // Get Binary (false if missing or of another size)
 
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+Target Tracker
+--------------
+The LD2461 sorts its report slots again on every frame, so when two people
+cross paths their slots swap and the history kept per slot (entered side,
+exited side) ends up on the wrong person. The tracker keeps one track per
+person: each track predicts its next position with a constant velocity and the
+report targets are associated to the predictions with a gated cost matrix and
+an optimal (Hungarian) assignment.
+
+The report leaves the tracker with slot i holding track i, the slot of a person
+does not change while the track lives and track_id changes when a new person
+takes the slot.
+
+Integer only (Q8 decimeters) and fixed size matrices, a report with
+MAX_TARGETS_DETECTION targets always costs the same. Nothing here uses ESP-IDF.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ld2461_protocol.hpp"
+
+#define TRACKER_Q 8                     // Fractional bits of the track positions and velocities
+#define TRACKER_GATE_DECIMETERS 12      // A target farther than this from the prediction of a track never joins it
+#define TRACKER_MAX_MISSES 3            // Reports a track survives without a target, its position keeps being predicted
+#define TRACKER_MAX_SPEED 30            // Decimeters per second, higher velocities are clamped (running is ~3 m/s)
+#define TRACKER_VELOCITY_GAIN 96        // Q8 weight of the measured velocity on every update (0..256)
+
+typedef struct track{
+    uint16_t id;            // 0 when the slot is free
+    int32_t x;              // Position, Q8 decimeters
+    int32_t y;
+    int32_t vx;             // Velocity, Q8 decimeters per second
+    int32_t vy;
+    int64_t timestamp;      // Time of the report that last updated the track (us)
+    uint8_t misses;         // Reports in a row without a target
+}track_t;
+
+class Tracker{
+private:
+    track_t tracks[MAX_TARGETS_DETECTION];
+    uint16_t next_id;
+
+    uint32_t created;       // Tracks started
+    uint32_t swaps;         // Targets associated to a track in a different slot than the one the radar used
+
+    /**
+     * @brief Position of a track at the given time
+     */
+    void predict(const track_t* track, int64_t timestamp, int32_t* x, int32_t* y);
+
+    /**
+     * @brief Minimum cost assignment of the rows (tracks) to the columns (targets)
+     *
+     * @param cost Square cost matrix
+     * @param assignment Column assigned to each row
+     */
+    static void assign(const int32_t cost[MAX_TARGETS_DETECTION][MAX_TARGETS_DETECTION], int8_t assignment[MAX_TARGETS_DETECTION]);
+
+public:
+    Tracker();
+
+    /**
+     * @brief Drop every track
+     */
+    void reset();
+
+    /**
+     * @brief Associate the targets of a report to the tracks and reorder the report by track
+     * @note Ghosts (flagged by the GhostFilter) are ignored, slots of tracks without a target are left unavailable.
+     * Teleported targets join the tracks and keep LD2461_TARGET_TELEPORTED in their slot
+     *
+     * @param detection Report to track, in the radar coordinates
+     */
+    void update(ld2461_detection_t* detection);
+
+    uint32_t get_created();
+    uint32_t get_swaps();
+};
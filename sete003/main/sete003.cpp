@@ -37,20 +37,28 @@
 #include "mqtt.hpp"
 #include "detection.hpp"
 #include "storage.hpp"
+#include "clock.hpp"
 
 // LED GPIOs
 #define RED_LED GPIO_NUM_45
 #define GREEN_LED GPIO_NUM_38
 #define BLUE_LED GPIO_NUM_37
 
+// Radar wiring, the second radar is only started when LD2461_1_EN is set in NVS
+static const uart_port_t radar_uart[MAX_RADARS] = {UART_NUM_2, UART_NUM_1};
+static const gpio_num_t radar_tx_pin[MAX_RADARS] = {GPIO_NUM_36, GPIO_NUM_17};
+static const gpio_num_t radar_rx_pin[MAX_RADARS] = {GPIO_NUM_35, GPIO_NUM_18};
+
 // Local Variables
 static const char *TAG = "SET003";
 
 // Global Variables
+Clock* system_clock;
 Storage* storage;
 MQTT* mqtt;
 Sensor* sensor;
-LD2461* ld2461;
+LD2461* radars[MAX_RADARS];
+uint8_t radars_count = 0;
 PIR* pir;
 WiFi_STA* wifi;
 Detection* detection;
@@ -67,6 +75,9 @@ void app_main(void)
 {
     //esp_log_level_set("*", ESP_LOG_INFO);
     ESP_LOGI("SET003", "Firmware Compiled on [ %s @ %s ]", __DATE__, __TIME__);
+    // Every timestamp of the firmware comes from here
+    system_clock = new EspClock();
+
     // Initialize Storage (NVS)
     storage = new Storage();
 
@@ -92,12 +103,22 @@ void app_main(void)
     gpio_set_level(RED_LED, 1);
 
     // Initialize Sensors
-    ld2461 = new LD2461(
-        UART_NUM_2,
-        GPIO_NUM_36,    // TX Pin
-        GPIO_NUM_35,    // RX Pin
-        9600
-    );
+    for(int i=0; i<MAX_RADARS; i++)
+    {
+        char key_enabled[16];
+        snprintf(key_enabled, sizeof(key_enabled), "LD2461_%d_EN", i);
+        if(i > 0 && storage->get_uint8(SENSOR_BASIC_DATA, key_enabled) == 0) break;
+
+        radars[i] = new LD2461(
+            radar_uart[i],
+            radar_tx_pin[i],    // TX Pin
+            radar_rx_pin[i],    // RX Pin
+            9600,
+            i
+        );
+        radars[i]->load_mount();
+        radars_count++;
+    }
     pir = new PIR(GPIO_NUM_48);
 
     // Initialize MQTT
@@ -108,15 +129,22 @@ void app_main(void)
         sensor->transfer_log_to_mqtt();
     }
 
-    { // This variables are not needed after this, so we will create a new scope to free them after
-    // To be sure of the LD2461 initialization, we will read the firmware version from it
-    ld2461_frame_t ld2461_frame = ld2461_setup_frame();
-    ld2461_version_t ld2461_version = ld2461->get_version_and_id(&ld2461_frame);
-    ESP_LOGI(TAG, "Detected LD2461 running on v%01X.%01X from %d/%d/%d",
-                    ld2461_version.major, ld2461_version.minor,
-                    ld2461_version.month,
-                    ld2461_version.day,
-                    ld2461_version.year);
+    for(int i=0; i<radars_count; i++)
+    {
+        // The LD2461 boots at 9600, move it to the fastest baudrate the wiring holds
+        if(radars[i]->negotiate_baudrate(LD2461_BAUDRATE_256000) == 0)
+        {
+            ESP_LOGE(TAG, "LD2461 %d not answering, keeping %lu baud", i, (unsigned long)radars[i]->get_baudrate());
+        }
+
+        // To be sure of the LD2461 initialization, we will read the firmware version from it
+        ld2461_frame_t ld2461_frame = ld2461_setup_frame();
+        ld2461_version_t ld2461_version = radars[i]->get_version_and_id(&ld2461_frame);
+        ESP_LOGI(TAG, "Detected LD2461 %d running on v%01X.%01X from %d/%d/%d", i,
+                        ld2461_version.major, ld2461_version.minor,
+                        ld2461_version.month,
+                        ld2461_version.day,
+                        ld2461_version.year);
     }
 
     {
@@ -190,17 +218,31 @@ void app_main(void)
             ESP_LOGI(TAG, "Default values for the detection area stored");
         }
     }
-    ESP_LOGI(TAG, "Detection area: (%f, %f), (%f, %f), (%f, %f), (%f, %f)",
-        detection->get_detection_area_point()[0].x, detection->get_detection_area_point()[0].y,
-        detection->get_detection_area_point()[1].x, detection->get_detection_area_point()[1].y,
-        detection->get_detection_area_point()[2].x, detection->get_detection_area_point()[2].y,
-        detection->get_detection_area_point()[3].x, detection->get_detection_area_point()[3].y
-    );
+    {
+        zone_config_t zones[MAX_ZONES];
+        uint8_t zone_count = detection->get_zones(zones);
+        for(int zone=0; zone<zone_count; zone++)
+        {
+            ESP_LOGI(TAG, "Detection zone %d: %u vertices, first (%f, %f)",
+                zone, zones[zone].vertex_count, zones[zone].vertex[0].x, zones[zone].vertex[0].y
+            );
+        }
+    }
+
+    // Targets far from the detection area are filtered by the radar itself
+    detection->sync_radar_zone();
 
     // Initialize Variables
     std::string sensor_state;
+    ld2461_link_stats_t link_stats;
+    detection_latency_t detection_latency;
     detection->start_detection();
-    int64_t last_payload_time = esp_timer_get_time();
+    detection->start_task(sensor->get_payload_buffer_time()); // From now on the detection task owns the counting
+    for(int i=0; i<radars_count; i++)
+    {
+        radars[i]->set_report_listener(detection->get_task(), DETECTION_EVENT_REPORT);
+        radars[i]->start_rx_task(); // From now on each RX task owns its radar UART
+    }
     int64_t time_now = 0;
     // Main Loop
     vTaskDelay(5000 / portTICK_PERIOD_MS);
@@ -217,6 +259,7 @@ void app_main(void)
 
     ESP_LOGI(TAG, "Started on [%s (GMT +0)]", sensor->get_current_timestamp().c_str());
     sensor->change_time_zone("GMT +3"); // Change to UTC-3
+    sensor->update_utc_offset();
 
     ////esp_log_level_set("*", ESP_LOG_WARN);
 
@@ -232,29 +275,76 @@ void app_main(void)
     storage->store_data_str(WIFI_BASIC_DATA, "SSID", wifi->get_ssid().c_str());
     storage->store_data_str(WIFI_BASIC_DATA, "PASSWORD", wifi->get_password().c_str());
 
+    // Telemetry runs on its own timer, the main task sleeps until it fires
+    esp_timer_handle_t telemetry_timer;
+    esp_timer_create_args_t telemetry_timer_args = {};
+    telemetry_timer_args.callback = [](void* arg){xTaskNotifyGive((TaskHandle_t)arg);};
+    telemetry_timer_args.arg = (void*)xTaskGetCurrentTaskHandle();
+    telemetry_timer_args.dispatch_method = ESP_TIMER_TASK;
+    telemetry_timer_args.name = "telemetry";
+    telemetry_timer_args.skip_unhandled_events = true;
+    ESP_ERROR_CHECK(esp_timer_create(&telemetry_timer_args, &telemetry_timer));
+    int64_t telemetry_period = sensor->get_payload_buffer_time();
+    ESP_ERROR_CHECK(esp_timer_start_periodic(telemetry_timer, telemetry_period));
+
     while(flag_0)
     {
         //printf("%s\n", sensor->get_current_timestamp().c_str());
-        time_now = esp_timer_get_time();
-        detection->detect();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        time_now = system_clock->now();
+        if(sensor->get_payload_buffer_time() != telemetry_period)
+        {
+            telemetry_period = sensor->get_payload_buffer_time();
+            esp_timer_stop(telemetry_timer);
+            ESP_ERROR_CHECK(esp_timer_start_periodic(telemetry_timer, telemetry_period));
+        }
+        detection->get_latency(&detection_latency);
+        std::string radar_link = "[";
+        for(int i=0; i<radars_count; i++)
+        {
+            radars[i]->get_link_stats(&link_stats);
+            radar_link += (
+                "{"
+                    "\"baudrate\": " + std::to_string(radars[i]->get_baudrate()) + ","
+                    "\"frames\": " + std::to_string(link_stats.frames) + ","
+                    "\"checksum_errors\": " + std::to_string(link_stats.checksum_errors) + ","
+                    "\"trailer_errors\": " + std::to_string(link_stats.trailer_errors) + ","
+                    "\"length_errors\": " + std::to_string(link_stats.length_errors) + ","
+                    "\"discarded_bytes\": " + std::to_string(link_stats.discarded_bytes) + ","
+                    "\"fifo_overflows\": " + std::to_string(link_stats.fifo_overflows) + ","
+                    "\"buffer_full\": " + std::to_string(link_stats.buffer_full) + ","
+                    "\"resyncs\": " + std::to_string(link_stats.resyncs) + ","
+                    "\"failed_resyncs\": " + std::to_string(link_stats.failed_resyncs) + ","
+                    "\"last_resync_us\": " + std::to_string(link_stats.last_resync_duration) + ","
+                    "\"max_resync_us\": " + std::to_string(link_stats.max_resync_duration) + ","
+                    "\"dropped_reports\": " + std::to_string(radars[i]->get_dropped_detections()) + ","
+                    "\"tracks_created\": " + std::to_string(radars[i]->get_tracks_created()) + ","
+                    "\"track_swaps\": " + std::to_string(radars[i]->get_track_swaps()) +
+                "}"
+            );
+            if(i < radars_count - 1) radar_link += ",";
+        }
+        radar_link += "]";
         sensor_state = (
             "{"
                 "\"internal_temperature\": " + std::to_string(sensor->get_internal_temperature()) + ","
                 "\"free_memory\": " + std::to_string(esp_get_free_heap_size()) + ","
                 "\"rssi\": " + std::to_string(wifi->get_rssi()) + ","
-                "\"uptime\": " + std::to_string(esp_timer_get_time() / 1000000) + ","
-                "\"last_boot_reason\": " + std::to_string(esp_reset_reason()) +
+                "\"uptime\": " + std::to_string(system_clock->now() / 1000000) + ","
+                "\"last_boot_reason\": " + std::to_string(esp_reset_reason()) + ","
+                "\"ts\": " + std::to_string(sensor->utc_time_at(time_now)) + ","
+                "\"radar_link\": " + radar_link + ","
+                "\"detection\": {"
+                    "\"reports\": " + std::to_string(detection_latency.reports) + ","
+                    "\"deadline_misses\": " + std::to_string(detection_latency.deadline_misses) + ","
+                    "\"last_latency_us\": " + std::to_string(detection_latency.last) + ","
+                    "\"max_latency_us\": " + std::to_string(detection_latency.max) +
+                "}"
             "}"
         );
-        if(time_now - last_payload_time > sensor->get_payload_buffer_time())
-        {
-            detection->mqtt_send_detections();
-            mqtt->publish(
-                std::string(sensor->get_mqtt_root_topic() + "/info").c_str(),
-                sensor_state.c_str()
-            );
-            last_payload_time = time_now;
-        }
-        vTaskDelay(pdMS_TO_TICKS(100));
+        mqtt->publish(
+            std::string(sensor->get_mqtt_root_topic() + "/info").c_str(),
+            sensor_state.c_str()
+        );
     }
 }
\ No newline at end of file
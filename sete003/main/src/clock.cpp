@@ -0,0 +1,55 @@
+#include "clock.hpp"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <sys/time.h>
+
+// EspClock
+// --------
+
+int64_t EspClock::now()
+{
+    return esp_timer_get_time();
+}
+
+int64_t EspClock::utc()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+void EspClock::sleep(int64_t duration)
+{
+    if(duration > 0) vTaskDelay(pdMS_TO_TICKS(duration / 1000));
+}
+
+// SimulatedClock
+// --------------
+
+SimulatedClock::SimulatedClock(int64_t epoch)
+{
+    this->time = 0;
+    this->epoch = epoch;
+}
+
+int64_t SimulatedClock::now()
+{
+    return this->time;
+}
+
+int64_t SimulatedClock::utc()
+{
+    return this->epoch + this->time;
+}
+
+void SimulatedClock::sleep(int64_t duration)
+{
+    if(duration > 0) this->time += duration;
+}
+
+void SimulatedClock::set(int64_t time)
+{
+    if(time > this->time) this->time = time;
+}
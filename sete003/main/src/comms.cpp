@@ -4,20 +4,93 @@
 #include "mqtt.hpp"
 #include "wifi.hpp"
 #include "ota_update.hpp"
+#include "storage.hpp"
 
 #include "esp_log.h"
 #include "cJSON.h"
 
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string>
 
 extern Detection* detection;
 extern MQTT* mqtt;
 extern WiFi_STA* wifi;
 extern Sensor* sensor;
-extern LD2461* ld2461;
+extern Storage* storage;
+extern LD2461* radars[MAX_RADARS];
+extern uint8_t radars_count;
 
 const char* COMMS_TAG = "COMMS";
 
+/**
+ * @brief Read a {"x": 0, "y": 0} point
+ * @return false If it is not an object with finite numbers x and y
+ */
+static bool json_point(cJSON* item, point_t* point)
+{
+    cJSON* x = cJSON_GetObjectItem(item, "x");
+    cJSON* y = cJSON_GetObjectItem(item, "y");
+    if(!cJSON_IsNumber(x) || !cJSON_IsNumber(y) || !isfinite(x->valuedouble) || !isfinite(y->valuedouble)) return false;
+    *point = {(float)x->valuedouble, (float)y->valuedouble};
+    return true;
+}
+
+/**
+ * @brief Read a JSON number that has to be a whole number from min to max
+ * @return false If it is not a number, has a fraction or is out of range
+ */
+static bool json_integer(cJSON* item, int64_t min, int64_t max, int64_t* value)
+{
+    if(!cJSON_IsNumber(item) || !isfinite(item->valuedouble)) return false;
+    double number = item->valuedouble;
+    if(number != floor(number) || number < (double)min || number > (double)max) return false;
+    *value = (int64_t)number;
+    return true;
+}
+
+/**
+ * @brief Read a whole payload as a number, std::stoll would throw out of the MQTT handler
+ * @return false If the payload is not only a number in range
+ */
+static bool parse_integer(const std::string& data, int64_t* value)
+{
+    char* end;
+    errno = 0;
+    long long parsed = strtoll(data.c_str(), &end, 10);
+    if(end == data.c_str() || *end != '\0' || errno == ERANGE) return false;
+    *value = parsed;
+    return true;
+}
+
+static bool parse_decimal(const std::string& data, double* value)
+{
+    char* end;
+    errno = 0;
+    double parsed = strtod(data.c_str(), &end);
+    if(end == data.c_str() || *end != '\0' || errno == ERANGE || !isfinite(parsed)) return false;
+    *value = parsed;
+    return true;
+}
+
+/**
+ * @brief Publish a JSON document on the callback topic and free it
+ */
+static void publish_callback(cJSON* root)
+{
+    char* data = cJSON_Print(root);
+    if(data != NULL)
+    {
+        mqtt->publish(
+            sensor->get_mqtt_callback_topic().c_str(),
+            data
+        );
+        cJSON_free(data);
+    }
+    cJSON_Delete(root);
+}
+
 void process_server_message(
     std::string topic,
     std::string data
@@ -41,12 +114,15 @@ void process_server_message(
         }
 
         cJSON* url = cJSON_GetObjectItem(root, "url");
-        if(url == NULL)
+        if(!cJSON_IsString(url))
         {
             ESP_LOGE(COMMS_TAG, "Invalid URL");
+            cJSON_Delete(root);
             return;
         }
-        ota_update(url->valuestring);
+        std::string uri = url->valuestring;
+        cJSON_Delete(root);
+        ota_update(uri);
     }
     else if(topic == "/detection_area/set")
     {
@@ -58,39 +134,92 @@ void process_server_message(
             return;
         }
 
-        cJSON* new_D0 = cJSON_GetObjectItem(root, "D0");
-        cJSON* new_D1 = cJSON_GetObjectItem(root, "D1");
-        cJSON* new_D2 = cJSON_GetObjectItem(root, "D2");
-        cJSON* new_D3 = cJSON_GetObjectItem(root, "D3");
-        cJSON* new_S0 = cJSON_GetObjectItem(root, "S0");
-        cJSON* new_S1 = cJSON_GetObjectItem(root, "S1");
-
-        float D0_x = cJSON_GetObjectItem(new_D0, "x")->valuedouble;
-        float D0_y = cJSON_GetObjectItem(new_D0, "y")->valuedouble;
-
-        float D1_x = cJSON_GetObjectItem(new_D1, "x")->valuedouble;
-        float D1_y = cJSON_GetObjectItem(new_D1, "y")->valuedouble;
+        // {"zones": [{"vertices": [{"x": 0, "y": 0}, ...], "sides": ["LEFT", ...], "line": [{"x": 0, "y": 0}, {"x": 0, "y": 0}]}]}
+        cJSON* zones = cJSON_GetObjectItem(root, "zones");
+        if(zones != NULL)
+        {
+            zone_config_t configs[MAX_ZONES] = {};
+            int count = 0;
+            bool valid = cJSON_IsArray(zones) && cJSON_GetArraySize(zones) > 0 && cJSON_GetArraySize(zones) <= MAX_ZONES;
+            cJSON* zone = NULL;
+            cJSON_ArrayForEach(zone, zones)
+            {
+                if(!valid) break;
+                zone_config_t* config = &configs[count++];
+                cJSON* vertices = cJSON_GetObjectItem(zone, "vertices");
+                cJSON* sides = cJSON_GetObjectItem(zone, "sides");
+                cJSON* line = cJSON_GetObjectItem(zone, "line");
+                int vertex_count = cJSON_IsArray(vertices) ? cJSON_GetArraySize(vertices) : 0;
+                if(vertex_count < 3 || vertex_count > ZONE_MAX_VERTICES || !cJSON_IsArray(line) || cJSON_GetArraySize(line) != 2)
+                {
+                    valid = false;
+                    break;
+                }
 
-        float D2_x = cJSON_GetObjectItem(new_D2, "x")->valuedouble;
-        float D2_y = cJSON_GetObjectItem(new_D2, "y")->valuedouble;
+                config->vertex_count = vertex_count;
+                for(int i=0; i<vertex_count; i++)
+                {
+                    if(!json_point(cJSON_GetArrayItem(vertices, i), &config->vertex[i])) valid = false;
+                }
+                for(int i=0; i<2; i++)
+                {
+                    if(!json_point(cJSON_GetArrayItem(line, i), &config->line[i])) valid = false;
+                }
+                if(!valid) break;
 
-        float D3_x = cJSON_GetObjectItem(new_D3, "x")->valuedouble;
-        float D3_y = cJSON_GetObjectItem(new_D3, "y")->valuedouble;
+                if(sides == NULL && vertex_count == 4)
+                {
+                    // Same sides as the detection area
+                    const uint8_t quad_sides[4] = {LEFT, TOP, RIGHT, BOTTOM};
+                    memcpy(config->edge_side, quad_sides, sizeof(quad_sides));
+                    continue;
+                }
+                if(!cJSON_IsArray(sides) || cJSON_GetArraySize(sides) != vertex_count)
+                {
+                    valid = false;
+                    break;
+                }
+                for(int i=0; i<vertex_count; i++)
+                {
+                    int side = crossing_index_of(cJSON_GetStringValue(cJSON_GetArrayItem(sides, i)), crossing_side_str, CROSSING_SIDES);
+                    if(side < 0) valid = false;
+                    config->edge_side[i] = side;
+                }
+            }
 
-        float S0_x = cJSON_GetObjectItem(new_S0, "x")->valuedouble;
-        float S0_y = cJSON_GetObjectItem(new_S0, "y")->valuedouble;
+            if(!valid || !detection->set_zones(configs, count))
+            {
+                ESP_LOGE(COMMS_TAG, "Invalid detection zones");
+                cJSON_Delete(root);
+                return;
+            }
+            detection->sync_radar_zone();
+            cJSON_Delete(root);
+            return;
+        }
 
-        float S1_x = cJSON_GetObjectItem(new_S1, "x")->valuedouble;
-        float S1_y = cJSON_GetObjectItem(new_S1, "y")->valuedouble;
+        // {"D0": {"x": 0, "y": 0}, ... "S1": {"x": 0, "y": 0}}
+        const char* names[6] = {"D0", "D1", "D2", "D3", "S0", "S1"};
+        point_t points[6];
+        for(int i=0; i<6; i++)
+        {
+            if(!json_point(cJSON_GetObjectItem(root, names[i]), &points[i]))
+            {
+                ESP_LOGE(COMMS_TAG, "Invalid detection area, %s is missing", names[i]);
+                cJSON_Delete(root);
+                return;
+            }
+        }
 
         detection->set_detection_area(
-            {D0_x, D0_y},
-            {D1_x, D1_y},
-            {D2_x, D2_y},
-            {D3_x, D3_y},
-            {S0_x, S0_y},
-            {S1_x, S1_y}
+            points[0],
+            points[1],
+            points[2],
+            points[3],
+            points[4],
+            points[5]
         );
+        detection->sync_radar_zone();
 
         cJSON_Delete(root);
     }
@@ -98,47 +227,56 @@ void process_server_message(
     {
         ESP_LOGI("COMMS", "Sending detection area to callback topic by Server command");
         cJSON* root = cJSON_CreateObject();
-        cJSON* D0 = cJSON_CreateObject();
-        cJSON* D1 = cJSON_CreateObject();
-        cJSON* D2 = cJSON_CreateObject();
-        cJSON* D3 = cJSON_CreateObject();
-        cJSON* S0 = cJSON_CreateObject();
-        cJSON* S1 = cJSON_CreateObject();
-
-        detection_area_t detection_area = detection->get_detection_area();
-
-        cJSON_AddItemToObject(D0, "x", cJSON_CreateNumber(detection_area.D[0].x));
-        cJSON_AddItemToObject(D0, "y", cJSON_CreateNumber(detection_area.D[0].y));
-
-        cJSON_AddItemToObject(D1, "x", cJSON_CreateNumber(detection_area.D[1].x));
-        cJSON_AddItemToObject(D1, "y", cJSON_CreateNumber(detection_area.D[1].y));
 
-        cJSON_AddItemToObject(D2, "x", cJSON_CreateNumber(detection_area.D[2].x));
-        cJSON_AddItemToObject(D2, "y", cJSON_CreateNumber(detection_area.D[2].y));
-
-        cJSON_AddItemToObject(D3, "x", cJSON_CreateNumber(detection_area.D[3].x));
-        cJSON_AddItemToObject(D3, "y", cJSON_CreateNumber(detection_area.D[3].y));
-
-        cJSON_AddItemToObject(S0, "x", cJSON_CreateNumber(detection_area.S[0].x));
-        cJSON_AddItemToObject(S0, "y", cJSON_CreateNumber(detection_area.S[0].y));
-
-        cJSON_AddItemToObject(S1, "x", cJSON_CreateNumber(detection_area.S[1].x));
-        cJSON_AddItemToObject(S1, "y", cJSON_CreateNumber(detection_area.S[1].y));
-
-        cJSON_AddItemToObject(root, "D0", D0);
-        cJSON_AddItemToObject(root, "D1", D1);
-        cJSON_AddItemToObject(root, "D2", D2);
-        cJSON_AddItemToObject(root, "D3", D3);
-        cJSON_AddItemToObject(root, "S0", S0);
-        cJSON_AddItemToObject(root, "S1", S1);
+        zone_config_t configs[MAX_ZONES];
+        uint8_t count = detection->get_zones(configs);
+        cJSON* zones = cJSON_CreateArray();
+        for(int zone=0; zone<count; zone++)
+        {
+            cJSON* item = cJSON_CreateObject();
+            cJSON* vertices = cJSON_CreateArray();
+            cJSON* sides = cJSON_CreateArray();
+            cJSON* line = cJSON_CreateArray();
+            for(int i=0; i<configs[zone].vertex_count; i++)
+            {
+                cJSON* vertex = cJSON_CreateObject();
+                cJSON_AddItemToObject(vertex, "x", cJSON_CreateNumber(configs[zone].vertex[i].x));
+                cJSON_AddItemToObject(vertex, "y", cJSON_CreateNumber(configs[zone].vertex[i].y));
+                cJSON_AddItemToArray(vertices, vertex);
+                cJSON_AddItemToArray(sides, cJSON_CreateString(crossing_side_str[configs[zone].edge_side[i]]));
+            }
+            for(int i=0; i<2; i++)
+            {
+                cJSON* point = cJSON_CreateObject();
+                cJSON_AddItemToObject(point, "x", cJSON_CreateNumber(configs[zone].line[i].x));
+                cJSON_AddItemToObject(point, "y", cJSON_CreateNumber(configs[zone].line[i].y));
+                cJSON_AddItemToArray(line, point);
+            }
+            cJSON_AddItemToObject(item, "vertices", vertices);
+            cJSON_AddItemToObject(item, "sides", sides);
+            cJSON_AddItemToObject(item, "line", line);
+            cJSON_AddItemToArray(zones, item);
+        }
+        cJSON_AddItemToObject(root, "zones", zones);
 
-        char* data = cJSON_Print(root);
-        mqtt->publish(
-            sensor->get_mqtt_callback_topic().c_str(),
-            data
-        );
+        // The first zone as a detection area, for the tools that only know D0..D3
+        if(configs[0].vertex_count == 4)
+        {
+            const char* names[6] = {"D0", "D1", "D2", "D3", "S0", "S1"};
+            point_t points[6] = {
+                configs[0].vertex[0], configs[0].vertex[1], configs[0].vertex[2], configs[0].vertex[3],
+                configs[0].line[0], configs[0].line[1]
+            };
+            for(int i=0; i<6; i++)
+            {
+                cJSON* point = cJSON_CreateObject();
+                cJSON_AddItemToObject(point, "x", cJSON_CreateNumber(points[i].x));
+                cJSON_AddItemToObject(point, "y", cJSON_CreateNumber(points[i].y));
+                cJSON_AddItemToObject(root, names[i], point);
+            }
+        }
 
-        cJSON_Delete(root);
+        publish_callback(root);
     }
     else if(topic == "/detection_area/invert")
     {
@@ -155,6 +293,108 @@ void process_server_message(
             ESP_LOGW(COMMS_TAG, "Invalid data for invert");
         }
     }
+    else if(topic == "/counting_mode/set")
+    {
+        if(data == "area")
+        {
+            detection->set_counting_mode(COUNTING_AREA);
+        }
+        else if(data == "line")
+        {
+            detection->set_counting_mode(COUNTING_LINE);
+        }
+        else
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for counting mode");
+        }
+    }
+    else if(topic == "/counting_mode/get")
+    {
+        ESP_LOGI(COMMS_TAG, "Sending counting mode to callback topic by Server command");
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddItemToObject(root, "mode", cJSON_CreateString((detection->get_counting_mode() == COUNTING_LINE) ? "line" : "area"));
+        publish_callback(root);
+    }
+    else if(topic == "/occupancy/set")
+    {
+        ESP_LOGI(COMMS_TAG, "Setting occupancy by Server command");
+        int64_t occupancy;
+        if(!parse_integer(data, &occupancy) || occupancy < INT32_MIN || occupancy > INT32_MAX)
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for occupancy");
+            return;
+        }
+        detection->set_occupancy(occupancy);
+    }
+    else if(topic == "/occupancy/config/set")
+    {
+        // {"max": 0, "reset_time": "22:00" ("" for none), "empty_timeout": 3600}
+        ESP_LOGI(COMMS_TAG, "Setting occupancy configuration by Server command");
+        cJSON* root = cJSON_Parse(data.c_str());
+        if(root == NULL)
+        {
+            ESP_LOGE(COMMS_TAG, "Invalid JSON");
+            return;
+        }
+        occupancy_config_t config = detection->get_occupancy_config();
+        cJSON* max = cJSON_GetObjectItem(root, "max");
+        cJSON* reset_time = cJSON_GetObjectItem(root, "reset_time");
+        cJSON* empty_timeout = cJSON_GetObjectItem(root, "empty_timeout");
+        // A missing field keeps its value, one out of range rejects the whole command
+        int64_t max_value = config.max, empty_timeout_value = config.empty_timeout;
+        if((max != NULL && !json_integer(max, 0, UINT16_MAX, &max_value)) ||
+           (empty_timeout != NULL && !json_integer(empty_timeout, 0, UINT32_MAX, &empty_timeout_value)))
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid occupancy configuration");
+            cJSON_Delete(root);
+            return;
+        }
+        config.max = max_value;
+        config.empty_timeout = empty_timeout_value;
+        if(cJSON_IsString(reset_time))
+        {
+            int hour, minute;
+            if(sscanf(reset_time->valuestring, "%d:%d", &hour, &minute) == 2 &&
+               hour >= 0 && hour < 24 && minute >= 0 && minute < 60)
+            {
+                config.reset_minute = (hour * 60) + minute;
+            }
+            else config.reset_minute = -1;
+        }
+        detection->set_occupancy_config(config);
+        cJSON_Delete(root);
+    }
+    else if(topic == "/occupancy/get")
+    {
+        ESP_LOGI(COMMS_TAG, "Sending occupancy to callback topic by Server command");
+        occupancy_config_t config = detection->get_occupancy_config();
+        char reset_time[8] = "";
+        if(config.reset_minute >= 0) snprintf(reset_time, sizeof(reset_time), "%02d:%02d", config.reset_minute / 60, config.reset_minute % 60);
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddItemToObject(root, "occupancy", cJSON_CreateNumber(detection->get_occupancy()));
+        cJSON_AddItemToObject(root, "max", cJSON_CreateNumber(config.max));
+        cJSON_AddItemToObject(root, "reset_time", cJSON_CreateString(reset_time));
+        cJSON_AddItemToObject(root, "empty_timeout", cJSON_CreateNumber(config.empty_timeout));
+        publish_callback(root);
+    }
+    else if(topic == "/speed_gate/set")
+    {
+        ESP_LOGI(COMMS_TAG, "Setting minimum crossing speed by Server command");
+        int64_t min_speed;
+        if(!parse_integer(data, &min_speed) || min_speed < 0 || min_speed > UINT16_MAX)
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for speed gate");
+            return;
+        }
+        detection->set_min_crossing_speed(min_speed);
+    }
+    else if(topic == "/speed_gate/get")
+    {
+        ESP_LOGI(COMMS_TAG, "Sending minimum crossing speed to callback topic by Server command");
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddItemToObject(root, "min_speed", cJSON_CreateNumber(detection->get_min_crossing_speed()));
+        publish_callback(root);
+    }
     else if(topic == "/raw_data")
     {
         if(data == "true")
@@ -175,57 +415,202 @@ void process_server_message(
     else if(topic == "/payload_buffer_time/set")
     {
         ESP_LOGI(COMMS_TAG, "Setting payload buffer time by Server command");
-        int64_t buffer_time = std::stoll(data);
+        int64_t buffer_time;
+        if(!parse_integer(data, &buffer_time) || buffer_time <= 0)
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for payload buffer time");
+            return;
+        }
         sensor->set_payload_buffer_time(buffer_time);
+        detection->set_publish_period(buffer_time);
     }
     else if(topic == "/payload_buffer_time/get")
     {
         ESP_LOGI(COMMS_TAG, "Sending payload buffer time to callback topic by Server command");
         cJSON* root = cJSON_CreateObject();
         cJSON_AddItemToObject(root, "buffer_time", cJSON_CreateNumber(sensor->get_payload_buffer_time()));
-        char* data = cJSON_Print(root);
-        mqtt->publish(
-            sensor->get_mqtt_callback_topic().c_str(),
-            data
-        );
-        cJSON_Delete(root);
+        publish_callback(root);
     }
     else if(topic == "/ghost_timer/set")
     {
         ESP_LOGI(COMMS_TAG, "Setting ghost timer by Server command");
-        int64_t ghost_timer = std::stoll(data);
-        ld2461->set_ghost_timer_timeout(ghost_timer);
+        int64_t ghost_timer;
+        if(!parse_integer(data, &ghost_timer) || ghost_timer < 0)
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for ghost timer");
+            return;
+        }
+        for(int i=0; i<radars_count; i++) radars[i]->set_ghost_timer_timeout(ghost_timer);
     }
     else if(topic == "/ghost_timer/get")
     {
         ESP_LOGI(COMMS_TAG, "Sending ghost timer to callback topic by Server command");
         cJSON* root = cJSON_CreateObject();
-        cJSON_AddItemToObject(root, "ghost_timer", cJSON_CreateNumber(ld2461->get_ghost_timer_timeout()));
-        char* data = cJSON_Print(root);
-        mqtt->publish(
-            sensor->get_mqtt_callback_topic().c_str(),
-            data
-        );
-        cJSON_Delete(root);
+        cJSON_AddItemToObject(root, "ghost_timer", cJSON_CreateNumber(radars[0]->get_ghost_timer_timeout()));
+        publish_callback(root);
     }
     else if(topic == "/threshold_distance/set")
     {
         ESP_LOGI(COMMS_TAG, "Setting threshold distance by Server command");
-        double threshold_distance = std::stod(data);
-        ld2461->set_max_threshold_distance(threshold_distance);
+        double threshold_distance;
+        if(!parse_decimal(data, &threshold_distance) || threshold_distance < 0)
+        {
+            ESP_LOGW(COMMS_TAG, "Invalid data for threshold distance");
+            return;
+        }
+        for(int i=0; i<radars_count; i++) radars[i]->set_max_threshold_distance(threshold_distance);
     }
     else if(topic == "/threshold_distance/get")
     {
         ESP_LOGI(COMMS_TAG, "Sending threshold distance to callback topic by Server command");
         cJSON* root = cJSON_CreateObject();
-        cJSON_AddItemToObject(root, "threshold_distance", cJSON_CreateNumber(ld2461->get_max_threshold_distance()));
-        char* data = cJSON_Print(root);
+        cJSON_AddItemToObject(root, "threshold_distance", cJSON_CreateNumber(radars[0]->get_max_threshold_distance()));
+        publish_callback(root);
+    }
+    else if(topic == "/radar/mount/set")
+    {
+        ESP_LOGI(COMMS_TAG, "Setting radar mount by Server command");
+        cJSON* root = cJSON_Parse(data.c_str());
+        if(root == NULL)
+        {
+            ESP_LOGE(COMMS_TAG, "Invalid JSON");
+            return;
+        }
+        cJSON* radar = cJSON_GetObjectItem(root, "radar");
+        cJSON* rotation = cJSON_GetObjectItem(root, "rotation");
+        int64_t radar_index;
+        point_t offset;
+        if(!json_integer(radar, 0, MAX_RADARS - 1, &radar_index) || !json_point(root, &offset) ||
+           !cJSON_IsNumber(rotation) || !isfinite(rotation->valuedouble))
+        {
+            ESP_LOGE(COMMS_TAG, "Invalid radar mount");
+            cJSON_Delete(root);
+            return;
+        }
+
+        uint8_t index = radar_index;
+        ld2461_mount_t mount = {(float)rotation->valuedouble, offset.x, offset.y};
+        LD2461::save_mount(index, mount);
+        if(index < radars_count)
+        {
+            radars[index]->set_mount(mount);
+            detection->sync_radar_zone(); // The zone is given in the radar coordinates
+        }
+
+        // Radars are started at boot, enabling or disabling one takes effect after /reset
+        cJSON* enabled = cJSON_GetObjectItem(root, "enabled");
+        if(cJSON_IsBool(enabled) && index > 0)
+        {
+            char key_enabled[16];
+            snprintf(key_enabled, sizeof(key_enabled), "LD2461_%u_EN", index);
+            storage->store_data_uint8(SENSOR_BASIC_DATA, key_enabled, cJSON_IsTrue(enabled));
+        }
+        cJSON_Delete(root);
+    }
+    else if(topic == "/radar/mount/get")
+    {
+        ESP_LOGI(COMMS_TAG, "Sending radar mounts to callback topic by Server command");
+        cJSON* root = cJSON_CreateArray();
+        for(int i=0; i<radars_count; i++)
+        {
+            ld2461_mount_t mount = radars[i]->get_mount();
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddItemToObject(item, "radar", cJSON_CreateNumber(i));
+            cJSON_AddItemToObject(item, "rotation", cJSON_CreateNumber(mount.rotation));
+            cJSON_AddItemToObject(item, "x", cJSON_CreateNumber(mount.offset_x));
+            cJSON_AddItemToObject(item, "y", cJSON_CreateNumber(mount.offset_y));
+            cJSON_AddItemToArray(root, item);
+        }
+        publish_callback(root);
+    }
+    else if(topic == "/classifier/set")
+    {
+        // {"rules": [{"entered": "TOP", "exited": "BOTTOM", "trusted": true, "inverted": false, "event": "entered", "reason": 0}]}
+        // Without "inverted" both entries are set, the inverted one with entered and exited swapped
+        ESP_LOGI(COMMS_TAG, "Setting crossing rules by Server command");
+        cJSON* root = cJSON_Parse(data.c_str());
+        if(root == NULL)
+        {
+            ESP_LOGE(COMMS_TAG, "Invalid JSON");
+            return;
+        }
+        cJSON* rules = cJSON_GetObjectItem(root, "rules");
+        cJSON* rule = NULL;
+        int changed = 0;
+        cJSON_ArrayForEach(rule, rules)
+        {
+            int entered = crossing_index_of(cJSON_GetStringValue(cJSON_GetObjectItem(rule, "entered")), crossing_side_str, CROSSING_SIDES);
+            int exited = crossing_index_of(cJSON_GetStringValue(cJSON_GetObjectItem(rule, "exited")), crossing_side_str, CROSSING_SIDES);
+            int event = crossing_index_of(cJSON_GetStringValue(cJSON_GetObjectItem(rule, "event")), crossing_event_str, CROSSING_EVENT_TYPES);
+            cJSON* trusted = cJSON_GetObjectItem(rule, "trusted");
+            cJSON* inverted = cJSON_GetObjectItem(rule, "inverted");
+            int64_t reason;
+            if(entered < 0 || exited < 0 || event < 0 || !cJSON_IsBool(trusted) ||
+               !json_integer(cJSON_GetObjectItem(rule, "reason"), 0, UINT8_MAX, &reason))
+            {
+                ESP_LOGW(COMMS_TAG, "Invalid crossing rule, skipped");
+                continue;
+            }
+
+            crossing_rule_t value = {(uint8_t)event, (uint8_t)reason};
+            if(cJSON_IsBool(inverted))
+            {
+                detection->set_crossing_rule((detection_area_side_t)entered, (detection_area_side_t)exited, cJSON_IsTrue(trusted), cJSON_IsTrue(inverted), value);
+            }
+            else
+            {
+                detection->set_crossing_rule((detection_area_side_t)entered, (detection_area_side_t)exited, cJSON_IsTrue(trusted), false, value);
+                value.event = crossing_invert(value.event);
+                detection->set_crossing_rule((detection_area_side_t)entered, (detection_area_side_t)exited, cJSON_IsTrue(trusted), true, value);
+            }
+            changed++;
+        }
+        if(changed > 0) detection->save_crossing_table();
+        ESP_LOGI(COMMS_TAG, "%d crossing rules changed", changed);
+        cJSON_Delete(root);
+    }
+    else if(topic == "/classifier/get")
+    {
+        ESP_LOGI(COMMS_TAG, "Sending crossing rules to callback topic by Server command");
+        cJSON* root = cJSON_CreateObject();
+        cJSON* rules = cJSON_CreateArray();
+        for(int entered=0; entered<CROSSING_SIDES; entered++)
+        {
+            for(int exited=0; exited<CROSSING_SIDES; exited++)
+            {
+                for(int trusted=0; trusted<2; trusted++)
+                {
+                    for(int inverted=0; inverted<2; inverted++)
+                    {
+                        crossing_rule_t value = detection->get_crossing_rule(
+                            (detection_area_side_t)entered, (detection_area_side_t)exited, trusted, inverted
+                        );
+                        cJSON* item = cJSON_CreateObject();
+                        cJSON_AddItemToObject(item, "entered", cJSON_CreateString(crossing_side_str[entered]));
+                        cJSON_AddItemToObject(item, "exited", cJSON_CreateString(crossing_side_str[exited]));
+                        cJSON_AddItemToObject(item, "trusted", cJSON_CreateBool(trusted));
+                        cJSON_AddItemToObject(item, "inverted", cJSON_CreateBool(inverted));
+                        cJSON_AddItemToObject(item, "event", cJSON_CreateString(crossing_event_str[value.event]));
+                        cJSON_AddItemToObject(item, "reason", cJSON_CreateNumber(value.reason));
+                        cJSON_AddItemToArray(rules, item);
+                    }
+                }
+            }
+        }
+        cJSON_AddItemToObject(root, "rules", rules);
+        char* data = cJSON_PrintUnformatted(root);
         mqtt->publish(
             sensor->get_mqtt_callback_topic().c_str(),
             data
         );
+        cJSON_free(data);
         cJSON_Delete(root);
     }
+    else if(topic == "/classifier/reset")
+    {
+        ESP_LOGI(COMMS_TAG, "Restoring the default crossing rules by Server command");
+        detection->reset_crossing_table();
+    }
     else
     {
         ESP_LOGE(COMMS_TAG, "Invalid command");
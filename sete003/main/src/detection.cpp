@@ -2,40 +2,81 @@
 #include "pir.hpp"
 #include "mqtt.hpp"
 #include "storage.hpp"
+#include "clock.hpp"
 
 #include <esp_timer.h>
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "math.h"
-#include "cJSON.h"
+#include <time.h>
 
 #ifndef MAX_TARGETS_DETECTION
 #define MAX_TARGETS_DETECTION 5
 #endif
 
-#define POINT_D0 0  // Top left corner
-#define POINT_D1 1  // Bottom left corner
-#define POINT_D2 2  // Bottom right corner
-#define POINT_D3 3  // Top right corner
-#define VEC_D0D1 0  // Left face (Vector D0-D1)
-#define VEC_D1D2 1  // Bottom face (Vector D1-D2)
-#define VEC_D2D3 2  // Right face (Vector D2-D3)
-#define VEC_D3D4 3  // Top face (Vector D3-D0)
-
-#define POINT_S0 0  // Detection threshold line start
-#define POINT_S1 1  // Detection threshold line end
-
-#define DETECTION_AREA 0
-#define DETECTION_SEGMENT 1
-
 // Global Variables (plis get rid of those)
 extern Storage* storage;
-extern LD2461* ld2461;
+extern LD2461* radars[MAX_RADARS];
+extern uint8_t radars_count;
 extern PIR* pir;
 extern MQTT* mqtt;
 extern Sensor* sensor;
 
 const char* DETECTION_TAG = "DETECTION";
 
+// Zones as saved in NVS
+typedef struct zone_store{
+    uint8_t count;
+    zone_config_t zone[MAX_ZONES];
+}zone_store_t;
+
+#define ZONE_LIMIT_DECIMETERS 1000  // Zones are clamped to 100 meters around the origin, the integer products can not overflow
+
+static int16_t meters_to_decimeters(float meters)
+{
+    float decimeters = roundf(meters * 10);
+    if(decimeters > ZONE_LIMIT_DECIMETERS) return ZONE_LIMIT_DECIMETERS;
+    if(decimeters < -ZONE_LIMIT_DECIMETERS) return -ZONE_LIMIT_DECIMETERS;
+    return (int16_t)decimeters;
+}
+
+static dm_point_t point_to_decimeters(point_t point)
+{
+    return {meters_to_decimeters(point.x), meters_to_decimeters(point.y)};
+}
+
+static float decimeters_to_meters(int16_t decimeters)
+{
+    return (float)decimeters / 10;
+}
+
+static int lut_cell(const zone_lut_t* lut, dm_point_t point)
+{
+    if(lut->cells == NULL) return -1;
+    uint32_t x = (uint32_t)(point.x - lut->min_x);  // Points left of / below the table wrap around and fail the bound checks
+    uint32_t y = (uint32_t)(point.y - lut->min_y);
+    if(x >= lut->width || y >= lut->height) return -1;
+    uint32_t index = (y * lut->width) + x;
+    return (lut->cells[index >> 1] >> ((index & 1) << 2)) & 0x0F;
+}
+
+static zone_config_t quad_zone(point_t D0, point_t D1, point_t D2, point_t D3, point_t S0, point_t S1)
+{
+    zone_config_t config = {};
+    config.vertex_count = 4;
+    config.vertex[0] = D0;
+    config.vertex[1] = D1;
+    config.vertex[2] = D2;
+    config.vertex[3] = D3;
+    config.edge_side[0] = LEFT;     // D0-D1
+    config.edge_side[1] = TOP;      // D1-D2
+    config.edge_side[2] = RIGHT;    // D2-D3
+    config.edge_side[3] = BOTTOM;   // D3-D0
+    config.line[0] = S0;
+    config.line[1] = S1;
+    return config;
+}
+
 Detection::Detection(
         point_t D0,
         point_t D1,
@@ -46,62 +87,180 @@ Detection::Detection(
         bool enter_exit_inverted
     )
 {
-    entered_detections = 0;
-    exited_detections = 0;
-    gave_up_detections = 0;
+    memset(event_counters, 0, sizeof(event_counters));
+    this->task_handle = NULL;
+    this->tick_timer = NULL;
+    this->publish_timer = NULL;
+    this->latency = {};
+    this->event_buffer_head = 0;
+    this->event_buffer_count = 0;
+    this->event_buffer_dropped = 0;
+    this->settings_lock = portMUX_INITIALIZER_UNLOCKED;
+    this->settings = {};
+    if(!storage->get_blob(SENSOR_BASIC_DATA, "CROSSING_TABLE", &settings.crossing_table, sizeof(settings.crossing_table)))
+    {
+        settings.crossing_table = CROSSING_DEFAULT_TABLE;
+    }
+    else if(!crossing_table_valid(settings.crossing_table))
+    {
+        // Saved by a firmware with other events, its rules can not be trusted (nor used as an index)
+        ESP_LOGW(DETECTION_TAG, "Stored crossing table has unknown events, using the default one");
+        settings.crossing_table = CROSSING_DEFAULT_TABLE;
+    }
 
-    this->enter_exit_inverted = enter_exit_inverted;
+    settings.enter_exit_inverted = enter_exit_inverted;
+    memset(zones, 0, sizeof(zones));
+    this->zone_count = 0;
+    this->lut_bytes = 0;
 
-    // Detection Area Points
-    detection_area.D[0] = D0;
-    detection_area.D[1] = D1;
-    detection_area.D[2] = D2;
-    detection_area.D[3] = D3;
+    for(int i=0; i<MAX_WORLD_TARGETS; i++){
+        targets_previous[i] = {0, 0};
+        targets[i] = {};
+    }
+
+    // Zones saved by /detection_area/set, otherwise the detection area is the only zone
+    zone_store_t* store = (zone_store_t*)malloc(sizeof(zone_store_t));
+    if(store != NULL &&
+       storage->get_blob(SENSOR_BASIC_DATA, "ZONES", store, sizeof(zone_store_t)) &&
+       store->count > 0 && store->count <= MAX_ZONES)
+    {
+        settings.zone_count = store->count;
+        memcpy(settings.zones, store->zone, sizeof(settings.zones));
+        ESP_LOGI(DETECTION_TAG, "Using %u stored detection zones", settings.zone_count);
+    }
+    else
+    {
+        settings.zone_count = 1;
+        settings.zones[0] = quad_zone(D0, D1, D2, D3, S0, S1);
+    }
+    free(store);
 
-    // Detection Area Faces
-    detection_area.F[0] = {D1.x - D0.x, D1.y - D0.y};
-    detection_area.F[1] = {D2.x - D1.x, D2.y - D1.y};
-    detection_area.F[2] = {D3.x - D2.x, D3.y - D2.y};
-    detection_area.F[3] = {D0.x - D3.x, D0.y - D3.y};
+    bool raw_data = storage->get_uint8(SENSOR_BASIC_DATA, "SEND_RAW_DATA");
+    if(raw_data == 0) raw_data = false;
+    else this->send_raw_detection_payload = raw_data;
+    ESP_LOGI("DETECTION", "Sending Raw Data?: %s", raw_data ? "true" : "false");
+
+    settings.counting_mode = (storage->get_uint8(SENSOR_BASIC_DATA, "COUNT_MODE") == COUNTING_LINE) ? COUNTING_LINE : COUNTING_AREA;
+    ESP_LOGI(DETECTION_TAG, "Counting by the %s", (settings.counting_mode == COUNTING_LINE) ? "counting line" : "zone sides");
 
-    // Detection Area Segment Length
-    detection_area.F_D[0] = sqrt(((D1.x * D1.x) - (D0.x * D0.x)) + ((D1.y * D1.y) - (D0.y * D0.y)));
-    detection_area.F_D[1] = sqrt(((D2.x * D2.x) - (D1.x * D1.x)) + ((D2.y * D2.y) - (D1.y * D1.y)));
-    detection_area.F_D[2] = sqrt(((D3.x * D3.x) - (D2.x * D2.x)) + ((D3.y * D3.y) - (D2.y * D2.y)));
-    detection_area.F_D[3] = sqrt(((D0.x * D0.x) - (D3.x * D3.x)) + ((D0.y * D0.y) - (D3.y * D3.y)));
+    // Occupancy starts empty, it is not worth a flash write on every person
+    if(!storage->get_blob(SENSOR_BASIC_DATA, "OCCUPANCY", &settings.occupancy_config, sizeof(settings.occupancy_config)))
+    {
+        settings.occupancy_config = {0, -1, 3600};
+    }
+    settings.occupancy = 0;
+    this->last_presence_time = system_clock->now();
+    this->last_reset_day = -1;
+    this->published_occupancy = -1;
+    this->last_occupancy_publish = 0;
+    this->occupancy_corrections = 0;
 
-    // Detection Line (Segment) Points
-    detection_area.S[0] = S0;
-    detection_area.S[1] = S1;
+    settings.min_crossing_speed = storage->get_uint32(SENSOR_BASIC_DATA, "MIN_SPEED");
+    memset(speed_histogram, 0, sizeof(speed_histogram));
+    this->slow_crossings = 0;
 
-    // Detection Line (Segment) Vector
-    detection_area.L = {S1.x - S0.x, S1.y - S0.y};
+    // No task yet, the whole counting state is built here
+    this->settings_changed = 0;
+    this->settings_updated(DETECTION_SETTING_ALL);
+}
 
-    // Detection Line (Segment) Length
-    detection_area.L_D = sqrt(((S1.x * S1.x) - (S0.x * S0.x)) + ((S1.y * S1.y) - (S0.y * S0.y)));
+Detection::~Detection()
+{
+    for(int zone=0; zone<MAX_ZONES; zone++) free_lut(&zones[zone]);
+}
 
-    for(int i=0; i<MAX_TARGETS_DETECTION; i++){
-        targets[i].current_position = {0, 0};
-        targets[i].entered_position = {0, 0};
-        targets[i].exited_position = {0, 0};
-        targets[i].traversed = false;
-        targets[i].entered_side = NONE;
-        targets[i].exited_side = NONE;
+void Detection::build_zone(const zone_config_t* config, detection_zone_t* zone)
+{
+    // Rounded to the radar resolution once, everything after runs on integers
+    zone->config = *config;
+    for(int i=0; i<config->vertex_count; i++)
+    {
+        dm_point_t a = point_to_decimeters(config->vertex[i]);
+        dm_point_t b = point_to_decimeters(config->vertex[(i + 1) % config->vertex_count]);
+        zone_edge_t* edge = &zone->edge[i];
+        edge->origin = a;
+        edge->delta = {(int16_t)(b.x - a.x), (int16_t)(b.y - a.y)};
+        edge->length_sq = ((int32_t)edge->delta.x * edge->delta.x) + ((int32_t)edge->delta.y * edge->delta.y);
     }
 
-    bool raw_data = storage->get_uint8(SENSOR_BASIC_DATA, "SEND_RAW_DATA");
-    if(raw_data == 0) raw_data = false;
-    else this->send_raw_detection_payload = raw_data;
-    ESP_LOGI("DETECTION", "Sending Raw Data?: %s", raw_data ? "true" : "false");
+    dm_point_t S0 = point_to_decimeters(config->line[0]);
+    dm_point_t S1 = point_to_decimeters(config->line[1]);
+    zone->line_origin = S0;
+    zone->line_delta = {(int16_t)(S1.x - S0.x), (int16_t)(S1.y - S0.y)};
+    zone->line_length = lroundf(sqrtf(((float)zone->line_delta.x * zone->line_delta.x) + ((float)zone->line_delta.y * zone->line_delta.y)));
+}
+
+void Detection::apply_zone(uint8_t index, const zone_config_t* config)
+{
+    detection_zone_t* zone = &zones[index];
+    if(zone->lut.cells != NULL && memcmp(&zone->config, config, sizeof(zone_config_t)) == 0) return;
+    free_lut(zone);
+    build_zone(config, zone);
+    build_lut(zone);
+}
+
+void Detection::free_lut(detection_zone_t* zone)
+{
+    if(zone->lut.cells == NULL) return;
+    lut_bytes -= (((size_t)zone->lut.width * zone->lut.height) + 1) / 2;
+    heap_caps_free(zone->lut.cells);
+    zone->lut = {};
+}
+
+void Detection::build_lut(detection_zone_t* zone)
+{
+    // Bounding box of the zone and its margin, only int8 positions are ever looked up
+    int32_t min_x = INT8_MAX, max_x = INT8_MIN, min_y = INT8_MAX, max_y = INT8_MIN;
+    for(int i=0; i<zone->config.vertex_count; i++)
+    {
+        if(zone->edge[i].origin.x < min_x) min_x = zone->edge[i].origin.x;
+        if(zone->edge[i].origin.x > max_x) max_x = zone->edge[i].origin.x;
+        if(zone->edge[i].origin.y < min_y) min_y = zone->edge[i].origin.y;
+        if(zone->edge[i].origin.y > max_y) max_y = zone->edge[i].origin.y;
+    }
+    min_x = (min_x - ZONE_LUT_MARGIN_DECIMETERS < INT8_MIN) ? INT8_MIN : min_x - ZONE_LUT_MARGIN_DECIMETERS;
+    min_y = (min_y - ZONE_LUT_MARGIN_DECIMETERS < INT8_MIN) ? INT8_MIN : min_y - ZONE_LUT_MARGIN_DECIMETERS;
+    max_x = (max_x + ZONE_LUT_MARGIN_DECIMETERS > INT8_MAX) ? INT8_MAX : max_x + ZONE_LUT_MARGIN_DECIMETERS;
+    max_y = (max_y + ZONE_LUT_MARGIN_DECIMETERS > INT8_MAX) ? INT8_MAX : max_y + ZONE_LUT_MARGIN_DECIMETERS;
+    if(min_x > max_x || min_y > max_y) return; // Zone out of the radar range
+
+    uint16_t width = max_x - min_x + 1;
+    uint16_t height = max_y - min_y + 1;
+    size_t bytes = (((size_t)width * height) + 1) / 2;
+    if(lut_bytes + bytes > ZONE_LUT_BUDGET_BYTES)
+    {
+        ESP_LOGW(DETECTION_TAG, "Zone lookup table of %u bytes does not fit in the budget (%u of %u used), using the exact geometry",
+            (unsigned)bytes, (unsigned)lut_bytes, (unsigned)ZONE_LUT_BUDGET_BYTES);
+        return;
+    }
+    uint8_t* cells = (uint8_t*)heap_caps_calloc(bytes, 1, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if(cells == NULL)
+    {
+        ESP_LOGW(DETECTION_TAG, "No internal RAM for a zone lookup table of %u bytes, using the exact geometry", (unsigned)bytes);
+        return;
+    }
+
+    for(uint32_t y=0; y<height; y++)
+    {
+        for(uint32_t x=0; x<width; x++)
+        {
+            dm_point_t point = {(int16_t)(min_x + x), (int16_t)(min_y + y)};
+            uint8_t cell = _nearest_side(zone, point);
+            if(_is_target_in_polygon(zone, point)) cell |= ZONE_LUT_INSIDE;
+            uint32_t index = (y * width) + x;
+            cells[index >> 1] |= cell << ((index & 1) << 2);
+        }
+    }
+    zone->lut = {cells, (int16_t)min_x, (int16_t)min_y, width, height};
+    lut_bytes += bytes;
 }
 
-const char* detection_area_side_str[] = {
-    "LEFT",
-    "BOTTOM",
-    "RIGHT",
-    "TOP",
-    "NONE"
-};
+void Detection::clear_zone_target(zone_target_t* target)
+{
+    *target = {};
+    target->entered_side = NONE;
+    target->exited_side = NONE;
+}
 
 void Detection::set_detection_area(
         point_t D0,
@@ -112,35 +271,10 @@ void Detection::set_detection_area(
         point_t S1
     )
 {
+    zone_config_t config = quad_zone(D0, D1, D2, D3, S0, S1);
+    this->set_zones(&config, 1);
 
-    // Detection Area Points
-    detection_area.D[0] = D0;
-    detection_area.D[1] = D1;
-    detection_area.D[2] = D2;
-    detection_area.D[3] = D3;
-
-    // Detection Area Faces
-    detection_area.F[0] = {D1.x - D0.x, D1.y - D0.y};
-    detection_area.F[1] = {D2.x - D1.x, D2.y - D1.y};
-    detection_area.F[2] = {D3.x - D2.x, D3.y - D2.y};
-    detection_area.F[3] = {D0.x - D3.x, D0.y - D3.y};
-
-    // Detection Area Segment Length
-    detection_area.F_D[0] = sqrt(((D1.x * D1.x) - (D0.x * D0.x)) + ((D1.y * D1.y) - (D0.y * D0.y)));
-    detection_area.F_D[1] = sqrt(((D2.x * D2.x) - (D1.x * D1.x)) + ((D2.y * D2.y) - (D1.y * D1.y)));
-    detection_area.F_D[2] = sqrt(((D3.x * D3.x) - (D2.x * D2.x)) + ((D3.y * D3.y) - (D2.y * D2.y)));
-    detection_area.F_D[3] = sqrt(((D0.x * D0.x) - (D3.x * D3.x)) + ((D0.y * D0.y) - (D3.y * D3.y)));
-
-    // Detection Line (Segment) Points
-    detection_area.S[0] = S0;
-    detection_area.S[1] = S1;
-
-    // Detection Line (Segment) Vector
-    detection_area.L = {S1.x - S0.x, S1.y - S0.y};
-
-    // Detection Line (Segment) Length
-    detection_area.L_D = sqrt(((S1.x * S1.x) - (S0.x * S0.x)) + ((S1.y * S1.y) - (S0.y * S0.y)));
-
+    // Kept for firmwares that only know the detection area
     storage->store_data_str(SENSOR_BASIC_DATA, "LD2461_D0_X", std::to_string(D0.x).c_str());
     storage->store_data_str(SENSOR_BASIC_DATA, "LD2461_D0_Y", std::to_string(D0.y).c_str());
 
@@ -169,477 +303,935 @@ void Detection::set_detection_area(
     );
 }
 
-point* Detection::get_detection_area_point()
+bool Detection::set_zones(const zone_config_t* configs, uint8_t count)
 {
-    return detection_area.D;
+    if(count == 0 || count > MAX_ZONES) return false;
+    for(int zone=0; zone<count; zone++)
+    {
+        if(configs[zone].vertex_count < 3 || configs[zone].vertex_count > ZONE_MAX_VERTICES) return false;
+        for(int i=0; i<configs[zone].vertex_count; i++)
+        {
+            if(configs[zone].edge_side[i] > NONE) return false;
+        }
+    }
+
+    zone_store_t* store = (zone_store_t*)calloc(1, sizeof(zone_store_t));
+    if(store == NULL) return false;
+    store->count = count;
+    memcpy(store->zone, configs, count * sizeof(zone_config_t));
+
+    taskENTER_CRITICAL(&settings_lock);
+    settings.zone_count = count;
+    memcpy(settings.zones, configs, count * sizeof(zone_config_t));
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_ZONES);
+
+    storage->store_data_blob(SENSOR_BASIC_DATA, "ZONES", store, sizeof(zone_store_t));
+    free(store);
+    return true;
 }
 
-detection_area_t Detection::get_detection_area()
+uint8_t Detection::get_zones(zone_config_t* configs)
 {
-    return detection_area;
+    taskENTER_CRITICAL(&settings_lock);
+    uint8_t count = settings.zone_count;
+    memcpy(configs, settings.zones, count * sizeof(zone_config_t));
+    taskEXIT_CRITICAL(&settings_lock);
+    return count;
 }
 
-std::pair<bool, float> Detection::_pre_calc_vector_product_area(
-    uint8_t vecAB_index,
-    uint8_t pointA_index,
-    point_t pointC)
+std::pair<int8_t, int32_t> Detection::_line_side(const detection_zone_t* zone, dm_point_t point)
 {
-    //if (detection_area.F_D[vecAB_index] == 0) return std::pair<bool, float>(false, 0);
-    float result = (
-        detection_area.F[vecAB_index].x * (pointC.y - detection_area.D[pointA_index].y) -
-        detection_area.F[vecAB_index].y * (pointC.x - detection_area.D[pointA_index].x)
-    );
-    //result = result / detection_area.F_D[vecAB_index];
-    return std::pair<bool, float>(result >= 0, result);
+    // Cross product of the line and the point, points on the left of S0 -> S1 are on the positive side
+    if(zone->line_delta.x == 0 && zone->line_delta.y == 0) return std::pair<int8_t, int32_t>(0, 0);
+    int32_t result = ((int32_t)zone->line_delta.x * (point.y - zone->line_origin.y)) -
+                     ((int32_t)zone->line_delta.y * (point.x - zone->line_origin.x));
+    int32_t dead_band = COUNTING_LINE_DEAD_BAND * zone->line_length;    // The result is the distance times the line length
+    int8_t side = (result > dead_band) ? 1 : (result < -dead_band) ? -1 : 0;
+    return std::pair<int8_t, int32_t>(side, result);
 }
 
-std::pair<bool, float> Detection::_pre_calc_vector_product_segment(point_t pointC)
+bool Detection::_is_target_in_zone(const detection_zone_t* zone, dm_point_t point)
 {
-    if (detection_area.L_D == 0) return std::pair<bool, float>(false, 0);
-    float result = (
-        detection_area.L.x * (pointC.y - detection_area.S[0].y) -
-        detection_area.L.y * (pointC.x - detection_area.S[0].x)
-    );
-    result = result / detection_area.L_D;
-    return std::pair<bool, float>(result >= 0, result);
+    int cell = lut_cell(&zone->lut, point);
+    if(cell >= 0) return (cell & ZONE_LUT_INSIDE) != 0;
+    return _is_target_in_polygon(zone, point);
 }
 
-bool Detection::_is_target_in_detection_area(point_t point_target)
+bool Detection::_is_target_in_polygon(const detection_zone_t* zone, dm_point_t point)
 {
-    return _pre_calc_vector_product_area(VEC_D0D1, POINT_D0, point_target).first &&
-           _pre_calc_vector_product_area(VEC_D1D2, POINT_D1, point_target).first &&
-           _pre_calc_vector_product_area(VEC_D2D3, POINT_D2, point_target).first &&
-           _pre_calc_vector_product_area(VEC_D3D4, POINT_D3, point_target).first;
+    // Crossing number, a ray to the right of the point crosses the edges an odd number of times if it is inside
+    bool inside = false;
+    for(int i=0; i<zone->config.vertex_count; i++)
+    {
+        const zone_edge_t* edge = &zone->edge[i];
+        int32_t start_y = edge->origin.y;
+        int32_t end_y = start_y + edge->delta.y;
+        if((start_y > point.y) == (end_y > point.y)) continue;
+
+        // point.x < origin.x + (point.y - origin.y) * delta.x / delta.y, without the division
+        int32_t left = (int32_t)(point.x - edge->origin.x) * edge->delta.y;
+        int32_t right = (int32_t)(point.y - edge->origin.y) * edge->delta.x;
+        if((edge->delta.y > 0) ? (left < right) : (left > right)) inside = !inside;
+    }
+    return inside;
 }
 
-bool Detection::check_if_detected(uint8_t target_index)
+bool Detection::check_if_detected(uint8_t zone, uint8_t target_index)
 {
-    bool was_in_detection_area = _is_target_in_detection_area(targets_previous[target_index]);                          // Check if the target was in the detection area
-    bool is_in_detection_area = _is_target_in_detection_area(targets[target_index].current_position);                   // Check if the target is in the detection area
+    zone_target_t* target = &zone_targets[zone][target_index];
+    bool was_in_detection_area = _is_target_in_zone(&zones[zone], targets_previous[target_index]);                      // Check if the target was in the detection area
+    bool is_in_detection_area = _is_target_in_zone(&zones[zone], targets[target_index].current_position);               // Check if the target is in the detection area
 
     if (!was_in_detection_area && is_in_detection_area) { // Target entered detection area
         // Target entered in detection area
         //ESP_LOGI(DETECTION_TAG, "Target %u entered the detection area", target_index);
-        targets[target_index].previous_position = targets_previous[target_index];                                       // Save the previous position
-        targets[target_index].entered_position = targets[target_index].current_position;                                // Save the entry point
-        auto [line_side, distance] = _pre_calc_vector_product_segment(targets[target_index].current_position);          // Calculate the side and distance from the detection line
-        targets[target_index].line_side = line_side;                                                                    // Save the side of the detection line
-        targets[target_index].previous_distance = distance;                                                             // Save the distance from the detection line
-        targets[target_index].entered_side = get_crossed_side(targets[target_index].current_position);                  // Save the side where the target entered
+        target->previous_position = targets_previous[target_index];                                                     // Save the previous position
+        target->entered_position = targets[target_index].current_position;                                              // Save the entry point
+        target->entered_time = targets[target_index].timestamp;                                                         // Save the entry time
+        auto [line_side, distance] = _line_side(&zones[zone], targets[target_index].current_position);                  // Calculate the side and distance from the detection line
+        target->line_side = line_side;                                                                                  // Save the side of the detection line
+        target->previous_distance = distance;                                                                           // Save the distance from the detection line
+        target->entered_side = get_crossed_side(zone, targets[target_index].current_position);                          // Save the side where the target entered
         if(targets_previous[target_index].x == 0 && targets_previous[target_index].y == 0){                             // If the previous point is (0, 0) the vector is trusted
-            targets[target_index].trusted_vector = 0; 
+            target->trusted_vector = 0; 
         }
-        else targets[target_index].trusted_vector = 1;
+        else target->trusted_vector = 1;
         return true;
     }
     else if (was_in_detection_area && !is_in_detection_area) { // Target exited detection area                                                   
         // Target exited detection area
         //ESP_LOGI(DETECTION_TAG, "Target %u exited the detection area", target_index);
-        targets[target_index].exited_position = targets[target_index].current_position;                                 // Save the exit point
-        targets[target_index].exited_side = get_crossed_side(targets[target_index].current_position);                   // Save the side where the target exited
-        targets[target_index].traversed = true;                                                                         // Flag the target as traversed
+        target->exited_position = targets[target_index].current_position;                                               // Save the exit point
+        target->exited_time = targets[target_index].timestamp;                                                          // Save the exit time
+        target->exited_side = get_crossed_side(zone, targets[target_index].current_position);                           // Save the side where the target exited
+        target->traversed = true;                                                                                       // Flag the target as traversed
         return false;
     } 
     else if (was_in_detection_area && is_in_detection_area) { // Target is still in detection area
         // Target is still in detection area
-        //auto [line_side, distance] = _pre_calc_vector_product_segment(targets[target_index].current_position);
-        //if (line_side * targets[target_index].line_side >= 0) {
+        //auto [line_side, distance] = _line_side(&zones[zone], targets[target_index].current_position);
+        //if (line_side * target->line_side >= 0) {
         //    // Target crossed the detection line
-        //    targets[target_index].detection_segment_crossed_position = targets[target_index].current_position;
+        //    target->detection_segment_crossed_position = targets[target_index].current_position;
         //}
-        //targets[target_index].line_side = line_side;
-        //targets[target_index].previous_distance = distance;
+        //target->line_side = line_side;
+        //target->previous_distance = distance;
         return true;
     }
     return false;
 }
 
-detection_area_side Detection::get_crossed_side(point_t point)
+static int8_t meters_to_radar(float meters)
 {
-    float min = 10; // This value needs to be higher than the maximum value of the vector product to work
-    detection_area_side_t side = NONE;
+    float decimeters = roundf(meters * 10);
+    if(decimeters > INT8_MAX) return INT8_MAX;
+    if(decimeters < INT8_MIN) return INT8_MIN;
+    return (int8_t)decimeters;
+}
 
-    float a = _pre_calc_vector_product_area(VEC_D0D1, POINT_D0, point).second; // Left
-    float b = _pre_calc_vector_product_area(VEC_D1D2, POINT_D1, point).second; // Top
-    float c = _pre_calc_vector_product_area(VEC_D2D3, POINT_D2, point).second; // Right
-    float d = _pre_calc_vector_product_area(VEC_D3D4, POINT_D3, point).second; // Bottom
+ld2461_zone_filter_t Detection::get_radar_zone(float margin, LD2461* radar)
+{
+    // Bounding box of every zone, widened by the margin (the zones as set, the task may not have applied them yet)
+    zone_config_t configs[MAX_ZONES];
+    uint8_t count = get_zones(configs);
+    float world_min_x = configs[0].vertex[0].x, world_max_x = world_min_x;
+    float world_min_y = configs[0].vertex[0].y, world_max_y = world_min_y;
+    for(int zone=0; zone<count; zone++)
+    {
+        for(int i=0; i<configs[zone].vertex_count; i++)
+        {
+            world_min_x = fminf(world_min_x, configs[zone].vertex[i].x);
+            world_max_x = fmaxf(world_max_x, configs[zone].vertex[i].x);
+            world_min_y = fminf(world_min_y, configs[zone].vertex[i].y);
+            world_max_y = fmaxf(world_max_y, configs[zone].vertex[i].y);
+        }
+    }
+    point_t world[4] = {
+        {world_min_x - margin, world_max_y + margin},
+        {world_min_x - margin, world_min_y - margin},
+        {world_max_x + margin, world_min_y - margin},
+        {world_max_x + margin, world_max_y + margin}
+    };
 
-    if(a <= min) {min = a; side = LEFT;}
-    if(b < min ) {min = b; side = TOP;}
-    if(c < min ) {min = c; side = RIGHT;}
-    if(d < min ) {min = d; side = BOTTOM;}
+    // Corners moved to the radar coordinates
+    point_t corners[4];
+    for(int i=0; i<4; i++)
+    {
+        radar->world_to_radar(world[i].x, world[i].y, &corners[i].x, &corners[i].y);
+    }
+
+    float min_x = corners[0].x, max_x = corners[0].x;
+    float min_y = corners[0].y, max_y = corners[0].y;
+    for(int i=1; i<4; i++)
+    {
+        min_x = fminf(min_x, corners[i].x); max_x = fmaxf(max_x, corners[i].x);
+        min_y = fminf(min_y, corners[i].y); max_y = fmaxf(max_y, corners[i].y);
+    }
+    if(min_y < 0) min_y = 0; // Nothing is detected behind the radar
+
+    ld2461_zone_filter_t filter = {};
+    filter.mode = LD2461_ZONE_DETECT_ONLY;
+    filter.zone[0][0] = {meters_to_radar(min_x), meters_to_radar(max_y)};   // Same order as D0..D3
+    filter.zone[0][1] = {meters_to_radar(min_x), meters_to_radar(min_y)};
+    filter.zone[0][2] = {meters_to_radar(max_x), meters_to_radar(min_y)};
+    filter.zone[0][3] = {meters_to_radar(max_x), meters_to_radar(max_y)};
+    return filter;
+}
+
+bool Detection::sync_radar_zone()
+{
+    bool applied = true;
+    for(int radar=0; radar<radars_count; radar++)
+    {
+        ld2461_zone_filter_t filter = get_radar_zone(RADAR_ZONE_MARGIN_METERS, radars[radar]);
+        applied &= radars[radar]->apply_zone_filter(&filter);
+    }
+    return applied;
+}
 
+detection_area_side Detection::get_crossed_side(uint8_t zone, dm_point_t point)
+{
+    int cell = lut_cell(&zones[zone].lut, point);
+    if(cell >= 0) return (detection_area_side_t)(cell & ~ZONE_LUT_INSIDE);
+    return _nearest_side(&zones[zone], point);
+}
+
+detection_area_side_t Detection::_nearest_side(const detection_zone_t* zone, dm_point_t point)
+{
+    // Closest edge, by the squared distance to the edge segment kept as a fraction (numerator / denominator)
+    int64_t min_numerator = INT64_MAX, min_denominator = 1;
+    detection_area_side_t side = NONE;
+    for(int i=0; i<zone->config.vertex_count; i++)
+    {
+        const zone_edge_t* edge = &zone->edge[i];
+        int32_t dx = point.x - edge->origin.x;
+        int32_t dy = point.y - edge->origin.y;
+        int32_t projection = (dx * edge->delta.x) + (dy * edge->delta.y);
+        int64_t numerator, denominator = 1;
+        if(projection <= 0 || edge->length_sq == 0)
+        {
+            numerator = ((int64_t)dx * dx) + ((int64_t)dy * dy);                // Closest to the start
+        }
+        else if(projection >= edge->length_sq)
+        {
+            int64_t ex = dx - edge->delta.x, ey = dy - edge->delta.y;
+            numerator = (ex * ex) + (ey * ey);                                  // Closest to the end
+        }
+        else
+        {
+            int64_t cross = ((int64_t)dx * edge->delta.y) - ((int64_t)dy * edge->delta.x);
+            numerator = cross * cross;                                          // Perpendicular distance
+            denominator = edge->length_sq;
+        }
+        if(min_numerator == INT64_MAX || numerator * min_denominator < min_numerator * denominator)
+        {
+            min_numerator = numerator;
+            min_denominator = denominator;
+            side = (detection_area_side_t)zone->config.edge_side[i];
+        }
+    }
     return side;
 }
 
-void Detection::update_targets(ld2461_detection_t* report)
+void Detection::update_targets(ld2461_detection_t* report, uint8_t radar)
 {
+    target_t* radar_targets = &targets[radar * MAX_TARGETS_DETECTION];
+    dm_point_t* radar_targets_previous = &targets_previous[radar * MAX_TARGETS_DETECTION];
     for(int i=0; i<MAX_TARGETS_DETECTION; i++)
     {
+        if(report->track_id[i] != radar_targets[i].track_id)
+        {
+            // Another person took the slot, nothing of the previous track applies to it
+            radar_targets[i].track_id = report->track_id[i];
+            radar_targets[i].current_position = {0, 0};
+            radar_targets[i].trajectory_count = 0;
+            radar_targets[i].velocity_x = 0;
+            radar_targets[i].velocity_y = 0;
+            for(int zone=0; zone<zone_count; zone++)
+            {
+                clear_zone_target(&zone_targets[zone][radar * MAX_TARGETS_DETECTION + i]);
+            }
+        }
         if(report->is_target_available[i] != 1) 
         {
-            targets[i].current_position = {0, 0};
-            targets_previous[i] = {0, 0};
+            if(radar_targets[i].track_id != 0)
+            {
+                // The track missed this report, hold its last position (and its time) until it is seen again
+                radar_targets_previous[i] = radar_targets[i].current_position;
+                radar_targets[i].previous_timestamp = radar_targets[i].timestamp;
+                continue;
+            }
+            radar_targets[i].current_position = {0, 0};
+            radar_targets[i].timestamp = report->timestamp;
+            radar_targets[i].trajectory_count = 0;
+            radar_targets_previous[i] = {0, 0};
             continue;
         }
-        targets_previous[i] = targets[i].current_position;
+        radar_targets_previous[i] = radar_targets[i].current_position;
+        radar_targets[i].previous_timestamp = radar_targets[i].timestamp;
+        radar_targets[i].current_position = {report->target[i].x, report->target[i].y};
+        radar_targets[i].timestamp = report->timestamp;
+
+        target_t* target = &radar_targets[i];
+        target->trajectory[target->trajectory_head] = target->current_position;
+        target->trajectory_time[target->trajectory_head] = target->timestamp;
+        target->trajectory_head = (target->trajectory_head + 1) % TRAJECTORY_LENGTH;
+        if(target->trajectory_count < TRAJECTORY_LENGTH) target->trajectory_count++;
+        update_velocity(target);
     }
-    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+}
+
+void Detection::update_velocity(target_t* target)
+{
+    target->velocity_x = 0;
+    target->velocity_y = 0;
+    if(target->trajectory_count < 2) return;
+
+    // Least squares slope of x(t) and y(t), t in milliseconds from the newest position
+    int64_t n = target->trajectory_count;
+    int64_t sum_t = 0, sum_tt = 0, sum_x = 0, sum_y = 0, sum_tx = 0, sum_ty = 0;
+    for(int k=0; k<target->trajectory_count; k++)
     {
-        targets[i].current_position = {
-            (float)(int8_t)(report->target[i].x)/10,
-            (float)(int8_t)(report->target[i].y)/10
-        };
+        int index = (target->trajectory_head + TRAJECTORY_LENGTH - 1 - k) % TRAJECTORY_LENGTH;
+        int64_t t = (target->trajectory_time[index] - target->timestamp) / 1000;
+        int64_t x = target->trajectory[index].x;
+        int64_t y = target->trajectory[index].y;
+        sum_t += t; sum_tt += t * t;
+        sum_x += x; sum_y += y;
+        sum_tx += t * x; sum_ty += t * y;
     }
+    int64_t denominator = (n * sum_tt) - (sum_t * sum_t);
+    if(denominator <= 0) return;
+
+    // Decimeters per millisecond to centimeters per second
+    int64_t velocity_x = (((n * sum_tx) - (sum_t * sum_x)) * 10000) / denominator;
+    int64_t velocity_y = (((n * sum_ty) - (sum_t * sum_y)) * 10000) / denominator;
+    target->velocity_x = (velocity_x > INT16_MAX) ? INT16_MAX : (velocity_x < -INT16_MAX) ? -INT16_MAX : velocity_x;
+    target->velocity_y = (velocity_y > INT16_MAX) ? INT16_MAX : (velocity_y < -INT16_MAX) ? -INT16_MAX : velocity_y;
 }
 
-void Detection::count_detections(int target_index)
+uint16_t Detection::crossing_speed(uint8_t zone, int target_index)
 {
-    if(targets[target_index].traversed == false) return;
-    if(targets[target_index].entered_side == NONE || targets[target_index].exited_side == NONE) return;
+    int64_t velocity_x = targets[target_index].velocity_x;
+    int64_t velocity_y = targets[target_index].velocity_y;
+    int64_t speed;
+    if(zones[zone].line_length == 0)
+    {
+        speed = lroundf(sqrtf((float)((velocity_x * velocity_x) + (velocity_y * velocity_y)))); // No line, any direction
+    }
+    else
+    {
+        // Component along the line normal
+        speed = ((zones[zone].line_delta.x * velocity_y) - (zones[zone].line_delta.y * velocity_x)) / zones[zone].line_length;
+        if(speed < 0) speed = -speed;
+    }
+    return (speed > UINT16_MAX) ? UINT16_MAX : speed;
+}
 
-    //TODO: Isolar a lógica das saídas ou entradas, dependendo da mais problemática
-    if(targets[target_index].trusted_vector == 0) 
+void Detection::gate_crossing_speed(crossing_event_t* event)
+{
+    if(event->rule.event == CROSSING_NONE || event->rule.event == CROSSING_UNDEFINED) return;
+    if(min_crossing_speed > 0 && event->speed < min_crossing_speed)
     {
-        ESP_LOGI(DETECTION_TAG, "Target %u previous point: (%.2f, %.2f) | entry point: (%.2f, %.2f) | exit point: (%.2f, %.2f) | entered side: %s | exited side: %s | [UNTRUSTED]",
-            target_index,
-            targets[target_index].previous_position.x,
-            targets[target_index].previous_position.y,
-            targets[target_index].entered_position.x,
-            targets[target_index].entered_position.y,
-            targets[target_index].exited_position.x,
-            targets[target_index].exited_position.y,
-            detection_area_side_str[targets[target_index].entered_side],
-            detection_area_side_str[targets[target_index].exited_side]
-        );
-        switch(targets[target_index].exited_side)
+        event->rule.event = CROSSING_NONE;
+        slow_crossings++;
+        return;
+    }
+    int bin = event->speed / SPEED_HISTOGRAM_BIN_WIDTH;
+    speed_histogram[(bin < SPEED_HISTOGRAM_BINS) ? bin : SPEED_HISTOGRAM_BINS - 1]++;
+}
+
+void Detection::remove_duplicated_targets(ld2461_detection_t* report, uint8_t radar)
+{
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        if(report->target[i].x == 0 && report->target[i].y == 0) continue;
+
+        // Only radars with a lower number are checked, so one of the copies is always kept
+        for(int j=0; j<radar * MAX_TARGETS_DETECTION; j++)
         {
-            case TOP:
-                if(!enter_exit_inverted)
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: #00",target_index);
-                }
-                else
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: #00!",target_index);
-                }
-                break;
-            case LEFT:
-                ESP_LOGW(DETECTION_TAG, "Target %u exited on LEFT but detection is not trusted | id: #10",target_index);
+            if(targets[j].current_position.x == 0 && targets[j].current_position.y == 0) continue;
+            if(report->timestamp - targets[j].timestamp > RADAR_DEDUP_MAX_AGE) continue;
+            int32_t dx = targets[j].current_position.x - report->target[i].x;
+            int32_t dy = targets[j].current_position.y - report->target[i].y;
+            if((dx * dx) + (dy * dy) < (RADAR_DEDUP_DISTANCE_DECIMETERS * RADAR_DEDUP_DISTANCE_DECIMETERS))
+            {
+                report->target[i] = {0, 0};
+                report->is_target_available[i] = LD2461_TARGET_UNAVAILABLE;
                 break;
-            case RIGHT:
-                ESP_LOGW(DETECTION_TAG, "Target %u exited on RIGHT but detection is not trusted | id: #11",target_index);
+            }
+        }
+    }
+}
+
+bool Detection::check_line_crossing(uint8_t zone, int target_index)
+{
+    zone_target_t* target = &zone_targets[zone][target_index];
+    dm_point_t to = targets[target_index].current_position;
+    if(to.x == 0 && to.y == 0) return false;
+    if(zones[zone].line_delta.x == 0 && zones[zone].line_delta.y == 0) return false;
+
+    // On the line the target keeps the side it came from, only a position off the dead band moves it
+    int8_t to_side = _line_side(&zones[zone], to).first;
+    if(to_side == 0) return false;
+    int8_t from_side = target->off_line_side;
+    dm_point_t from = target->off_line_position;
+    int64_t from_time = target->off_line_time;
+    target->off_line_side = to_side;
+    target->off_line_position = to;
+    target->off_line_time = targets[target_index].timestamp;
+    if(from_side == 0 || from_side == to_side) return false;
+
+    // The movement crosses the line extended, check it crosses the S0 -> S1 segment: from + t * movement = S0 + u * line
+    int64_t movement_x = to.x - from.x, movement_y = to.y - from.y;
+    int64_t line_x = zones[zone].line_delta.x, line_y = zones[zone].line_delta.y;
+    int64_t offset_x = zones[zone].line_origin.x - from.x, offset_y = zones[zone].line_origin.y - from.y;
+    int64_t denominator = (movement_x * line_y) - (movement_y * line_x);
+    int64_t t_numerator = (offset_x * line_y) - (offset_y * line_x);
+    int64_t u_numerator = (offset_x * movement_y) - (offset_y * movement_x);
+    if(denominator == 0) return false;
+    if(denominator < 0)
+    {
+        denominator = -denominator;
+        t_numerator = -t_numerator;
+        u_numerator = -u_numerator;
+    }
+    if(u_numerator < 0 || u_numerator > denominator) return false;
+
+    float t = (float)t_numerator / denominator;
+    crossing_event_t event = {};
+    event.time = from_time + (int64_t)(t * (targets[target_index].timestamp - from_time));
+    event.track_id = targets[target_index].track_id;
+    event.zone = zone;
+    event.entered_side = NONE;
+    event.exited_side = NONE;
+    event.trusted = 1;
+    event.inverted = enter_exit_inverted;
+    event.line = 1;
+    event.rule = (to_side > 0) ? crossing_rule_t{CROSSING_ENTERED, COUNTING_LINE_ENTERED_REASON} : crossing_rule_t{CROSSING_EXITED, COUNTING_LINE_EXITED_REASON};
+    if(enter_exit_inverted) event.rule.event = crossing_invert(event.rule.event);
+    event.speed = crossing_speed(zone, target_index);
+    gate_crossing_speed(&event);
+    event_counters[zone][event.rule.event]++;
+    count_occupancy(event.rule.event);
+
+    event.previous[0] = decimeters_to_meters(from.x); event.previous[1] = decimeters_to_meters(from.y);
+    event.entered[0] = (from.x + (t * movement_x)) / 10; event.entered[1] = (from.y + (t * movement_y)) / 10;
+    event.exited[0] = decimeters_to_meters(to.x); event.exited[1] = decimeters_to_meters(to.y);
+    crossing_events.push(event);
+    return true;
+}
+
+void Detection::count_detections(uint8_t zone, int target_index)
+{
+    zone_target_t* target = &zone_targets[zone][target_index];
+    if(target->traversed == false) return;
+    if(target->entered_side == NONE || target->exited_side == NONE) return;
+
+    crossing_event_t event = {};
+    event.time = target->exited_time;
+    event.track_id = targets[target_index].track_id;
+    event.zone = zone;
+    event.entered_side = target->entered_side;
+    event.exited_side = target->exited_side;
+    event.trusted = (target->trusted_vector != 0);
+    event.inverted = enter_exit_inverted;
+    event.rule = crossing_table.rule[crossing_rule_index(event.entered_side, event.exited_side, event.trusted, event.inverted)];
+    event.speed = crossing_speed(zone, target_index);
+    gate_crossing_speed(&event);
+    event_counters[zone][event.rule.event]++;
+    count_occupancy(event.rule.event);
+
+    event.previous[0] = decimeters_to_meters(target->previous_position.x); event.previous[1] = decimeters_to_meters(target->previous_position.y);
+    event.entered[0] = decimeters_to_meters(target->entered_position.x); event.entered[1] = decimeters_to_meters(target->entered_position.y);
+    event.exited[0] = decimeters_to_meters(target->exited_position.x); event.exited[1] = decimeters_to_meters(target->exited_position.y);
+    crossing_events.push(event);
+
+    clear_zone_target(target);
+}
+
+void Detection::count_occupancy(uint8_t event)
+{
+    if(event == CROSSING_ENTERED) occupancy++;
+    else if(event == CROSSING_EXITED) occupancy--;
+    else return;
+    if(occupancy < 0) occupancy = 0;
+    if(occupancy_config.max > 0 && occupancy > occupancy_config.max) occupancy = occupancy_config.max;
+}
+
+void Detection::update_occupancy(int64_t time_now)
+{
+    if(pir->read()) last_presence_time = time_now;
+
+    // Drift correction, nobody seen for long enough means nobody is inside
+    if(occupancy_config.empty_timeout > 0 && occupancy != 0 &&
+       time_now - last_presence_time > (int64_t)occupancy_config.empty_timeout * 1000000)
+    {
+        ESP_LOGW(DETECTION_TAG, "Room empty for %lu s, occupancy corrected from %ld to 0", occupancy_config.empty_timeout, occupancy);
+        occupancy = 0;
+        occupancy_corrections++;
+    }
+
+    // Scheduled reset, once a day and only after the clock was set by SNTP
+    if(occupancy_config.reset_minute >= 0)
+    {
+        time_t now = system_clock->utc() / 1000000;
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        if(timeinfo.tm_year > (2020 - 1900) &&
+           timeinfo.tm_yday != last_reset_day &&
+           (timeinfo.tm_hour * 60) + timeinfo.tm_min == occupancy_config.reset_minute)
+        {
+            ESP_LOGI(DETECTION_TAG, "Scheduled occupancy reset (was %ld)", occupancy);
+            occupancy = 0;
+            last_reset_day = timeinfo.tm_yday;
+        }
+    }
+
+    bool changed = (occupancy != published_occupancy) && (time_now - last_occupancy_publish > OCCUPANCY_PUBLISH_INTERVAL);
+    if(!changed && time_now - last_occupancy_publish < OCCUPANCY_REFRESH_INTERVAL) return;
+
+    std::string payload = "{";
+    payload += "\"occupancy\": " + std::to_string(occupancy) + ",";
+    payload += "\"corrections\": " + std::to_string(occupancy_corrections);
+    payload += "}";
+    mqtt->publish(
+        std::string(sensor->get_mqtt_root_topic() + "/occupancy").c_str(),
+        payload.c_str(),
+        true
+    );
+    published_occupancy = occupancy;
+    last_occupancy_publish = time_now;
+}
+
+void Detection::set_occupancy_config(occupancy_config_t config)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings.occupancy_config = config;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_OCCUPANCY_CONFIG);
+    storage->store_data_blob(SENSOR_BASIC_DATA, "OCCUPANCY", &config, sizeof(config));
+    ESP_LOGI(DETECTION_TAG, "Occupancy max: %u | reset at minute: %d | empty after: %lu s",
+        config.max, config.reset_minute, config.empty_timeout);
+}
+
+occupancy_config_t Detection::get_occupancy_config()
+{
+    taskENTER_CRITICAL(&settings_lock);
+    occupancy_config_t config = settings.occupancy_config;
+    taskEXIT_CRITICAL(&settings_lock);
+    return config;
+}
+
+void Detection::set_occupancy(int32_t value)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings.occupancy = value;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_OCCUPANCY);
+    ESP_LOGI(DETECTION_TAG, "Occupancy set to %ld", value);
+}
+
+int32_t Detection::get_occupancy()
+{
+    return occupancy;
+}
+
+void Detection::log_events()
+{
+    crossing_event_t event;
+    while(crossing_events.pop(&event))
+    {
+        if(event.rule.event != CROSSING_NONE)
+        {
+            if(event_buffer_count == EVENT_BUFFER_SIZE)
+            {
+                event_buffer_head = (event_buffer_head + 1) % EVENT_BUFFER_SIZE;
+                event_buffer_count--;
+                event_buffer_dropped++;
+            }
+            payload_buffer_t* record = &event_buffer[(event_buffer_head + event_buffer_count) % EVENT_BUFFER_SIZE];
+            record->timestamp = sensor->utc_time_at(event.time);
+            record->track_id = event.track_id;
+            record->zone = event.zone;
+            record->event = event.rule.event;
+            record->entered_side = event.entered_side;
+            record->exited_side = event.exited_side;
+            record->entered_position = {event.entered[0], event.entered[1]};
+            record->exited_position = {event.exited[0], event.exited[1]};
+            event_buffer_count++;
+        }
+
+        if(event.line)
+        {
+            ESP_LOGI(DETECTION_TAG, "Track %u zone %u previous point: (%.2f, %.2f) | crossed the line at: (%.2f, %.2f) | current point: (%.2f, %.2f) | speed: %u cm/s",
+                event.track_id,
+                event.zone,
+                event.previous[0], event.previous[1],
+                event.entered[0], event.entered[1],
+                event.exited[0], event.exited[1],
+                event.speed
+            );
+        }
+        else
+        {
+            ESP_LOGI(DETECTION_TAG, "Track %u zone %u previous point: (%.2f, %.2f) | entry point: (%.2f, %.2f) | exit point: (%.2f, %.2f) | entered side: %s | exited side: %s | speed: %u cm/s | [%s]",
+                event.track_id,
+                event.zone,
+                event.previous[0], event.previous[1],
+                event.entered[0], event.entered[1],
+                event.exited[0], event.exited[1],
+                crossing_side_str[event.entered_side],
+                crossing_side_str[event.exited_side],
+                event.speed,
+                event.trusted ? " TRUSTED " : "UNTRUSTED"
+            );
+        }
+        const char* id_prefix = event.trusted ? "" : "#";
+        const char* inverted = event.inverted ? "!" : "";
+        switch(event.rule.event)
+        {
+            case CROSSING_ENTERED:
+                ESP_LOGI(DETECTION_TAG, "Track %u entered the room | id: %s%02u%s @ %s", event.track_id, id_prefix, event.rule.reason, inverted, sensor->time_at(event.time));
                 break;
-            case BOTTOM:
-                if(!enter_exit_inverted)
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: #20",target_index);
-                }
-                else
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: #21!",target_index);
-                }
+            case CROSSING_EXITED:
+                ESP_LOGI(DETECTION_TAG, "Track %u exited the room | id: %s%02u%s @ %s", event.track_id, id_prefix, event.rule.reason, inverted, sensor->time_at(event.time));
                 break;
-            case NONE:
-                ESP_LOGW(DETECTION_TAG, "Target %u exited but exited_side is not defined | id: #30",target_index);
+            case CROSSING_GAVE_UP:
+                ESP_LOGI(DETECTION_TAG, "Track %u gave up | id: %s%02u%s @ %s", event.track_id, id_prefix, event.rule.reason, inverted, sensor->time_at(event.time));
                 break;
             default:
+                ESP_LOGW(DETECTION_TAG, "Track %u traversed but the crossing is not counted | id: %s%02u%s @ %s", event.track_id, id_prefix, event.rule.reason, inverted, sensor->time_at(event.time));
                 break;
         }
-        targets[target_index].entered_side = NONE;
-        targets[target_index].exited_side = NONE;
-        targets[target_index].traversed = false;
-        targets[target_index].entered_position = {0, 0};
-        targets[target_index].exited_position = {0, 0};
-        targets[target_index].detection_segment_crossed_position = {0, 0};
-        return;
     }
+    static uint32_t reported_dropped = 0;
+    if(crossing_events.get_dropped() != reported_dropped)
+    {
+        reported_dropped = crossing_events.get_dropped();
+        ESP_LOGW(DETECTION_TAG, "%lu crossing events were not logged (queue full)", reported_dropped);
+    }
+}
 
-    ESP_LOGI(DETECTION_TAG, "Target %u previous point: (%.2f, %.2f) | entry point: (%.2f, %.2f) | exit point: (%.2f, %.2f) | entered side: %s | exited side: %s | [ TRUSTED ]",
-        target_index,
-        targets[target_index].previous_position.x,
-        targets[target_index].previous_position.y,
-        targets[target_index].entered_position.x,
-        targets[target_index].entered_position.y,
-        targets[target_index].exited_position.x,
-        targets[target_index].exited_position.y,
-        detection_area_side_str[targets[target_index].entered_side],
-        detection_area_side_str[targets[target_index].exited_side]
-    );
-    switch(targets[target_index].entered_side){
-        case TOP:
-            // User entered the room
-            if(targets[target_index].exited_side == BOTTOM){
-                if(!enter_exit_inverted)
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 00 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 00! @ %s",target_index, sensor->time_now());
-                }
-            }
-            // User gave up
-            else if(targets[target_index].exited_side == TOP){
-                gave_up_detections++;
-                if(!enter_exit_inverted)
-                {
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 01 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 01! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == LEFT){
-                if(!enter_exit_inverted)
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 02 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 02! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == RIGHT){
-                if(!enter_exit_inverted)
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 03 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 03! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else{
-                ESP_LOGW(DETECTION_TAG, "Target %u traversed but exited_side is not defined | id: 04 @ %s",target_index, sensor->time_now());
-            }
-            break;
-        case BOTTOM:
-            // User exited the room
-            if(targets[target_index].exited_side == TOP){
-                if(!enter_exit_inverted)
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 10 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 10! @ %s",target_index, sensor->time_now());
-                }
-            }
-            // User gave up
-            else if(targets[target_index].exited_side == BOTTOM){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 11 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 11! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == LEFT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 12 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 12! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == RIGHT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 12 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 12! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else{
-                ESP_LOGW(DETECTION_TAG, "Target %u traversed but exited_side is not defined | id: 12 @ %s",target_index, sensor->time_now());
-            }
-            break;
-        case LEFT:
-            // User entered the room
-            if(targets[target_index].exited_side == BOTTOM){
-                if(!enter_exit_inverted)
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 20 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 20! @ %s",target_index, sensor->time_now());
-                }
-            }
-            // User gave up
-            else if(targets[target_index].exited_side == TOP){
-                if(!enter_exit_inverted)
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 21 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 21! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == LEFT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 22 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 22! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == RIGHT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 22 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 22! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else{
-                ESP_LOGW(DETECTION_TAG, "Target %u traversed but exited_side is not defined | id: 22 @ %s",target_index, sensor->time_now());
-            }
-            break;
-        case RIGHT:
-            // User exited the room
-            if(targets[target_index].exited_side == TOP){
-                if(!enter_exit_inverted)
-                {
-                    exited_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u exited the room | id: 30 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    entered_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u entered the room | id: 30! @ %s",target_index, sensor->time_now());
-                }
-            }
-            // User gave up
-            else if(targets[target_index].exited_side == BOTTOM){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 31 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 31! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == RIGHT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 32 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 32! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else if(targets[target_index].exited_side == LEFT){
-                if(!enter_exit_inverted)
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up exiting the room | id: 32 @ %s",target_index, sensor->time_now());
-                }
-                else
-                {
-                    gave_up_detections++;
-                    ESP_LOGI(DETECTION_TAG, "Target %u gave up entering the room | id: 32! @ %s",target_index, sensor->time_now());
-                }
-            }
-            else{
-                ESP_LOGW(DETECTION_TAG, "Target %u traversed but exited_side is not defined | id: 32 @ %s",target_index, sensor->time_now());
-            }
-            break;
-        case NONE:
-            ESP_LOGW(DETECTION_TAG, "Target %u traversed but entered_side is NONE | id: 40 @ %s",target_index, sensor->time_now());
-            break;
-        default:
-            ESP_LOGW(DETECTION_TAG, "Target %u traversed but entered_side is not defined | 50 @ %s",target_index, sensor->time_now());
-            break;
-    }
-    targets[target_index].entered_side = NONE;
-    targets[target_index].exited_side = NONE;
-    targets[target_index].traversed = false;
-    targets[target_index].entered_position = {0, 0};
-    targets[target_index].exited_position = {0, 0};
-    targets[target_index].detection_segment_crossed_position = {0, 0};
-    // ESP_LOGI(DETECTION_TAG, "Entered: %d, Exited: %d, Gave up: %d",
-    //     entered_detections,
-    //     exited_detections,
-    //     gave_up_detections
-    // );
+void Detection::set_crossing_rule(
+    detection_area_side_t entered,
+    detection_area_side_t exited,
+    bool trusted,
+    bool inverted,
+    crossing_rule_t rule
+)
+{
+    if(rule.event >= CROSSING_EVENT_TYPES) rule.event = CROSSING_UNDEFINED;
+    taskENTER_CRITICAL(&settings_lock);
+    settings.crossing_table.rule[crossing_rule_index(entered, exited, trusted, inverted)] = rule;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_CROSSING_TABLE);
+}
+
+crossing_rule_t Detection::get_crossing_rule(
+    detection_area_side_t entered,
+    detection_area_side_t exited,
+    bool trusted,
+    bool inverted
+)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    crossing_rule_t rule = settings.crossing_table.rule[crossing_rule_index(entered, exited, trusted, inverted)];
+    taskEXIT_CRITICAL(&settings_lock);
+    return rule;
+}
+
+void Detection::reset_crossing_table()
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings.crossing_table = CROSSING_DEFAULT_TABLE;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_CROSSING_TABLE);
+    save_crossing_table();
+}
+
+void Detection::save_crossing_table()
+{
+    crossing_table_t table;
+    taskENTER_CRITICAL(&settings_lock);
+    table = settings.crossing_table;
+    taskEXIT_CRITICAL(&settings_lock);
+    storage->store_data_blob(SENSOR_BASIC_DATA, "CROSSING_TABLE", &table, sizeof(table));
+    ESP_LOGI(DETECTION_TAG, "Crossing table saved");
 }
 
 void Detection::start_detection()
 {
     ld2461_detection_t detection_frame;
-    ld2461_setup_detection(&detection_frame);
-    ld2461->report_detections(&detection_frame);
-    
-    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    for(int radar=0; radar<radars_count; radar++)
+    {
+        ld2461_setup_detection(&detection_frame);
+        radars[radar]->report_detections(&detection_frame);
+
+        target_t* radar_targets = &targets[radar * MAX_TARGETS_DETECTION];
+        for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+        {
+            radar_targets[i].current_position = {detection_frame.target[i].x, detection_frame.target[i].y};
+            radar_targets[i].timestamp = detection_frame.timestamp;
+        }
+    }
+}
+
+void Detection::start_task(int64_t publish_period)
+{
+    if(this->task_handle != NULL) return;
+    xTaskCreatePinnedToCore(
+        Detection::task,            // Task Function
+        "detection",                // Task Name
+        DETECTION_TASK_STACK,       // Stack Size
+        this,                       // Parameters
+        DETECTION_TASK_PRIORITY,    // Priority
+        &this->task_handle,         // Task Handle
+        DETECTION_TASK_CORE         // Core
+    );
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.arg = (void*)this;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.skip_unhandled_events = true;
+
+    timer_args.callback = Detection::tick_timer_callback;
+    timer_args.name = "detection_tick";
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &this->tick_timer));
+    timer_args.callback = Detection::publish_timer_callback;
+    timer_args.name = "detection_publish";
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &this->publish_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(this->tick_timer, DETECTION_TICK_PERIOD));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(this->publish_timer, publish_period));
+    ESP_LOGI(DETECTION_TAG, "Detection task started, publishing every %lld us", publish_period);
+}
+
+TaskHandle_t Detection::get_task()
+{
+    return this->task_handle;
+}
+
+void Detection::set_publish_period(int64_t publish_period)
+{
+    if(this->publish_timer == NULL) return;
+    esp_timer_stop(this->publish_timer);
+    ESP_ERROR_CHECK(esp_timer_start_periodic(this->publish_timer, publish_period));
+}
+
+void Detection::get_latency(detection_latency_t* latency)
+{
+    *latency = this->latency;
+}
+
+void Detection::tick_timer_callback(void* arg)
+{
+    xTaskNotify(((Detection*)arg)->task_handle, DETECTION_EVENT_TICK, eSetBits);
+}
+
+void Detection::publish_timer_callback(void* arg)
+{
+    xTaskNotify(((Detection*)arg)->task_handle, DETECTION_EVENT_PUBLISH, eSetBits);
+}
+
+void Detection::settings_updated(uint32_t changed)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings_changed |= changed;
+    taskEXIT_CRITICAL(&settings_lock);
+    if(this->task_handle == NULL) this->apply_settings();
+    else xTaskNotify(this->task_handle, DETECTION_EVENT_SETTINGS, eSetBits);
+}
+
+void Detection::apply_settings()
+{
+    // Copied out so the lock is not held while the lookup tables are built
+    detection_settings_t applied;
+    taskENTER_CRITICAL(&settings_lock);
+    uint32_t changed = settings_changed;
+    settings_changed = 0;
+    applied = settings;
+    taskEXIT_CRITICAL(&settings_lock);
+
+    if(changed & DETECTION_SETTING_ZONES)
+    {
+        // Tables of the zones that go away are freed first, their budget can be used by the new ones
+        for(int zone=applied.zone_count; zone<MAX_ZONES; zone++) free_lut(&zones[zone]);
+        for(int zone=0; zone<applied.zone_count; zone++)
+        {
+            const zone_config_t* config = &applied.zones[zone];
+            apply_zone(zone, config);
+            for(int i=0; i<MAX_WORLD_TARGETS; i++) clear_zone_target(&zone_targets[zone][i]);
+            ESP_LOGI(DETECTION_TAG, "Zone %d: %u vertices, counting line from (%.2f, %.2f) to (%.2f, %.2f), lookup table %ux%u",
+                zone, config->vertex_count,
+                config->line[0].x, config->line[0].y,
+                config->line[1].x, config->line[1].y,
+                zones[zone].lut.width, zones[zone].lut.height
+            );
+        }
+        zone_count = applied.zone_count;
+        memset(event_counters, 0, sizeof(event_counters));
+    }
+    if(changed & DETECTION_SETTING_COUNTING_MODE)
     {
-        targets[i].current_position = {
-            (float)(int8_t)(detection_frame.target[i].x)/10,
-            (float)(int8_t)(detection_frame.target[i].y)/10
-        };
+        counting_mode = applied.counting_mode;
+        for(int zone=0; zone<MAX_ZONES; zone++)
+        {
+            for(int i=0; i<MAX_WORLD_TARGETS; i++) clear_zone_target(&zone_targets[zone][i]);
+        }
+    }
+    if(changed & DETECTION_SETTING_ENTER_EXIT_INVERTED) enter_exit_inverted = applied.enter_exit_inverted;
+    if(changed & DETECTION_SETTING_MIN_CROSSING_SPEED) min_crossing_speed = applied.min_crossing_speed;
+    if(changed & DETECTION_SETTING_CROSSING_TABLE) crossing_table = applied.crossing_table;
+    if(changed & DETECTION_SETTING_OCCUPANCY_CONFIG) occupancy_config = applied.occupancy_config;
+    if(changed & DETECTION_SETTING_OCCUPANCY)
+    {
+        occupancy = (applied.occupancy < 0) ? 0 : applied.occupancy;
+        if(occupancy_config.max > 0 && occupancy > occupancy_config.max) occupancy = occupancy_config.max;
+        last_occupancy_publish = 0;
+    }
+}
+
+void Detection::task(void* arg)
+{
+    ((Detection*)arg)->task_loop();
+}
+
+void Detection::task_loop()
+{
+    uint32_t events;
+    while(true)
+    {
+        if(xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY) != pdTRUE) continue;
+        if(events & DETECTION_EVENT_SETTINGS)
+        {
+            this->apply_settings();
+        }
+        if(events & DETECTION_EVENT_REPORT)
+        {
+            this->detect();
+            this->log_events();
+        }
+        if(events & DETECTION_EVENT_TICK)
+        {
+            this->update_occupancy(system_clock->now());
+        }
+        if(events & DETECTION_EVENT_PUBLISH)
+        {
+            sensor->update_utc_offset();
+            this->mqtt_send_detections();
+        }
     }
 }
 
 void Detection::mqtt_send_detections()
 {
-    if(entered_detections == 0 && exited_detections == 0 && gave_up_detections == 0) return;
+    // Totals keep the payload of a single detection area, "zones" has the counters of each zone
+    int totals[CROSSING_EVENT_TYPES] = {};
+    std::string zones_payload = "[";
+    for(int zone=0; zone<zone_count; zone++)
+    {
+        for(int event=0; event<CROSSING_EVENT_TYPES; event++) totals[event] += event_counters[zone][event];
+        zones_payload += "{";
+        zones_payload += "\"entered\": " + std::to_string(event_counters[zone][CROSSING_ENTERED]) + ",";
+        zones_payload += "\"exited\": " + std::to_string(event_counters[zone][CROSSING_EXITED]) + ",";
+        zones_payload += "\"gave_up\": " + std::to_string(event_counters[zone][CROSSING_GAVE_UP]);
+        zones_payload += (zone < zone_count - 1) ? "}," : "}";
+    }
+    zones_payload += "]";
+    mqtt_send_events();
+    if(totals[CROSSING_ENTERED] == 0 && totals[CROSSING_EXITED] == 0 && totals[CROSSING_GAVE_UP] == 0) return;
+
     std::string payload = "{";
-    payload += "\"entered\": " + std::to_string(entered_detections) + ",";
-    payload += "\"exited\": " + std::to_string(exited_detections) + ",";
-    payload += "\"gave_up\": " + std::to_string(gave_up_detections);
+    payload += "\"ts\": " + std::to_string(sensor->utc_time_at(system_clock->now())) + ",";
+    payload += "\"entered\": " + std::to_string(totals[CROSSING_ENTERED]) + ",";
+    payload += "\"exited\": " + std::to_string(totals[CROSSING_EXITED]) + ",";
+    payload += "\"gave_up\": " + std::to_string(totals[CROSSING_GAVE_UP]) + ",";
+    payload += "\"zones\": " + zones_payload + ",";
+    payload += "\"slow\": " + std::to_string(slow_crossings) + ",";
+    payload += "\"speed_histogram\": [";
+    for(int bin=0; bin<SPEED_HISTOGRAM_BINS; bin++)
+    {
+        payload += std::to_string(speed_histogram[bin]) + ((bin < SPEED_HISTOGRAM_BINS - 1) ? "," : "");
+    }
+    payload += "]";
     payload += "}";
     mqtt->publish(
         std::string(sensor->get_mqtt_root_topic() + "/data").c_str(),
         payload.c_str()
     );
-    entered_detections = 0;
-    exited_detections = 0;
-    gave_up_detections = 0;
+    memset(event_counters, 0, sizeof(event_counters));
+    memset(speed_histogram, 0, sizeof(speed_histogram));
+    slow_crossings = 0;
+}
+
+void Detection::mqtt_send_events()
+{
+    while(event_buffer_count > 0)
+    {
+        std::string payload = "{\"events\": [";
+        for(int i=0; i<EVENT_BATCH_SIZE && event_buffer_count > 0; i++)
+        {
+            payload_buffer_t* record = &event_buffer[event_buffer_head];
+            if(i > 0) payload += ",";
+            payload += "{";
+            payload += "\"ts\": " + std::to_string(record->timestamp) + ",";
+            payload += "\"type\": \"" + std::string(crossing_event_str[record->event]) + "\",";
+            payload += "\"zone\": " + std::to_string(record->zone) + ",";
+            payload += "\"track\": " + std::to_string(record->track_id) + ",";
+            payload += "\"entered_side\": \"" + std::string(crossing_side_str[record->entered_side]) + "\",";
+            payload += "\"exited_side\": \"" + std::string(crossing_side_str[record->exited_side]) + "\",";
+            payload += "\"entry\": [" + std::to_string(record->entered_position.x) + "," + std::to_string(record->entered_position.y) + "],";
+            payload += "\"exit\": [" + std::to_string(record->exited_position.x) + "," + std::to_string(record->exited_position.y) + "]";
+            payload += "}";
+            event_buffer_head = (event_buffer_head + 1) % EVENT_BUFFER_SIZE;
+            event_buffer_count--;
+        }
+        payload += "],";
+        payload += "\"dropped\": " + std::to_string(event_buffer_dropped);
+        payload += "}";
+        event_buffer_dropped = 0;
+        mqtt->publish(
+            std::string(sensor->get_mqtt_root_topic() + "/events").c_str(),
+            payload.c_str()
+        );
+    }
+}
+
+void Detection::set_counting_mode(counting_mode_t mode)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings.counting_mode = mode;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_COUNTING_MODE);
+    storage->store_data_uint8(SENSOR_BASIC_DATA, "COUNT_MODE", mode);
+    ESP_LOGI(DETECTION_TAG, "Counting mode set to [%s]", (mode == COUNTING_LINE) ? "line" : "area");
+}
+
+counting_mode_t Detection::get_counting_mode()
+{
+    taskENTER_CRITICAL(&settings_lock);
+    counting_mode_t mode = settings.counting_mode;
+    taskEXIT_CRITICAL(&settings_lock);
+    return mode;
+}
+
+void Detection::set_min_crossing_speed(uint16_t speed)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings.min_crossing_speed = speed;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_MIN_CROSSING_SPEED);
+    storage->store_data_uint32(SENSOR_BASIC_DATA, "MIN_SPEED", speed);
+    ESP_LOGI(DETECTION_TAG, "Minimum crossing speed set to %u cm/s", speed);
+}
+
+uint16_t Detection::get_min_crossing_speed()
+{
+    taskENTER_CRITICAL(&settings_lock);
+    uint16_t speed = settings.min_crossing_speed;
+    taskEXIT_CRITICAL(&settings_lock);
+    return speed;
 }
 
 void Detection::set_raw_data_sent(bool send_raw_data)
@@ -651,42 +1243,84 @@ void Detection::set_raw_data_sent(bool send_raw_data)
 
 void Detection::set_enter_exit_inverted(bool inverted)
 {
-    enter_exit_inverted = inverted;
-    storage->store_data_uint8(SENSOR_BASIC_DATA, "ENTER_EXIT", enter_exit_inverted);
-    ESP_LOGI(DETECTION_TAG, "Entrance/Exit Inversion set to [%s]", enter_exit_inverted ? "true" : "false");
+    taskENTER_CRITICAL(&settings_lock);
+    settings.enter_exit_inverted = inverted;
+    taskEXIT_CRITICAL(&settings_lock);
+    settings_updated(DETECTION_SETTING_ENTER_EXIT_INVERTED);
+    storage->store_data_uint8(SENSOR_BASIC_DATA, "ENTER_EXIT", inverted);
+    ESP_LOGI(DETECTION_TAG, "Entrance/Exit Inversion set to [%s]", inverted ? "true" : "false");
 }
 
 void Detection::detect()
 {
-    ld2461_detection_t detection_frame;
-    ld2461_setup_detection(&detection_frame);
-    ld2461->report_detections(&detection_frame);
+    // Process every report the RX tasks parsed since the last call, merging the radars in arrival order
+    ld2461_detection_t pending[MAX_RADARS];
+    bool has_pending[MAX_RADARS] = {};
+    while(true)
+    {
+        int oldest = -1;
+        for(int radar=0; radar<radars_count; radar++)
+        {
+            if(!has_pending[radar]) has_pending[radar] = radars[radar]->pop_detection(&pending[radar]);
+            if(!has_pending[radar]) continue;
+            if(oldest < 0 || pending[radar].timestamp < pending[oldest].timestamp) oldest = radar;
+        }
+        if(oldest < 0) break;
+        process_detection(&pending[oldest], oldest);
+        has_pending[oldest] = false;
+
+        int64_t elapsed = system_clock->now() - pending[oldest].timestamp;
+        latency.reports++;
+        latency.last = elapsed;
+        if(elapsed > latency.max) latency.max = elapsed;
+        if(elapsed > DETECTION_DEADLINE) latency.deadline_misses++;
+    }
+}
 
-    ld2461->filter_ghost_targets(&detection_frame);
+void Detection::process_detection(ld2461_detection_t* report, uint8_t radar)
+{
+    ld2461_detection_t detection_frame = *report;
 
+    if(detection_frame.detected_targets > 0) last_presence_time = detection_frame.timestamp;
+    if(radar > 0) remove_duplicated_targets(&detection_frame, radar);
+
+    // Every report moves the targets, so the checks below see the movement of the report that just arrived
+    update_targets(&detection_frame, radar);
     if(detection_frame.detected_targets == 0)
     {
         //ESP_LOGI(DETECTION_TAG, "No targets detected");
         return;
     }
 
+    int base = radar * MAX_TARGETS_DETECTION;
     std::string detection_payload = "{";
     std::string targets_str = "Target in Area: ";
     for(int i=0; i<MAX_TARGETS_DETECTION; i++)
     {
-        if(!(detection_frame.is_target_available[i] == 2)){
-            if(check_if_detected(i)) {
-                targets_str += std::to_string(i) + ", ";
+        for(int zone=0; zone<zone_count; zone++)
+        {
+            if(counting_mode == COUNTING_LINE)
+            {
+                if(check_line_crossing(zone, base + i)) {
+                    targets_str += std::to_string(base + i) + ", ";
+                }
+                continue;
             }
+            if(check_if_detected(zone, base + i)) {
+                targets_str += std::to_string(base + i) + ", ";
+            }
+            count_detections(zone, base + i);
         }
-
-        count_detections(i);
         detection_payload += "\"t_" + std::to_string(i) + "\": {";
-        detection_payload += "\"x\": " + std::to_string(targets[i].current_position.x) + ",";
-        detection_payload += "\"y\": " + std::to_string(targets[i].current_position.y);
+        detection_payload += "\"id\": " + std::to_string(targets[base + i].track_id) + ",";
+        detection_payload += "\"x\": " + std::to_string(decimeters_to_meters(targets[base + i].current_position.x)) + ",";
+        detection_payload += "\"y\": " + std::to_string(decimeters_to_meters(targets[base + i].current_position.y)) + ",";
+        detection_payload += "\"vx\": " + std::to_string((float)targets[base + i].velocity_x / 100) + ",";   // m/s, the heading is atan2(vy, vx)
+        detection_payload += "\"vy\": " + std::to_string((float)targets[base + i].velocity_y / 100);
         detection_payload += "},";
     }
-    detection_payload.pop_back(); // Remove last comma
+    detection_payload += "\"radar\": " + std::to_string(radar) + ",";
+    detection_payload += "\"ts\": " + std::to_string(targets[base].timestamp); // Arrival time (esp_timer, us) of the positions above
     detection_payload += "}";
     // if(targets_str.length() > 16) ESP_LOGI(DETECTION_TAG, "%s",targets_str.c_str());
     if(send_raw_detection_payload){
@@ -695,5 +1329,4 @@ void Detection::detect()
             detection_payload.c_str()
         );
     }
-    update_targets(&detection_frame);
 }
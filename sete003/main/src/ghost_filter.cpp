@@ -0,0 +1,142 @@
+#include "ghost_filter.hpp"
+
+#include <math.h>
+#include <string.h>
+
+GhostFilter::GhostFilter()
+{
+    this->reset();
+    this->ghosts = 0;
+    this->teleports = 0;
+}
+
+void GhostFilter::reset()
+{
+    memset(&previous_detection, 0, sizeof(previous_detection));
+    memset(timeout, 0, sizeof(timeout));
+}
+
+void GhostFilter::filter(ld2461_detection_t* detection)
+{
+    if (detection->detected_targets == 0) return; // If no targets are detected, return
+
+    // For each target, check if it is a ghost
+    for (int i = 0; i < MAX_TARGETS_DETECTION; i++)
+    {
+        // If target is already zero, skip
+        if (detection->target[i].x == 0 && detection->target[i].y == 0)
+        {
+            detection->is_target_available[i] = LD2461_TARGET_UNAVAILABLE; // Set the target as not available (id 0 is not available)
+            continue;
+        }
+
+        if (previous_detection.target[i].x == 0 && previous_detection.target[i].y == 0)
+        {
+            continue; // Skip if the previous target is zero
+        }
+
+        //// Check if the target is too far from the previous one (probably error in the detection, people don't teleport)
+        if (this->flag_max_threshold_distance) {
+            if (fabs(detection->target[i].x - previous_detection.target[i].x) > MAX_THRESHOLD_DISTANCE_METERS ||
+                fabs(detection->target[i].y - previous_detection.target[i].y) > MAX_THRESHOLD_DISTANCE_METERS)
+            {
+                detection->is_target_available[i] = LD2461_TARGET_TELEPORTED; // Set the target as teleported (id 3 is teleported)
+                teleports++;
+                continue;
+            }
+        }
+
+        // Checks if the current point is equal to the previous one
+        if (this->flag_ghost_timer){
+            if (detection->target[i].x == previous_detection.target[i].x &&
+                detection->target[i].y == previous_detection.target[i].y)
+            {
+                if (timeout[i] == 0)
+                {
+                    timeout[i] = detection->timestamp;
+                }
+                else if (detection->timestamp - timeout[i] > this->GHOST_TIMER_TIMEOUT)
+                {
+                    // Set the point as a ghost
+                    detection->is_target_available[i] = LD2461_TARGET_GHOST;
+                    detection->target[i].x = 0;
+                    detection->target[i].y = 0;
+                    ghosts++;
+
+                    // Continue the loop to avoid overwriting ghosts
+                    continue;
+                }
+            }
+            else
+            {
+                // If the current point is different from the previous one, reset the timeout
+                timeout[i] = 0;
+            }
+        }
+    }
+
+    // Update previous_detection
+    for (int i = 0; i < MAX_TARGETS_DETECTION; i++)
+    {
+        if (detection->is_target_available[i] != LD2461_TARGET_GHOST)
+        {
+            previous_detection.target[i] = detection->target[i];
+        }
+    }
+}
+
+void GhostFilter::set_ghost_timer_timeout(int64_t timeout)
+{
+    this->GHOST_TIMER_TIMEOUT = timeout;
+}
+
+int64_t GhostFilter::get_ghost_timer_timeout()
+{
+    return this->GHOST_TIMER_TIMEOUT;
+}
+
+void GhostFilter::set_max_threshold_distance(double distance)
+{
+    this->MAX_THRESHOLD_DISTANCE_METERS = distance;
+}
+
+double GhostFilter::get_max_threshold_distance()
+{
+    return this->MAX_THRESHOLD_DISTANCE_METERS;
+}
+
+void GhostFilter::set_flag(ld2461_flags flag, uint8_t value)
+{
+    switch(flag){
+        case LD2461_FLAG_GHOST_TIMER:
+            this->flag_ghost_timer = value;
+            break;
+        case LD2461_FLAG_MAX_THRESHOLD_DISTANCE:
+            this->flag_max_threshold_distance = value;
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t GhostFilter::get_flag(ld2461_flags flag)
+{
+    switch(flag){
+        case LD2461_FLAG_GHOST_TIMER:
+            return this->flag_ghost_timer;
+        case LD2461_FLAG_MAX_THRESHOLD_DISTANCE:
+            return this->flag_max_threshold_distance;
+        default:
+            return 0;
+    }
+}
+
+uint32_t GhostFilter::get_ghosts()
+{
+    return this->ghosts;
+}
+
+uint32_t GhostFilter::get_teleports()
+{
+    return this->teleports;
+}
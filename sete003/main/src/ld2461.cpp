@@ -1,10 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "esp_log.h"
 #include "esp_task_wdt.h"
-#include "esp_timer.h"
 #include <string.h>
 #include <math.h>
 #include "ld2461.hpp"
+#include "ld2461_codec.hpp"
+#include "storage.hpp"
+#include "clock.hpp"
 
 
 #ifndef RED_LED
@@ -15,14 +18,24 @@
 
 const char* RADAR_TAG = "LD2461";
 
+extern Storage* storage;
+
+// Probing order after the stored baudrate, factory default first and fastest next
+static const ld2461_baudrate_t ld2461_probe_order[] = {
+    LD2461_BAUDRATE_9600,
+    LD2461_BAUDRATE_256000,
+    LD2461_BAUDRATE_115200,
+    LD2461_BAUDRATE_57600,
+    LD2461_BAUDRATE_38400,
+    LD2461_BAUDRATE_19200
+};
+
 ld2461_frame_t ld2461_setup_frame()
 {
-    ld2461_frame_t frame = {
-        .data_length = NULL,
-        .command_word = LD2461_COMMAND_NULL,
-        .command_value = NULL,
-        .checksum = 0,
-    };
+    ld2461_frame_t frame = {};
+    frame.data_length = 0;
+    frame.command_word = LD2461_COMMAND_NULL;
+    frame.checksum = 0;
     return frame;
 }
 
@@ -37,22 +50,17 @@ void ld2461_setup_detection(ld2461_detection_t* detection)
     for(int i=0; i<MAX_TARGETS_DETECTION; i++)
     {
         detection->is_target_available[i] = LD2461_TARGET_UNAVAILABLE;
+        detection->track_id[i] = 0;
     }
-}
-
-void free_ld2461_frame(ld2461_frame_t* frame)
-{
-    if(frame->command_value != NULL)
-    {
-        free(frame->command_value);
-    }
+    detection->timestamp = 0;
 }
 
 LD2461::LD2461(
     uart_port_t uart_num,
     gpio_num_t tx_pin,
     gpio_num_t rx_pin,
-    int baudrate
+    int baudrate,
+    uint8_t index
 ){
     esp_err_t err = ESP_OK;
 
@@ -77,111 +85,386 @@ LD2461::LD2461(
     ESP_ERROR_CHECK(err);
 
     const int uart_buffer_size = (1024 * 2);
-    QueueHandle_t uart_queue;
     err = uart_driver_install(
         uart_num,           // UART Num
         uart_buffer_size,   // RX Buffer Size
         0,                  // TX Buffer Size
         10,                 // Queue Size
-        &uart_queue,        // Pointer to Queue
+        &this->uart_queue,  // Pointer to Queue
         0                   // Flags to Interruptions
     );
     ESP_ERROR_CHECK(err);
 
+    // The radar sends each frame in a single burst, so the RX timeout fires right after the frame end
+    err = uart_set_rx_timeout(uart_num, LD2461_RX_TIMEOUT_SYMBOLS);
+    ESP_ERROR_CHECK(err);
+
     this->uart_num = uart_num;
+    this->index = index;
+    this->baudrate = baudrate;
+    if(index == 0) snprintf(this->baud_key, sizeof(this->baud_key), "LD2461_BAUD"); // Key used before multi-radar
+    else snprintf(this->baud_key, sizeof(this->baud_key), "LD2461_%u_BAUD", index);
+    this->mount_lock = portMUX_INITIALIZER_UNLOCKED;
+    this->set_mount({0, 0, 0});
+    this->last_frame_time = 0;
+    this->link_stats = {};
+    this->consecutive_failed_resyncs = 0;
+    this->response_queue = xQueueCreate(LD2461_RESPONSE_QUEUE_SIZE, sizeof(ld2461_frame_t));
+    this->rx_task_handle = NULL;
+    this->report_listener = NULL;
+    this->report_listener_bits = 0;
 }
 
-void LD2461::read_data(ld2461_frame_t* frame)
+void LD2461::start_rx_task()
 {
-    bool data_ready = false;
-    uint8_t* data_length = (uint8_t*)malloc(2);
-    uint8_t* command_word = (uint8_t*)malloc(1);
-    uint8_t* checksum = (uint8_t*)malloc(1);
-    uint8_t* data = (uint8_t*)malloc(1);
-    int bytes_available = 0;
-    uint8_t retries_num = 0x0;
+    if(this->rx_task_handle != NULL) return;
+    char task_name[16];
+    snprintf(task_name, sizeof(task_name), "ld2461_rx_%u", this->index);
+    xTaskCreatePinnedToCore(
+        LD2461::rx_task,            // Task Function
+        task_name,                  // Task Name
+        LD2461_RX_TASK_STACK,       // Stack Size
+        this,                       // Parameters
+        LD2461_RX_TASK_PRIORITY,    // Priority
+        &this->rx_task_handle,      // Task Handle
+        LD2461_RX_TASK_CORE         // Core
+    );
+    ESP_LOGI(RADAR_TAG, "RX task started on UART %d", this->uart_num);
+}
+
+void LD2461::rx_task(void* arg)
+{
+    ((LD2461*)arg)->rx_loop();
+}
 
-    while(!data_ready)
+void LD2461::drain_uart()
+{
+    size_t buffered = 0;
+    uart_get_buffered_data_len(this->uart_num, &buffered);
+    while(buffered > 0)
+    {
+        uint8_t* window;
+        size_t space = this->parser.write_window(&window);
+        if(space == 0) break; // The parser holds a full buffer, let it consume first
+        size_t length = (buffered < space) ? buffered : space;
+        int bytes_read = uart_read_bytes(this->uart_num, window, length, 0);
+        if(bytes_read <= 0) break;
+        this->parser.commit(bytes_read);
+        buffered -= bytes_read;
+    }
+}
+
+void LD2461::rx_loop()
+{
+    uart_event_t event;
+    ld2461_frame_t frame = ld2461_setup_frame();
+    size_t buffered = 0;
+    int64_t rx_time;
+    size_t idle_symbols;
+
+    this->last_frame_time = system_clock->now();
+    while(true)
     {
-        retries_num++;
-        if(retries_num > 10){ESP_LOGW(RADAR_TAG, "Be advised that the UART is not in sync...");}
-        if(retries_num > 20){ESP_LOGE(RADAR_TAG, "UART not in sync... Rebooting..."); esp_restart();}
-        // Catch the Header
-        bytes_available = uart_read_bytes(this->uart_num, data, 1, 100);
-        if(bytes_available <= 0){
+        if(xQueueReceive(this->uart_queue, &event, pdMS_TO_TICKS(LD2461_LINK_CHECK_MS)) != pdTRUE)
+        {
+            event.type = UART_EVENT_MAX; // Nothing arrived, only check the link below
+        }
+        rx_time = system_clock->now(); // Taken before anything else, every frame time is derived from it
+
+        switch(event.type)
+        {
+            case UART_DATA:
+                // A timeout event is raised after the line stayed idle, otherwise the FIFO filled while receiving
+                idle_symbols = event.timeout_flag ? LD2461_RX_TIMEOUT_SYMBOLS : 0;
+                do
+                {
+                    this->drain_uart();
+                    while(this->parser.next_frame(&frame))
+                    {
+                        this->last_frame_time = rx_time;
+                        this->dispatch_frame(&frame, this->frame_arrival_time(rx_time, idle_symbols));
+                    }
+                    uart_get_buffered_data_len(this->uart_num, &buffered);
+                    // Bytes that arrived while parsing are still arriving, stamp them with the current time
+                    rx_time = system_clock->now();
+                    idle_symbols = 0;
+                } while(buffered > 0);
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                (event.type == UART_FIFO_OVF) ? this->link_stats.fifo_overflows++ : this->link_stats.buffer_full++;
+                ESP_LOGW(RADAR_TAG, "UART %d overflowed, flushing input", this->uart_num);
+                uart_flush_input(this->uart_num);
+                xQueueReset(this->uart_queue);
+                this->parser.reset();
+                break;
+            default:
+                break;
+        }
+
+        // Frames stopped validating (or stopped arriving), find the baudrate the radar is using again
+        if(system_clock->now() - this->last_frame_time > LD2461_LINK_LOST_TIMEOUT)
+        {
+            ESP_LOGW(RADAR_TAG, "No valid frame from UART %d for %lld us, resynchronising",
+                this->uart_num, system_clock->now() - this->last_frame_time);
+            this->resync();
+            uart_flush_input(this->uart_num);
+            xQueueReset(this->uart_queue);
+            this->parser.reset();
+            this->last_frame_time = system_clock->now();
+        }
+    }
+}
+
+void LD2461::set_report_listener(TaskHandle_t task, uint32_t bits)
+{
+    this->report_listener = task;
+    this->report_listener_bits = bits;
+}
+
+void LD2461::dispatch_frame(ld2461_frame_t* frame, int64_t arrival_time)
+{
+    ld2461_detection_t detection;
+
+    if(frame->command_word == LD2461_COMMAND_RADAR_REPORT_1)
+    {
+        // The whole per radar pipeline runs here, Detection only sees world coordinates
+        this->frame_to_detection(frame, &detection, arrival_time);
+        this->ghost_filter.filter(&detection);
+        this->tracker.update(&detection);
+        this->apply_mount(&detection);
+        this->detection_queue.push(detection);
+        if(this->report_listener != NULL) xTaskNotify(this->report_listener, this->report_listener_bits, eSetBits);
+    }
+    else
+    {
+        xQueueSend(this->response_queue, frame, 0);
+    }
+}
+
+bool LD2461::pop_detection(ld2461_detection_t* detection)
+{
+    return this->detection_queue.pop(detection);
+}
+
+uint32_t LD2461::get_dropped_detections()
+{
+    return this->detection_queue.get_dropped();
+}
+
+bool LD2461::wait_for_frame(ld2461_command_word_t command_word, ld2461_frame_t* frame, TickType_t timeout)
+{
+    int64_t deadline = system_clock->now() + ((int64_t)timeout * portTICK_PERIOD_MS * 1000);
+    if(timeout == portMAX_DELAY) deadline = INT64_MAX;
+    uint8_t retries_num = 0;
+
+    while(system_clock->now() < deadline)
+    {
+        if(this->rx_task_handle != NULL)
+        {
+            if(xQueueReceive(this->response_queue, frame, pdMS_TO_TICKS(100)) != pdTRUE) continue;
+        }
+        else if(!this->read_frame(frame, pdMS_TO_TICKS(100)))
+        {
+            if(timeout != portMAX_DELAY) continue;
+
+            // Waiting forever on a UART that stays silent
+            retries_num++;
             gpio_set_level(RED_LED, 0);
             ESP_LOGE(RADAR_TAG, "No data available");
+            if(retries_num > 10){ESP_LOGW(RADAR_TAG, "Be advised that the UART is not in sync...");}
+            if(retries_num > 20)
+            {
+                ESP_LOGE(RADAR_TAG, "UART not in sync... Resynchronising...");
+                this->resync();
+                retries_num = 0;
+            }
             continue;
         }
-        if(*data != 0xFF) {continue;}
-        uart_read_bytes(this->uart_num, data, 1, 100);
-        if(*data != 0xEE) {continue;}
-        uart_read_bytes(this->uart_num, data, 1, 100);
-        if(*data != 0xDD) {printf("\n");continue;}
-
-        // Data Length - Command Word (1Byte) + Command Value
-        uart_read_bytes(this->uart_num, data_length, 2, 100);
-        *data_length = (data_length[0] << 8) | data_length[1];
-
-        // Command Word
-        uart_read_bytes(this->uart_num, command_word, 1, 100);
-
-        // Command Value
-        uint8_t* command_value = (uint8_t*)malloc(*data_length-1);
-        for(int i=0; i<(*data_length-1); i++)
+        if(frame->command_word == command_word) return true;
+    }
+    return false;
+}
+
+bool LD2461::read_frame(ld2461_frame_t* frame, TickType_t timeout)
+{
+    int64_t deadline = system_clock->now() + ((int64_t)timeout * portTICK_PERIOD_MS * 1000);
+
+    while(!this->parser.next_frame(frame))
+    {
+        int64_t remaining = deadline - system_clock->now();
+        if(remaining <= 0) return false;
+
+        // Read everything the driver already buffered (at least a minimum frame) straight into the parser
+        uint8_t* window;
+        size_t space = this->parser.write_window(&window);
+        size_t buffered = 0;
+        uart_get_buffered_data_len(this->uart_num, &buffered);
+        size_t length = (buffered > LD2461_FRAME_OVERHEAD) ? buffered : LD2461_FRAME_OVERHEAD;
+        if(length > space) length = space;
+
+        TickType_t ticks = pdMS_TO_TICKS(remaining / 1000);
+        int bytes_available = uart_read_bytes(this->uart_num, window, length, (ticks > 0) ? ticks : 1);
+        if(bytes_available > 0) this->parser.commit(bytes_available);
+    }
+    return true;
+}
+
+bool LD2461::resync()
+{
+    int64_t start = system_clock->now();
+    ld2461_frame_t frame;
+    bool synced = false;
+
+    // 1. Drop whatever is buffered and hunt for a header at the current baudrate
+    uart_flush_input(this->uart_num);
+    this->parser.reset();
+    synced = this->read_frame(&frame, pdMS_TO_TICKS(LD2461_PROBE_TIMEOUT_MS)) &&
+             this->read_frame(&frame, pdMS_TO_TICKS(LD2461_PROBE_TIMEOUT_MS));
+
+    // 2. Reset the radar and find the baudrate it came back with
+    if(!synced)
+    {
+        ESP_LOGW(RADAR_TAG, "No header found on UART %d, resetting the radar", this->uart_num);
+        uart_write_bytes(this->uart_num, (const void*)LD2461_FRAME_RESET.bytes, LD2461_FRAME_RESET.size);
+        vTaskDelay(pdMS_TO_TICKS(LD2461_RESET_TIME_MS));
+        synced = this->detect_baudrate() != 0;
+    }
+
+    int64_t duration = system_clock->now() - start;
+    this->link_stats.last_resync_duration = duration;
+    if(duration > this->link_stats.max_resync_duration) this->link_stats.max_resync_duration = duration;
+
+    if(synced)
+    {
+        this->link_stats.resyncs++;
+        this->consecutive_failed_resyncs = 0;
+        gpio_set_level(RED_LED, 1);
+        ESP_LOGI(RADAR_TAG, "UART %d resynchronised at %lu baud in %lld us",
+            this->uart_num, (unsigned long)this->baudrate, duration);
+        return true;
+    }
+
+    this->link_stats.failed_resyncs++;
+    this->consecutive_failed_resyncs++;
+    ESP_LOGE(RADAR_TAG, "UART %d resynchronisation failed (%u in a row)", this->uart_num, this->consecutive_failed_resyncs);
+    if(this->consecutive_failed_resyncs >= LD2461_MAX_FAILED_RESYNCS)
+    {
+        // Last resort, the radar may need a power cycle from the board
+        ESP_LOGE(RADAR_TAG, "Radar not answering... Rebooting...");
+        esp_restart();
+    }
+    return false;
+}
+
+void LD2461::get_link_stats(ld2461_link_stats_t* stats)
+{
+    const ld2461_parser_stats_t* parser_stats = this->parser.get_stats();
+    *stats = this->link_stats;
+    stats->frames = parser_stats->frames;
+    stats->checksum_errors = parser_stats->checksum_errors;
+    stats->trailer_errors = parser_stats->trailer_errors;
+    stats->length_errors = parser_stats->length_errors;
+    stats->discarded_bytes = parser_stats->discarded_bytes;
+}
+
+void LD2461::send_command(ld2461_command_word_t command_word, const uint8_t* command_value, uint16_t length)
+{
+    uint8_t payload[LD2461_MAX_FRAME_SIZE];
+    size_t size = ld2461_encode_frame(payload, sizeof(payload), command_word, command_value, length);
+    if(size == 0) throw "Command Value too long";
+    uart_write_bytes(this->uart_num, (const void*)payload, size);
+}
+
+bool LD2461::set_zone_filter(const ld2461_zone_filter_t* filter)
+{
+    uint8_t value[LD2461_ZONE_VALUE_SIZE];
+    size_t index = 0;
+    value[index++] = filter->mode;
+    for(int zone=0; zone<LD2461_ZONE_COUNT; zone++)
+    {
+        for(int point=0; point<LD2461_ZONE_POINTS; point++)
         {
-            uart_read_bytes(this->uart_num, command_value+i, 1, 100);
+            value[index++] = (uint8_t)filter->zone[zone][point].x;
+            value[index++] = (uint8_t)filter->zone[zone][point].y;
         }
+    }
+    this->send_command(LD2461_COMMAND_ZONE_FILTERING, value, sizeof(value));
+
+    ld2461_frame_t frame = ld2461_setup_frame();
+    if(!this->wait_for_frame(LD2461_COMMAND_ZONE_FILTERING, &frame, pdMS_TO_TICKS(LD2461_COMMAND_TIMEOUT_MS))) return false;
+    return frame.command_value[0] == 0x01;
+}
+
+bool LD2461::read_zone_filter(ld2461_zone_filter_t* filter)
+{
+    uart_write_bytes(this->uart_num, (const void*)LD2461_FRAME_READ_AREAS.bytes, LD2461_FRAME_READ_AREAS.size);
+
+    ld2461_frame_t frame = ld2461_setup_frame();
+    if(!this->wait_for_frame(LD2461_COMMAND_READING_AREAS, &frame, pdMS_TO_TICKS(LD2461_COMMAND_TIMEOUT_MS))) return false;
+    if(frame.data_length - 1 < LD2461_ZONE_VALUE_SIZE) return false;
 
-        // Checksum
-        uart_read_bytes(this->uart_num, checksum, 1, 100);
-
-        // Catch the footer
-        uart_read_bytes(this->uart_num, data, 1, 100);
-        if(*data != 0xDD) {printf("\n"); free(command_value); continue;}
-        uart_read_bytes(this->uart_num, data, 1, 100);
-        if(*data != 0xEE) {printf("\n"); free(command_value); continue;}
-        uart_read_bytes(this->uart_num, data, 1, 100);
-        frame->data_length = *data_length;
-        frame->command_word = (ld2461_command_word_t)(*command_word);
-        frame->command_value = (uint8_t*)malloc(*data_length-1);
-        for(int i=0; i<(*data_length-1); i++)
+    size_t index = 0;
+    filter->mode = (ld2461_zone_mode_t)frame.command_value[index++];
+    for(int zone=0; zone<LD2461_ZONE_COUNT; zone++)
+    {
+        for(int point=0; point<LD2461_ZONE_POINTS; point++)
         {
-            frame->command_value[i] = command_value[i];
+            filter->zone[zone][point].x = (int8_t)frame.command_value[index++];
+            filter->zone[zone][point].y = (int8_t)frame.command_value[index++];
         }
-        frame->checksum = *checksum;
-        free(command_value);
-       data_ready = true;
     }
-    free(data_length);
-    free(command_word);
-    free(checksum);
-    free(data);
+    return true;
 }
 
-uint8_t LD2461::ld2461_generate_checksum(ld2461_frame_t* frame)
+bool LD2461::withdraw_zone_filter()
 {
-    uint8_t sum = 0;
-    if (frame == NULL) throw "Frame is NULL";
-    sum += frame->command_word;
-    for(uint16_t i=0; i < frame->data_length-1; i++)
+    uart_write_bytes(this->uart_num, (const void*)LD2461_FRAME_WITHDRAW_AREAS.bytes, LD2461_FRAME_WITHDRAW_AREAS.size);
+
+    ld2461_frame_t frame = ld2461_setup_frame();
+    if(!this->wait_for_frame(LD2461_COMMAND_WITHDRAW_AREAS, &frame, pdMS_TO_TICKS(LD2461_COMMAND_TIMEOUT_MS))) return false;
+    return frame.command_value[0] == 0x01;
+}
+
+bool LD2461::apply_zone_filter(const ld2461_zone_filter_t* filter)
+{
+    ld2461_zone_filter_t programmed;
+    for(int attempt=0; attempt<2; attempt++)
     {
-        sum += frame->command_value[i];
+        if(!this->set_zone_filter(filter)) continue;
+        if(!this->read_zone_filter(&programmed)) continue;
+        if(memcmp(&programmed, filter, sizeof(programmed)) == 0)
+        {
+            ESP_LOGI(RADAR_TAG, "Zone filter applied (%d, %d) (%d, %d) (%d, %d) (%d, %d)",
+                filter->zone[0][0].x, filter->zone[0][0].y,
+                filter->zone[0][1].x, filter->zone[0][1].y,
+                filter->zone[0][2].x, filter->zone[0][2].y,
+                filter->zone[0][3].x, filter->zone[0][3].y);
+            return true;
+        }
+        ESP_LOGW(RADAR_TAG, "Zone filter read back does not match");
     }
-    (frame->checksum )= sum & 0xFF;
-    return sum;
+    ESP_LOGE(RADAR_TAG, "Zone filter could not be verified, withdrawing it");
+    this->withdraw_zone_filter();
+    return false;
+}
+
+uint8_t LD2461::ld2461_generate_checksum(ld2461_frame_t* frame)
+{
+    if (frame == NULL) throw "Frame is NULL";
+    frame->checksum = ld2461_checksum(frame->command_word, frame->command_value, frame->data_length-1);
+    return frame->checksum;
 }
 
 ld2461_version_t LD2461::get_version_and_id(ld2461_frame_t* frame)
 {
     if (frame == NULL) throw "Frame is NULL";
 
-    uint8_t payload[] = {0xFF, 0xEE, 0xDD, 0x00, 0x02, 0x09, 0x01, 0x0A, 0xDD, 0xEE, 0xFF};
-    uart_write_bytes(this->uart_num, (const void*)payload, sizeof(payload));
-    this->read_data(frame);
-    while(frame->command_word != LD2461_COMMAND_ID_AND_VERSION)
+    uart_write_bytes(this->uart_num, (const void*)LD2461_FRAME_VERSION_REQUEST.bytes, LD2461_FRAME_VERSION_REQUEST.size);
+    this->wait_for_frame(LD2461_COMMAND_ID_AND_VERSION, frame, portMAX_DELAY);
+    while(frame->data_length < 9)
     {
-        this->read_data(frame);
+        this->wait_for_frame(LD2461_COMMAND_ID_AND_VERSION, frame, portMAX_DELAY);
     }
 
     ld2461_version_t version = {
@@ -191,8 +474,8 @@ ld2461_version_t LD2461::get_version_and_id(ld2461_frame_t* frame)
         .major = frame->command_value[2],
         .minor = frame->command_value[3],
         .id_number = (uint32_t)(
-            (frame->command_value[4] << 24) |
-            (frame->command_value[5] << 16) |
+            ((uint32_t)frame->command_value[4] << 24) |
+            ((uint32_t)frame->command_value[5] << 16) |
             (frame->command_value[6] << 8) |
             (frame->command_value[7])
         )
@@ -200,34 +483,44 @@ ld2461_version_t LD2461::get_version_and_id(ld2461_frame_t* frame)
     return version;
 }
 
-void LD2461::report_detections(ld2461_detection_t* detection)
+int64_t LD2461::frame_arrival_time(int64_t rx_time, size_t idle_symbols)
 {
-    static ld2461_frame_t frame = ld2461_setup_frame();
+    int64_t byte_time = 10000000 / this->baudrate; // Start + 8 data + stop bits, in microseconds
+    return rx_time - (int64_t)(idle_symbols + this->parser.pending()) * byte_time;
+}
 
-    this->read_data(&frame);
-    while(frame.command_word != LD2461_COMMAND_RADAR_REPORT_1)
-    {
-        this->read_data(&frame);
-    }
-    float size = (frame.data_length-1)/2;
+void LD2461::frame_to_detection(ld2461_frame_t* frame, ld2461_detection_t* detection, int64_t timestamp)
+{
+    int size = ld2461_decode_report(frame, detection->target, MAX_TARGETS_DETECTION);
     for(int i=0; i<size; i++)
     {
-        detection->target[i].x = frame.command_value[2*i];
-        detection->target[i].y = frame.command_value[2*i+1];
         detection->is_target_available[i] = LD2461_TARGET_AVAILABLE;
+        detection->track_id[i] = 0;
     }
     for(int i=size; i<MAX_TARGETS_DETECTION; i++)
     {
+        detection->track_id[i] = 0;
+        detection->target[i].x = 0;
+        detection->target[i].y = 0;
         detection->is_target_available[i] = LD2461_TARGET_UNAVAILABLE;
     }
-    detection->detected_targets = frame.data_length/2;
-    (frame.data_length/2 > 0) ? gpio_set_level(GREEN_LED, 1) : gpio_set_level(GREEN_LED, 0);
-    free_ld2461_frame(&frame);
+    detection->detected_targets = size;
+    detection->timestamp = timestamp;
+    (size > 0) ? gpio_set_level(GREEN_LED, 1) : gpio_set_level(GREEN_LED, 0);
+}
+
+void LD2461::report_detections(ld2461_detection_t* detection)
+{
+    static ld2461_frame_t frame = ld2461_setup_frame();
+
+    this->wait_for_frame(LD2461_COMMAND_RADAR_REPORT_1, &frame, portMAX_DELAY);
+    this->frame_to_detection(&frame, detection, system_clock->now());
+    this->apply_mount(detection);
 }
 
 const char* LD2461::frame_to_string(ld2461_frame_t* frame)
 {
-    static char buffer[100];
+    static char buffer[(LD2461_MAX_FRAME_SIZE * 2) + 1];
     buffer[0] = '\0';
     memset(buffer, 0, sizeof(buffer));
     // Print frame in hexadecimal
@@ -257,209 +550,264 @@ void LD2461::print_frame(ld2461_frame_t* frame)
     printf("\n");
 }
 
-void LD2461::change_baudrate(ld2461_baudrate_t baudrate)
+bool LD2461::change_baudrate(ld2461_baudrate_t baudrate)
 {
-    uint8_t payload[] = {
-        0xFF, 0xEE, 0xDD,   // Header
-        0x00, 0x04,         // Data Length
-        0x01,               // Command Word
-        0x00, 0x00, 0x00,   // Command Value
-        0x00,               // Checksum
-        0xDD, 0xEE, 0xFF    // End
-        };
     switch(baudrate)
     {
         case LD2461_BAUDRATE_9600:
-            payload[6] = 0x01;
-            payload[7] = 0xC2;
-            payload[8] = 0x00;
-            payload[9] = 0xC4;
-            break;
         case LD2461_BAUDRATE_19200:
-            payload[6] = 0x00;
-            payload[7] = 0x61;
-            payload[8] = 0x00;
-            payload[9] = 0x62;
-            break;
         case LD2461_BAUDRATE_38400:
-            payload[6] = 0x00;
-            payload[7] = 0x30;
-            payload[8] = 0x00;
-            payload[9] = 0x31;
-            break;
         case LD2461_BAUDRATE_57600:
-            payload[6] = 0x00;
-            payload[7] = 0x19;
-            payload[8] = 0x00;
-            payload[9] = 0x1A;
-            break;
         case LD2461_BAUDRATE_115200:
-            payload[6] = 0x00;
-            payload[7] = 0x0C;
-            payload[8] = 0x00;
-            payload[9] = 0x0D;
-            break;
         case LD2461_BAUDRATE_256000:
-            payload[6] = 0x00;
-            payload[7] = 0x03;
-            payload[8] = 0x00;
-            payload[9] = 0x04;
             break;
         default:
             throw "Invalid Baudrate";
     }
-    uart_write_bytes(this->uart_num, (const void*)payload, sizeof(payload));
+    ld2461_command_frame<3> payload = ld2461_make_baudrate_command(baudrate);
+    uart_write_bytes(this->uart_num, (const void*)payload.bytes, payload.size);
+    uart_wait_tx_done(this->uart_num, pdMS_TO_TICKS(LD2461_PROBE_TIMEOUT_MS));
     uart_set_baudrate(this->uart_num, baudrate);
+    this->baudrate = baudrate;
+
     ld2461_frame_t frame = ld2461_setup_frame();
-    this->read_data(&frame);
-    while(frame.command_word != LD2461_COMMAND_CHANGE_BAUDRATE)
+    if(this->wait_for_frame(LD2461_COMMAND_CHANGE_BAUDRATE, &frame, pdMS_TO_TICKS(LD2461_PROBE_TIMEOUT_MS * 3)) &&
+       frame.command_value[0] == 0x01)
     {
-        this->read_data(&frame);
+        ESP_LOGI(RADAR_TAG, "Baudrate changed to %d", (int)baudrate);
+        return true;
     }
-    if(frame.command_value[0] == 0x01)
-    {
-        printf("Baudrate changed successfully!\n");
-    }
-    else
+    ESP_LOGW(RADAR_TAG, "Baudrate change to %d was not acknowledged", (int)baudrate);
+    return false;
+}
+
+bool LD2461::probe_baudrate(uint32_t baudrate)
+{
+    uart_set_baudrate(this->uart_num, baudrate);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    uart_flush_input(this->uart_num);
+    this->parser.reset();
+
+    // Reports are streamed continuously, the version request wakes up a radar that is not reporting
+    uart_write_bytes(this->uart_num, (const void*)LD2461_FRAME_VERSION_REQUEST.bytes, LD2461_FRAME_VERSION_REQUEST.size);
+
+    // Two frames in a row, so a lucky checksum on line noise is not taken as a valid link
+    ld2461_frame_t frame;
+    for(int i=0; i<2; i++)
     {
-        printf("Baudrate change failed!\n");
+        if(!this->read_frame(&frame, pdMS_TO_TICKS(LD2461_PROBE_TIMEOUT_MS))) return false;
     }
+    this->baudrate = baudrate;
+    return true;
 }
 
-const char* LD2461::detection_to_json(ld2461_frame_t* frame){
-    static char buffer[100];
-    buffer[0] = '\0';
-    sprintf(buffer, "{ \"detections\": [");
-    for(int i=0; i<frame->data_length/2; i++)
+uint32_t LD2461::detect_baudrate()
+{
+    uint32_t stored = storage->get_uint32(SENSOR_BASIC_DATA, this->baud_key);
+    if(stored != 0 && this->probe_baudrate(stored))
     {
-        sprintf(buffer + strlen(buffer), "{ \"x\": %.1f, \"y\": %.1f }", (float)(int8_t)(frame->command_value[2*i])/10, (float)(int8_t)(frame->command_value[2*i+1])/10);
-        if(i < frame->data_length/2 - 1)
+        ESP_LOGI(RADAR_TAG, "LD2461 answering at stored baudrate %lu", (unsigned long)stored);
+        return stored;
+    }
+    for(size_t i=0; i<sizeof(ld2461_probe_order)/sizeof(ld2461_probe_order[0]); i++)
+    {
+        if(ld2461_probe_order[i] == stored) continue;
+        if(this->probe_baudrate(ld2461_probe_order[i]))
         {
-            sprintf(buffer + strlen(buffer), ", ");
+            ESP_LOGI(RADAR_TAG, "LD2461 answering at %d baud", (int)ld2461_probe_order[i]);
+            return ld2461_probe_order[i];
         }
     }
-    sprintf(buffer + strlen(buffer), "] }");
-    return buffer;
+    ESP_LOGE(RADAR_TAG, "LD2461 not answering at any baudrate");
+    return 0;
 }
 
-void LD2461::filter_ghost_targets(ld2461_detection_t* detection)
+uint32_t LD2461::negotiate_baudrate(ld2461_baudrate_t target)
 {
-    static ld2461_detection_t previous_detection;
-    static int64_t timeout[MAX_TARGETS_DETECTION] = {0};
-
-    if (detection->detected_targets == 0) return; // If no targets are detected, return
+    uint32_t current = this->detect_baudrate();
+    if(current == 0)
+    {
+        uart_set_baudrate(this->uart_num, this->baudrate);
+        return 0;
+    }
 
-    // For each target, check if it is a ghost
-    for (int i = 0; i < MAX_TARGETS_DETECTION; i++)
+    if(current != (uint32_t)target)
     {
-        // If target is already zero, skip
-        if (detection->target[i].x == 0 && detection->target[i].y == 0)
+        if(this->change_baudrate(target) && this->probe_baudrate(target))
         {
-            detection->is_target_available[i] = LD2461_TARGET_UNAVAILABLE; // Set the target as not available (id 0 is not available)
-            continue;
+            current = target;
         }
-
-        if (previous_detection.target[i].x == 0 && previous_detection.target[i].y == 0)
+        else
         {
-            continue; // Skip if the previous target is zero
-        }
-
-        //// Check if the target is too far from the previous one (probably error in the detection, people don't teleport)
-        if (this->flag_max_threshold_distance) {
-            if (fabs(detection->target[i].x - previous_detection.target[i].x) > MAX_THRESHOLD_DISTANCE_METERS ||
-                fabs(detection->target[i].y - previous_detection.target[i].y) > MAX_THRESHOLD_DISTANCE_METERS)
-            {
-                ESP_LOGW(RADAR_TAG, "Target %d exceeded the threshold of %f meters.", i, MAX_THRESHOLD_DISTANCE_METERS);
-                detection->is_target_available[i] = LD2461_TARGET_TELEPORTED; // Set the target as teleported (id 3 is teleported)
-                continue;
-            }
+            // The link does not hold the new baudrate, go back to the one that worked
+            ESP_LOGW(RADAR_TAG, "Falling back to %lu baud", (unsigned long)current);
+            if(!this->probe_baudrate(current)) current = this->detect_baudrate();
         }
+    }
 
-        // Checks if the current point is equal to the previous one
-        if (this->flag_ghost_timer){
-            if (detection->target[i].x == previous_detection.target[i].x &&
-                detection->target[i].y == previous_detection.target[i].y)
-            {
-                if (timeout[i] == 0)
-                {
-                    timeout[i] = esp_timer_get_time();
-                }
-                else if (esp_timer_get_time() - timeout[i] > this->GHOST_TIMER_TIMEOUT)
-                {
-                    // Set the point as a ghost
-                    //ESP_LOGW(RADAR_TAG, "Target %d marked as ghost.", i);
-                    detection->is_target_available[i] = LD2461_TARGET_GHOST;
-                    detection->target[i].x = 0;
-                    detection->target[i].y = 0;
-
-                    // Continue the loop to avoid overwriting ghosts
-                    continue;
-                }
-            }
-            else
-            {
-                // If the current point is different from the previous one, reset the timeout
-                timeout[i] = 0;
-            }
-        }
+    if(current != 0 && current != storage->get_uint32(SENSOR_BASIC_DATA, this->baud_key))
+    {
+        storage->store_data_uint32(SENSOR_BASIC_DATA, this->baud_key, current);
     }
+    return current;
+}
 
-    // Update previous_detection
-    for (int i = 0; i < MAX_TARGETS_DETECTION; i++)
+uint32_t LD2461::get_baudrate()
+{
+    return this->baudrate;
+}
+
+const char* LD2461::detection_to_json(ld2461_frame_t* frame){
+    static char buffer[256];
+    int size = (frame->data_length-1)/2;
+    if(size > MAX_TARGETS_DETECTION) size = MAX_TARGETS_DETECTION;
+    buffer[0] = '\0';
+    sprintf(buffer, "{ \"detections\": [");
+    for(int i=0; i<size; i++)
     {
-        if (detection->is_target_available[i] != LD2461_TARGET_GHOST)
+        sprintf(buffer + strlen(buffer), "{ \"x\": %.1f, \"y\": %.1f }", (float)(int8_t)(frame->command_value[2*i])/10, (float)(int8_t)(frame->command_value[2*i+1])/10);
+        if(i < size - 1)
         {
-            previous_detection.target[i] = detection->target[i];
+            sprintf(buffer + strlen(buffer), ", ");
         }
     }
+    sprintf(buffer + strlen(buffer), "] }");
+    return buffer;
 }
 
 void LD2461::set_ghost_timer_timeout(int64_t timeout)
 {
-    this->GHOST_TIMER_TIMEOUT = timeout;
+    this->ghost_filter.set_ghost_timer_timeout(timeout);
     ESP_LOGI(RADAR_TAG, "Ghost timer timeout set to %lld microseconds.", timeout);
 }
 
 int64_t LD2461::get_ghost_timer_timeout()
 {
-    return this->GHOST_TIMER_TIMEOUT;
+    return this->ghost_filter.get_ghost_timer_timeout();
 }
 
 void LD2461::set_max_threshold_distance(double distance)
 {
-    this->MAX_THRESHOLD_DISTANCE_METERS = distance;
+    this->ghost_filter.set_max_threshold_distance(distance);
     ESP_LOGI(RADAR_TAG, "Threshold distance set to %f meters.", distance);
 }
 
 double LD2461::get_max_threshold_distance()
 {
-    return this->MAX_THRESHOLD_DISTANCE_METERS;
+    return this->ghost_filter.get_max_threshold_distance();
 }
 
 void LD2461::set_flag(ld2461_flags flag, uint8_t value)
 {
-    switch(flag){
-        case LD2461_FLAG_GHOST_TIMER:
-            this->flag_ghost_timer = value;
-            ESP_LOGI(RADAR_TAG, "Ghost timer flag set to %d.", value);
-            break;
-        case LD2461_FLAG_MAX_THRESHOLD_DISTANCE:
-            this->flag_max_threshold_distance = value;
-            ESP_LOGI(RADAR_TAG, "Max threshold distance flag set to %d.", value);
-            break;
-        default:
-            break;
-    }
+    this->ghost_filter.set_flag(flag, value);
+    ESP_LOGI(RADAR_TAG, "Flag %d set to %d.", flag, value);
 }
 
 uint8_t LD2461::get_flag(ld2461_flags flag)
 {
-    switch(flag){
-        case LD2461_FLAG_GHOST_TIMER:
-            return this->flag_ghost_timer;
-        case LD2461_FLAG_MAX_THRESHOLD_DISTANCE:
-            return this->flag_max_threshold_distance;
-        default:
-            return 0;
+    return this->ghost_filter.get_flag(flag);
+}
+
+uint32_t LD2461::get_tracks_created()
+{
+    return this->tracker.get_created();
+}
+
+uint32_t LD2461::get_track_swaps()
+{
+    return this->tracker.get_swaps();
+}
+
+void LD2461::set_mount(ld2461_mount_t mount)
+{
+    float radians = mount.rotation * (float)M_PI / 180.0f;
+    float cos_rotation = cosf(radians);
+    float sin_rotation = sinf(radians);
+
+    taskENTER_CRITICAL(&this->mount_lock);
+    this->mount = mount;
+    this->mount_cos = cos_rotation;
+    this->mount_sin = sin_rotation;
+    taskEXIT_CRITICAL(&this->mount_lock);
+    ESP_LOGI(RADAR_TAG, "Radar %u mounted at (%.2f, %.2f) rotated %.1f degrees",
+        this->index, mount.offset_x, mount.offset_y, mount.rotation);
+}
+
+ld2461_mount_t LD2461::get_mount()
+{
+    return this->mount;
+}
+
+void LD2461::load_mount()
+{
+    char key_rotation[16], key_x[16], key_y[16];
+    snprintf(key_rotation, sizeof(key_rotation), "LD2461_%u_ROT", this->index);
+    snprintf(key_x, sizeof(key_x), "LD2461_%u_X", this->index);
+    snprintf(key_y, sizeof(key_y), "LD2461_%u_Y", this->index);
+
+    char* rotation = storage->get_str(SENSOR_BASIC_DATA, key_rotation);
+    char* offset_x = storage->get_str(SENSOR_BASIC_DATA, key_x);
+    char* offset_y = storage->get_str(SENSOR_BASIC_DATA, key_y);
+    if(rotation != NULL && offset_x != NULL && offset_y != NULL)
+    {
+        this->set_mount({strtof(rotation, NULL), strtof(offset_x, NULL), strtof(offset_y, NULL)});
+    }
+    free(rotation); free(offset_x); free(offset_y);
+}
+
+void LD2461::save_mount(uint8_t index, ld2461_mount_t mount)
+{
+    char key[16], value[16];
+    snprintf(key, sizeof(key), "LD2461_%u_ROT", index);
+    snprintf(value, sizeof(value), "%f", mount.rotation);
+    storage->store_data_str(SENSOR_BASIC_DATA, key, value);
+    snprintf(key, sizeof(key), "LD2461_%u_X", index);
+    snprintf(value, sizeof(value), "%f", mount.offset_x);
+    storage->store_data_str(SENSOR_BASIC_DATA, key, value);
+    snprintf(key, sizeof(key), "LD2461_%u_Y", index);
+    snprintf(value, sizeof(value), "%f", mount.offset_y);
+    storage->store_data_str(SENSOR_BASIC_DATA, key, value);
+}
+
+uint8_t LD2461::get_index()
+{
+    return this->index;
+}
+
+static int8_t ld2461_saturate(float decimeters)
+{
+    decimeters = roundf(decimeters);
+    if(decimeters > INT8_MAX) return INT8_MAX;
+    if(decimeters < INT8_MIN) return INT8_MIN;
+    return (int8_t)decimeters;
+}
+
+void LD2461::apply_mount(ld2461_detection_t* detection)
+{
+    taskENTER_CRITICAL(&this->mount_lock);
+    float cos_rotation = this->mount_cos;
+    float sin_rotation = this->mount_sin;
+    float offset_x = this->mount.offset_x * 10;
+    float offset_y = this->mount.offset_y * 10;
+    taskEXIT_CRITICAL(&this->mount_lock);
+
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        if(detection->target[i].x == 0 && detection->target[i].y == 0) continue; // (0, 0) stays as "no target"
+        float x = detection->target[i].x;
+        float y = detection->target[i].y;
+        detection->target[i].x = ld2461_saturate((x * cos_rotation) - (y * sin_rotation) + offset_x);
+        detection->target[i].y = ld2461_saturate((x * sin_rotation) + (y * cos_rotation) + offset_y);
+        // A real target landing on the origin would be taken as an empty slot
+        if(detection->target[i].x == 0 && detection->target[i].y == 0) detection->target[i].y = 1;
     }
-}
\ No newline at end of file
+}
+
+void LD2461::world_to_radar(float x, float y, float* radar_x, float* radar_y)
+{
+    // Inverse of apply_mount(), in meters
+    x -= this->mount.offset_x;
+    y -= this->mount.offset_y;
+    *radar_x = (x * this->mount_cos) + (y * this->mount_sin);
+    *radar_y = (y * this->mount_cos) - (x * this->mount_sin);
+}
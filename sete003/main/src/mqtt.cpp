@@ -135,7 +135,7 @@ MQTT::MQTT(const char* uri)
     esp_mqtt_client_start(this->client);
 }
 
-esp_err_t MQTT::publish(const char* topic, const char* payload)
+esp_err_t MQTT::publish(const char* topic, const char* payload, bool retain)
 {
     int a = esp_mqtt_client_publish(
         this->client,
@@ -143,7 +143,7 @@ esp_err_t MQTT::publish(const char* topic, const char* payload)
         payload,
         0,
         0,
-        0);
+        retain ? 1 : 0);
     if(a<0) return ESP_FAIL;
     return ESP_OK;
 }
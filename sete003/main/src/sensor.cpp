@@ -10,12 +10,12 @@
 #include "mqtt.hpp"
 #include "wifi.hpp"
 #include "storage.hpp"
+#include "clock.hpp"
 
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "time.h"
 #include "freertos/timers.h"
-#include <chrono>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
@@ -76,6 +76,9 @@ void get_mac_address_str(char* mac_str)
 
 Sensor::Sensor()
 {
+    this->utc_offset = 0;
+    this->utc_offset_lock = portMUX_INITIALIZER_UNLOCKED;
+
     // Init internal temperature sensor
     temperature_sensor_config_t temp_sensor_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(20, 100);
     ESP_ERROR_CHECK(temperature_sensor_install(&temp_sensor_config, &this->temperature_sensor));
@@ -162,16 +165,52 @@ void Sensor::set_ota_update_uri(std::string uri)
 
 char* Sensor::time_now()
 {
-    time_t now;
+    time_t now = system_clock->utc() / 1000000;
     static char strftime_buf[64];
     struct tm timeinfo;
 
-    time(&now);
     localtime_r(&now, &timeinfo);
     strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
     return strftime_buf;
 }
 
+char* Sensor::time_at(int64_t esp_time)
+{
+    static char strftime_buf[64];
+    struct tm timeinfo;
+
+    int64_t at = system_clock->utc();
+    if(esp_time > 0)
+    {
+        // Walk back from the wall clock by how long ago the timestamp was taken
+        at -= system_clock->now() - esp_time;
+    }
+    time_t seconds = at / 1000000;
+    localtime_r(&seconds, &timeinfo);
+    size_t length = strftime(strftime_buf, sizeof(strftime_buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    snprintf(strftime_buf + length, sizeof(strftime_buf) - length, ".%03ld", (long)((at % 1000000) / 1000));
+    return strftime_buf;
+}
+
+void Sensor::update_utc_offset()
+{
+    int64_t utc = system_clock->utc();
+    int64_t esp_time = system_clock->now();
+    if(utc < 1600000000LL * 1000000) return; // Not set by SNTP yet (before 2020)
+    taskENTER_CRITICAL(&this->utc_offset_lock);
+    this->utc_offset = utc - esp_time;
+    taskEXIT_CRITICAL(&this->utc_offset_lock);
+}
+
+int64_t Sensor::utc_time_at(int64_t esp_time)
+{
+    taskENTER_CRITICAL(&this->utc_offset_lock);
+    int64_t offset = this->utc_offset;
+    taskEXIT_CRITICAL(&this->utc_offset_lock);
+    if(offset == 0) return 0;
+    return esp_time + offset;
+}
+
 void Sensor::change_time_zone(const char* time_zone)
 {
     setenv("TZ", time_zone, 1);
@@ -180,21 +219,15 @@ void Sensor::change_time_zone(const char* time_zone)
 
 std::string Sensor::get_current_timestamp()
 {
-    // Obtém o tempo atual
-    auto now = std::chrono::system_clock::now();
-    
-    // Converte para tempo do sistema
-    auto time_t_now = std::chrono::system_clock::to_time_t(now);
-    auto timeinfo = std::gmtime(&time_t_now); // Tempo em UTC (GMT)
-    
-    // Extrai os milissegundos/microsegundos
-    auto duration = now.time_since_epoch();
-    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() % 1000000;
+    int64_t utc = system_clock->utc();
+    time_t seconds = utc / 1000000;
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo); // Tempo em UTC (GMT)
 
     // Formata a data e hora
     std::ostringstream oss;
-    oss << std::put_time(timeinfo, "%Y-%m-%d %H:%M:%S"); // Data e hora
-    oss << "." << std::setfill('0') << std::setw(6) << micros; // Microssegundos
+    oss << std::put_time(&timeinfo, "%Y-%m-%d %H:%M:%S"); // Data e hora
+    oss << "." << std::setfill('0') << std::setw(6) << (utc % 1000000); // Microssegundos
     oss << "+00"; // UTC offset
     
     return oss.str();
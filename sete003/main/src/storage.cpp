@@ -103,6 +103,19 @@ void Storage::store_data_uint32(storage_type_t type, const char* key, uint32_t v
     ESP_LOGI("STORAGE", "Stored %lu in %s", value, key);
 }
 
+void Storage::store_data_blob(storage_type_t type, const char* key, const void* value, size_t length){
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(storage_type_name[type], NVS_READWRITE, &nvs_handle);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(STORAGE_TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+    }
+    nvs_set_blob(nvs_handle, key, value, length);
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    ESP_LOGI("STORAGE", "Stored %u bytes in %s", length, key);
+}
+
 
 char* Storage::get_str(storage_type_t type, const char* key){
     nvs_handle_t nvs_handle;
@@ -219,3 +232,28 @@ uint32_t Storage::get_uint32(storage_type_t type, const char* key){
     nvs_close(nvs_handle);
     return value;
 }
+
+bool Storage::get_blob(storage_type_t type, const char* key, void* value, size_t length){
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(storage_type_name[type], NVS_READONLY, &nvs_handle);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(STORAGE_TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+        return false;
+    }
+    size_t required_size = 0;
+    err = nvs_get_blob(nvs_handle, key, NULL, &required_size);
+    if(err != ESP_OK || required_size != length)
+    {
+        nvs_close(nvs_handle);
+        return false;
+    }
+    err = nvs_get_blob(nvs_handle, key, value, &required_size);
+    nvs_close(nvs_handle);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(STORAGE_TAG, "Error (%s) reading value!", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
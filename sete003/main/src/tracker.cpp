@@ -0,0 +1,206 @@
+#include "tracker.hpp"
+
+#include <string.h>
+
+#define TRACKER_INF (INT32_MAX / 2)
+#define TRACKER_LIMIT ((int32_t)INT8_MAX << TRACKER_Q)                  // Positions never leave the radar range
+#define TRACKER_SPEED_LIMIT ((int32_t)TRACKER_MAX_SPEED << TRACKER_Q)
+#define TRACKER_FIXED(value) ((int32_t)(value) * (1 << TRACKER_Q))      // Coordinate to fixed point, a shift of a negative value is undefined
+
+static int32_t tracker_clamp(int64_t value, int32_t limit)
+{
+    if(value > limit) return limit;
+    if(value < -limit) return -limit;
+    return (int32_t)value;
+}
+
+Tracker::Tracker()
+{
+    this->reset();
+    this->next_id = 1;
+    this->created = 0;
+    this->swaps = 0;
+}
+
+void Tracker::reset()
+{
+    memset(tracks, 0, sizeof(tracks));
+}
+
+void Tracker::predict(const track_t* track, int64_t timestamp, int32_t* x, int32_t* y)
+{
+    int64_t dt = timestamp - track->timestamp;
+    if(dt < 0) dt = 0;
+    *x = tracker_clamp(track->x + ((int64_t)track->vx * dt) / 1000000, TRACKER_LIMIT);
+    *y = tracker_clamp(track->y + ((int64_t)track->vy * dt) / 1000000, TRACKER_LIMIT);
+}
+
+void Tracker::assign(const int32_t cost[MAX_TARGETS_DETECTION][MAX_TARGETS_DETECTION], int8_t assignment[MAX_TARGETS_DETECTION])
+{
+    // Hungarian algorithm with potentials, O(n^3), index 0 is the virtual start column
+    const int n = MAX_TARGETS_DETECTION;
+    int32_t u[n + 1] = {}, v[n + 1] = {}, min_v[n + 1];
+    int8_t row_of[n + 1] = {}, way[n + 1] = {};
+    bool used[n + 1];
+
+    for(int i=1; i<=n; i++)
+    {
+        row_of[0] = i;
+        int j0 = 0;
+        for(int j=0; j<=n; j++) {min_v[j] = TRACKER_INF; used[j] = false;}
+        do
+        {
+            used[j0] = true;
+            int i0 = row_of[j0], j1 = 0;
+            int32_t delta = TRACKER_INF;
+            for(int j=1; j<=n; j++)
+            {
+                if(used[j]) continue;
+                int32_t reduced = cost[i0 - 1][j - 1] - u[i0] - v[j];
+                if(reduced < min_v[j]) {min_v[j] = reduced; way[j] = j0;}
+                if(min_v[j] < delta) {delta = min_v[j]; j1 = j;}
+            }
+            for(int j=0; j<=n; j++)
+            {
+                if(used[j]) {u[row_of[j]] += delta; v[j] -= delta;}
+                else min_v[j] -= delta;
+            }
+            j0 = j1;
+        } while(row_of[j0] != 0);
+
+        // Flip the augmenting path
+        do
+        {
+            int j1 = way[j0];
+            row_of[j0] = row_of[j1];
+            j0 = j1;
+        } while(j0 != 0);
+    }
+    for(int j=1; j<=n; j++) assignment[row_of[j] - 1] = j - 1;
+}
+
+void Tracker::update(ld2461_detection_t* detection)
+{
+    // Costs are squared distances in Q4 decimeters, the gate is the cost of leaving a pair unassigned
+    const int32_t gate = (TRACKER_GATE_DECIMETERS << 4) * (TRACKER_GATE_DECIMETERS << 4);
+    int32_t cost[MAX_TARGETS_DETECTION][MAX_TARGETS_DETECTION];
+    int8_t assignment[MAX_TARGETS_DETECTION];
+    int8_t track_target[MAX_TARGETS_DETECTION];
+    bool target_assigned[MAX_TARGETS_DETECTION] = {};
+    bool valid[MAX_TARGETS_DETECTION];
+
+    for(int j=0; j<MAX_TARGETS_DETECTION; j++)
+    {
+        valid[j] = (detection->target[j].x != 0 || detection->target[j].y != 0) &&
+                   (detection->is_target_available[j] == LD2461_TARGET_AVAILABLE ||
+                    detection->is_target_available[j] == LD2461_TARGET_TELEPORTED); // Slot swaps look like teleports, the flag is kept below
+    }
+
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        int32_t predicted_x = 0, predicted_y = 0;
+        if(tracks[i].id != 0) predict(&tracks[i], detection->timestamp, &predicted_x, &predicted_y);
+        for(int j=0; j<MAX_TARGETS_DETECTION; j++)
+        {
+            cost[i][j] = gate;
+            if(tracks[i].id == 0 || !valid[j]) continue;
+            int32_t dx = (TRACKER_FIXED(detection->target[j].x) - predicted_x) >> 4;
+            int32_t dy = (TRACKER_FIXED(detection->target[j].y) - predicted_y) >> 4;
+            int32_t distance = (dx * dx) + (dy * dy);
+            if(distance < gate) cost[i][j] = distance;
+        }
+    }
+    assign(cost, assignment);
+
+    // Tracks that got a target
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        int j = assignment[i];
+        track_target[i] = -1;
+        if(tracks[i].id == 0) continue;
+        if(cost[i][j] >= gate)
+        {
+            if(++tracks[i].misses > TRACKER_MAX_MISSES) tracks[i].id = 0;
+            continue;
+        }
+
+        int32_t x = TRACKER_FIXED(detection->target[j].x);
+        int32_t y = TRACKER_FIXED(detection->target[j].y);
+        int64_t dt = detection->timestamp - tracks[i].timestamp;
+        if(dt > 0)
+        {
+            // Measured velocity blended into the track, clamped so a bad frame can not fling the prediction away
+            int32_t measured_vx = tracker_clamp(((int64_t)(x - tracks[i].x) * 1000000) / dt, 2 * TRACKER_SPEED_LIMIT);
+            int32_t measured_vy = tracker_clamp(((int64_t)(y - tracks[i].y) * 1000000) / dt, 2 * TRACKER_SPEED_LIMIT);
+            tracks[i].vx = tracker_clamp(tracks[i].vx + (((int64_t)(measured_vx - tracks[i].vx) * TRACKER_VELOCITY_GAIN) >> 8), TRACKER_SPEED_LIMIT);
+            tracks[i].vy = tracker_clamp(tracks[i].vy + (((int64_t)(measured_vy - tracks[i].vy) * TRACKER_VELOCITY_GAIN) >> 8), TRACKER_SPEED_LIMIT);
+        }
+        tracks[i].x = x;
+        tracks[i].y = y;
+        tracks[i].timestamp = detection->timestamp;
+        tracks[i].misses = 0;
+        track_target[i] = j;
+        target_assigned[j] = true;
+        if(i != j) swaps++;
+    }
+
+    // Targets without a track start one, in their own slot when it is free
+    for(int j=0; j<MAX_TARGETS_DETECTION; j++)
+    {
+        if(!valid[j] || target_assigned[j]) continue;
+        int slot = (tracks[j].id == 0) ? j : -1;
+        for(int i=0; i<MAX_TARGETS_DETECTION && slot < 0; i++)
+        {
+            if(tracks[i].id == 0) slot = i;
+        }
+        // No free slot, the track missing for longer gives its place
+        if(slot < 0)
+        {
+            for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+            {
+                if(tracks[i].misses > 0 && (slot < 0 || tracks[i].misses > tracks[slot].misses)) slot = i;
+            }
+        }
+        if(slot < 0) continue;
+
+        tracks[slot].id = next_id++;
+        if(next_id == 0) next_id = 1; // 0 means no track
+        tracks[slot].x = TRACKER_FIXED(detection->target[j].x);
+        tracks[slot].y = TRACKER_FIXED(detection->target[j].y);
+        tracks[slot].vx = 0;
+        tracks[slot].vy = 0;
+        tracks[slot].timestamp = detection->timestamp;
+        tracks[slot].misses = 0;
+        track_target[slot] = j;
+        created++;
+    }
+
+    // Rewrite the report by track
+    ld2461_detection_t tracked = *detection;
+    tracked.detected_targets = 0;
+    for(int i=0; i<MAX_TARGETS_DETECTION; i++)
+    {
+        tracked.track_id[i] = tracks[i].id;
+        if(track_target[i] < 0)
+        {
+            tracked.target[i] = {0, 0};
+            tracked.is_target_available[i] = LD2461_TARGET_UNAVAILABLE;
+            continue;
+        }
+        // A teleport keeps its flag so the threshold distance still holds the target back for this report
+        tracked.target[i] = detection->target[track_target[i]];
+        tracked.is_target_available[i] = detection->is_target_available[track_target[i]];
+        tracked.detected_targets++;
+    }
+    *detection = tracked;
+}
+
+uint32_t Tracker::get_created()
+{
+    return this->created;
+}
+
+uint32_t Tracker::get_swaps()
+{
+    return this->swaps;
+}
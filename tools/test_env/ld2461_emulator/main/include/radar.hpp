@@ -1,6 +1,6 @@
 #pragma once
 
-#include "include/ld2461.hpp"
+#include "ld2461_codec.hpp"
 #include "driver/uart.h"
 
 typedef struct point2{
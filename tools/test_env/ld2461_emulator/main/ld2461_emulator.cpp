@@ -11,9 +11,19 @@
 #include "include/sensor.hpp"
 #include "include/storage.hpp"
 #include "include/radar.hpp"
+#include "ld2461_codec.hpp"
+#include "ld2461_parser.hpp"
 
 #define UART_NUM UART_NUM_2
 
+// Answer to the version request: v0.0 from 2025/3/16, ID 0xFFFFFFFF
+constexpr ld2461_command_frame<8> version_response = ld2461_make_command(
+    LD2461_COMMAND_ID_AND_VERSION,
+    {0x53, 0x10, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF}
+);
+
+static LD2461Parser parser;
+
 WiFi_STA* wifi;
 MQTT* mqtt;
 Sensor* sensor;
@@ -76,53 +86,23 @@ void app_main(void)
     // Receber confirmação do Sensor003
     ESP_LOGI(TAG,"Waiting for MCU confirmation...");
     bool mcu_init = false;
+    ld2461_frame_t frame;
     while(!mcu_init){
-        uint8_t data;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0xFF) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0xEE) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0xDD) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0x00) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0x02) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0x09) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0x01) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        if (data != 0x0A) continue;
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        uart_read_bytes(UART_NUM, &data, 1, 100);
-        mcu_init = true;
-        vTaskDelay(10/portTICK_PERIOD_MS);
+        uint8_t* window;
+        size_t space = parser.write_window(&window);
+        int length = uart_read_bytes(UART_NUM, window, space < LD2461_FRAME_OVERHEAD ? space : LD2461_FRAME_OVERHEAD, 100);
+        if (length > 0) parser.commit(length);
+        while (parser.next_frame(&frame)) {
+            if (frame.command_word == LD2461_COMMAND_ID_AND_VERSION) mcu_init = true;
+        }
     }
-    uint8_t return_data[18] = {
-        0xFF, 0xEE, 0xDD, 
-        0x00, 0x09, 
-        0x09,
-        0x53, 0x10, 0x00, 0x00,
-        0xFF, 0xFF, 0xFF, 0xFF,
-        0x00,
-        0xDD, 0xEE, 0xFF 
-    };
+    vTaskDelay(10/portTICK_PERIOD_MS);
     ESP_LOGI(TAG,"MCU Found!");
 
-    uart_write_bytes(UART_NUM, (const char*)return_data, 18);
+    uart_write_bytes(UART_NUM, (const char*)version_response.bytes, version_response.size);
     ESP_LOGI(TAG,"MCU Confirmed!");
     //while(true){ uart_write_bytes(UART_NUM, (const char*)return_data, 18); vTaskDelay(100/portTICK_PERIOD_MS);}
 
-    uint8_t idle_data[10] = {
-        0xFF, 0xEE, 0xDD, // Header
-        0x00, 0x01, // Length
-        0x07, // Command Word
-        0x07, // Checksum
-        0xDD, 0xEE, 0xFF // Footer
-    };
-
     while (true) {
         if (!radar_queue.empty()) {
             send_radar_sample(radar_queue.front(), UART_NUM);
@@ -132,7 +112,7 @@ void app_main(void)
             uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(50));
         } 
         else {
-            uart_write_bytes(UART_NUM, (const char*)idle_data, 10);
+            uart_write_bytes(UART_NUM, (const char*)LD2461_FRAME_EMPTY_REPORT.bytes, LD2461_FRAME_EMPTY_REPORT.size);
             
             // Aguarde a transmissão ser concluída antes de prosseguir
             uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(50));